@@ -6,4 +6,6 @@
 #include "stl/stl.hpp"
 #include "types/types.hpp"
 #include "string/string.hpp"
-#include "rand/rand.hpp"
\ No newline at end of file
+#include "rand/rand.hpp"
+#include "parallel/parallel.hpp"
+#include "timestep/timestep.hpp"
\ No newline at end of file
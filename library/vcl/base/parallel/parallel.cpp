@@ -0,0 +1,37 @@
+#include "parallel.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace vcl
+{
+
+int parallel_thread_count()
+{
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+void parallel_set_thread_count(int N)
+{
+#ifdef _OPENMP
+    omp_set_num_threads(N<1 ? 1 : N);
+#else
+    (void)N;
+#endif
+}
+
+int parallel_processor_count()
+{
+#ifdef _OPENMP
+    return omp_get_num_procs();
+#else
+    return 1;
+#endif
+}
+
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+// Control of the threads used by the parallel loops (OpenMP #pragma omp parallel for)
+//  When the code is compiled without OpenMP, the loops remain sequential and a single thread is reported.
+
+namespace vcl
+{
+
+/** Number of threads used by the next parallel loops */
+int parallel_thread_count();
+/** Set the number of threads used by the next parallel loops (value is clamped to at least 1) */
+void parallel_set_thread_count(int N);
+/** Number of processors available */
+int parallel_processor_count();
+
+}
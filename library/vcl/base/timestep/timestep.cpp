@@ -0,0 +1,77 @@
+#include "timestep.hpp"
+
+#include "../error/error.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+namespace vcl
+{
+
+float timestep_adaptive::stable(timestep_measure const& measure, float dt_max) const
+{
+    float const L = measure.length;
+    assert_vcl_no_msg(L>0);
+
+    float dt = dt_max;
+    if(measure.velocity_max>0)
+        dt = std::min(dt, cfl_velocity * L / measure.velocity_max);
+    if(measure.acceleration_max>0)
+        dt = std::min(dt, cfl_force * std::sqrt(L / measure.acceleration_max));
+    if(measure.viscosity>0)
+        dt = std::min(dt, cfl_viscosity * L*L / measure.viscosity);
+    if(measure.frequency>0)
+        dt = std::min(dt, cfl_frequency / measure.frequency);
+
+    return dt;
+}
+
+void timestep_adaptive::frame_start(float dt_frame_arg)
+{
+    dt_frame = dt_frame_arg;
+    t_remaining = dt_frame_arg;
+    substeps = 0;
+}
+
+bool timestep_adaptive::frame_running() const
+{
+    // Ignore a remaining time negligible with respect to the frame (rounding error of the previous substeps)
+    return t_remaining > 1e-6f*dt_frame;
+}
+
+float timestep_adaptive::next(timestep_measure const& measure)
+{
+    // The step never goes above the frame subdivided in substep_min
+    float const dt_max = dt_frame / std::max(substep_min, 1);
+    float dt = dt_factor*stable(measure, dt_max);
+    if(dt_stable>0) {
+        dt = std::min(dt, dt_stable*increase_max);
+        if(decrease_max>1)
+            dt = std::max(dt, dt_stable/decrease_max);
+    }
+    dt_stable = dt;
+
+    // Substeps left to cover the remaining time with steps of at most dt_stable
+    //  The step is the remaining time divided equally among them (avoids a last tiny step)
+    int N = int(std::ceil(t_remaining/dt_stable - 1e-4f));
+    N = std::max(N, 1);
+    N = std::min(N, std::max(substep_max-substeps, 1));
+
+    dt = (N==1) ? t_remaining : t_remaining/N;
+    t_remaining -= dt;
+    substeps++;
+    if(N==1)
+        t_remaining = 0.0f;
+
+    return dt;
+}
+
+float timestep_adaptive::next(float dt)
+{
+    dt = std::min(dt, t_remaining);
+    t_remaining -= dt;
+    substeps++;
+    return dt;
+}
+
+}
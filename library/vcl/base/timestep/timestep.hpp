@@ -0,0 +1,74 @@
+#pragma once
+
+// Adaptive time step for explicit particle simulations (CFL condition)
+//  A render frame of duration dt_frame is subdivided into the minimal number of substeps satisfying the stability limits.
+//  The limits are evaluated again before each substep from the current state of the simulation:
+//   - velocity:     dt < cfl_velocity * length / velocity_max     (a particle moves less than a fraction of the kernel/spring size)
+//   - acceleration: dt < cfl_force * sqrt(length / acceleration_max)
+//   - viscosity:    dt < cfl_viscosity * length^2 / viscosity     (explicit diffusion)
+//   - frequency:    dt < cfl_frequency / frequency                (stiffest oscillation, ex. sqrt(K/m) for springs)
+//
+// Typical use:
+//   timestep.frame_start(dt_frame);
+//   while(timestep.frame_running()) {
+//       float const dt = timestep.next(measure);
+//       simulate(dt, ...);
+//   }
+
+namespace vcl
+{
+
+/** Current state of the simulation used to evaluate the stable time step. Zero values are ignored. */
+struct timestep_measure
+{
+    float length = 1.0f;           // Characteristic length (SPH kernel radius, spring rest length, particle radius)
+    float velocity_max = 0.0f;     // Maximal velocity magnitude
+    float acceleration_max = 0.0f; // Maximal force/mass magnitude
+    float viscosity = 0.0f;        // Kinematic viscosity (length^2/s)
+    float frequency = 0.0f;        // Highest angular frequency of the system (1/s)
+};
+
+struct timestep_adaptive
+{
+    // Safety factors of each stability limit
+    float cfl_velocity = 0.4f;
+    float cfl_force = 0.25f;
+    float cfl_viscosity = 0.125f;
+    float cfl_frequency = 0.5f;
+
+    // Maximal ratio between two consecutive stable time steps
+    //  The step increases progressively: the measure lags one step behind the state (forces of the previous step)
+    //  The step decreases immediately to the stable value unless decrease_max is set (>1): a sudden reduction of the step
+    //  amplifies the corrections of implicit solvers (ex. DFSPH velocity ~ density error/dt), but leaves explicit solvers unstable
+    float increase_max = 1.25f;
+    float decrease_max = 0.0f;
+
+    // Reduction of the stable time step in ]0,1] (ex. after a rollback of a diverging simulation)
+    float dt_factor = 1.0f;
+
+    // Bounds of the number of substeps per frame (the last substeps are forced to be larger if substep_max is reached)
+    int substep_min = 1;
+    int substep_max = 100;
+
+    /** Largest time step satisfying all the stability limits of the measure (returns dt_max if no limit applies) */
+    float stable(timestep_measure const& measure, float dt_max) const;
+
+    /** Start a new frame of duration dt_frame */
+    void frame_start(float dt_frame);
+    /** True while the current frame is not fully covered by the previous substeps */
+    bool frame_running() const;
+    /** Time step of the next substep, such that the remaining frame time is covered by the minimal number of equal stable steps */
+    float next(timestep_measure const& measure);
+    /** Time step of the next substep when the step is fixed to dt (the last substep is shortened to end with the frame) */
+    float next(float dt);
+
+    // Statistics of the current (or last) frame
+    int substeps = 0;       // Number of substeps already computed
+    float dt_stable = 0.0f; // Last stable time step evaluated (0 before the first step)
+
+private:
+    float t_remaining = 0.0f;
+    float dt_frame = 0.0f;
+};
+
+}
@@ -97,6 +97,58 @@ namespace vcl
 
 			
 	}
+	static inline vec3 normal_grid_sample(vec3 const& d_a, vec3 const& d_b, float sign)
+	{
+		float const x = d_b.y*d_a.z - d_b.z*d_a.y;
+		float const y = d_b.z*d_a.x - d_b.x*d_a.z;
+		float const z = d_b.x*d_a.y - d_b.y*d_a.x;
+		float const L2 = x*x + y*y + z*z;
+		float const s = L2>1e-24f ? sign/std::sqrt(L2) : 0.0f;
+		return {s*x, s*y, s*z};
+	}
+
+	// Normals of the grid of N_a x N_b samples stored at a+N_a*b
+	static void normal_per_vertex_grid(vec3 const* p, int N_a, int N_b, vec3* n, bool invert)
+	{
+		float const sign = invert ? -1.0f : 1.0f;
+		#pragma omp parallel for
+		for(int b=0; b<N_b; ++b)
+		{
+			// Rows before and after (the row itself on the border)
+			vec3 const* row = p + N_a*b;
+			vec3 const* row_prev = p + N_a*std::max(b-1, 0);
+			vec3 const* row_next = p + N_a*std::min(b+1, N_b-1);
+			vec3* normal = n + N_a*b;
+
+			// Interior of the row without branch, then its two ends
+			for(int a=1; a<N_a-1; ++a)
+				normal[a] = normal_grid_sample(row[a+1]-row[a-1], row_next[a]-row_prev[a], sign);
+			normal[0] = normal_grid_sample(row[1]-row[0], row_next[0]-row_prev[0], sign);
+			normal[N_a-1] = normal_grid_sample(row[N_a-1]-row[N_a-2], row_next[N_a-1]-row_prev[N_a-1], sign);
+		}
+	}
+
+	void normal_per_vertex_grid(grid_2D<vec3> const& position, grid_2D<vec3>& normals, bool invert)
+	{
+		int const N_a = int(position.dimension.x);
+		int const N_b = int(position.dimension.y);
+		if(normals.dimension.x!=position.dimension.x || normals.dimension.y!=position.dimension.y)
+			normals.resize(N_a, N_b);
+		if(N_a<2 || N_b<2)
+			return;
+		normal_per_vertex_grid(&position.data[0], N_a, N_b, &normals.data[0], invert);
+	}
+
+	void normal_per_vertex_grid(buffer<vec3> const& position, int Nu, int Nv, buffer<vec3>& normals, bool invert)
+	{
+		assert_vcl(int(position.size())==Nu*Nv, "Incorrect number of grid samples");
+		if(normals.size()!=position.size())
+			normals.resize(position.size());
+		if(Nu<2 || Nv<2)
+			return;
+		normal_per_vertex_grid(&position[0], Nv, Nu, &normals[0], invert);
+	}
+
 	buffer<vec3> normal_per_vertex(buffer<vec3> const& position, buffer<uint3> const& connectivity, bool invert)
 	{
 		buffer<vec3> normals;
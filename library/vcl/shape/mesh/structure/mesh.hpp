@@ -31,6 +31,14 @@ namespace vcl
 	/** Compute automaticaly a per-vertex normal given a set of positions and their connectivity */
 	buffer<vec3> normal_per_vertex(buffer<vec3> const& position, buffer<uint3> const& connectivity, bool invert=false);
 
+	/** Per-vertex normal of a surface sampled on a regular grid (cloth, terrain, etc) without the connectivity
+	* The normal at (ku,kv) is the cross product of the central differences along the two directions of the grid (one-sided on the border)
+	* Each normal only depends on its 4 neighbors: no scattered write, the rows are computed in parallel
+	* The orientation is the one of normal_per_vertex on the connectivity of mesh_primitive_grid */
+	void normal_per_vertex_grid(grid_2D<vec3> const& position, grid_2D<vec3>& normals_to_fill, bool invert=false);
+	/** Version for the position buffer of mesh_primitive_grid(..., Nu, Nv) (sample (ku,kv) at index kv+Nv*ku) */
+	void normal_per_vertex_grid(buffer<vec3> const& position, int Nu, int Nv, buffer<vec3>& normals_to_fill, bool invert=false);
+
 	/** Check if the mesh looks coherent (correct indexing and size of buffer, no degenerate triangle, etc) */
 	bool mesh_check(mesh const& m);
 
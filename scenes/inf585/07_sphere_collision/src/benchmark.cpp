@@ -0,0 +1,153 @@
+#include "benchmark.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+
+using namespace vcl;
+
+
+// N spheres at random positions in the cube [-1,1]^3 (overlapping), the radii are scaled to fill a volume fraction of 20%
+//  uneven: radius proportional to 1+19u^4 (u uniform in [0,1]): many small spheres and a few large ones
+static std::vector<particle_structure> initialize_spheres_benchmark(int N, bool uneven)
+{
+    std::vector<particle_structure> particles(N);
+    double volume = 0.0;
+    for(particle_structure& particle : particles) {
+        particle.p = {rand_interval(-1,1), rand_interval(-1,1), rand_interval(-1,1)};
+        particle.v = {rand_interval(-1,1), rand_interval(-1,1), rand_interval(-1,1)};
+        float const u = rand_interval();
+        particle.r = uneven ? 1+19*u*u*u*u : 1.0f;
+        particle.m = 1.0f;
+        volume += 4.0/3.0*3.14159*particle.r*particle.r*particle.r;
+    }
+    float const scale = float(std::cbrt(0.2*8.0/volume));
+    for(particle_structure& particle : particles)
+        particle.r *= scale;
+    return particles;
+}
+
+void benchmark_broad_phase()
+{
+    std::cout<<std::endl<<"Broad phase of the sphere collisions"<<std::endl;
+    std::cout<<std::setw(8)<<"N"<<std::setw(10)<<"radii"<<std::setw(18)<<"method"<<std::setw(14)<<"search (ms)"<<std::setw(16)<<"next step (ms)"<<std::setw(10)<<"pairs"<<std::endl;
+    for(int N : {1000, 4000, 16000})
+    {
+        for(bool uneven : {false, true})
+        {
+            std::vector<particle_structure> const particles_initial = initialize_spheres_benchmark(N, uneven);
+            for(broad_phase_type type : {broad_phase_hash_grid, broad_phase_sweep_and_prune, broad_phase_all_pairs})
+            {
+                std::vector<particle_structure> particles = particles_initial;
+                broad_phase broad;
+                broad.type = type;
+
+                auto const t0 = std::chrono::steady_clock::now();
+                broad.find_pairs(particles);
+                auto const t1 = std::chrono::steady_clock::now();
+                size_t const pairs = broad.pairs.size();
+
+                // Motion of a time step (a fraction of the smallest radius)
+                for(particle_structure& particle : particles)
+                    particle.p += 0.005f*particle.v;
+                auto const t2 = std::chrono::steady_clock::now();
+                broad.find_pairs(particles);
+                auto const t3 = std::chrono::steady_clock::now();
+
+                char const* name[] = {"hash grid", "sweep and prune", "all pairs"};
+                std::cout<<std::setw(8)<<N<<std::setw(10)<<(uneven ? "uneven" : "equal")<<std::setw(18)<<name[type]
+                         <<std::setw(14)<<std::chrono::duration<float, std::milli>(t1-t0).count()
+                         <<std::setw(16)<<std::chrono::duration<float, std::milli>(t3-t2).count()<<std::setw(10)<<pairs<<std::endl;
+            }
+        }
+    }
+}
+
+// Total intersection depth per sphere and largest intersection depth, relative to the smallest radius of each pair
+static void measure_penetration(std::vector<particle_structure> const& particles, broad_phase& broad, float& mean, float& largest)
+{
+    broad.find_pairs(particles);
+    mean = 0.0f;
+    largest = 0.0f;
+    for(int2 const& pair : broad.pairs) {
+        particle_structure const& a = particles[pair.x];
+        particle_structure const& b = particles[pair.y];
+        float const penetration = (a.r+b.r-norm(a.p-b.p))/std::min(a.r, b.r);
+        if(penetration>0) {
+            mean += penetration;
+            largest = std::max(largest, penetration);
+        }
+    }
+    // Per sphere rather than per intersecting pair: the mean over the pairs rises when the shallow contacts are resolved
+    if(particles.size()>0)
+        mean /= particles.size();
+}
+
+void benchmark_contact_solver()
+{
+    int const N_steps = 40;
+    float const dt = 0.005f;
+    int const thread_count_initial = parallel_thread_count();
+
+    std::cout<<std::endl<<"Contact solver - piles of spheres, "<<N_steps<<" steps, "<<parallel_processor_count()<<" processor(s) available"<<std::endl;
+    std::cout<<std::setw(8)<<"N"<<std::setw(12)<<"solver"<<std::setw(12)<<"iterations"<<std::setw(10)<<"threads"<<std::setw(12)<<"contacts"<<std::setw(10)<<"colors"
+             <<std::setw(14)<<"step (ms)"<<std::setw(14)<<"depth/sphere"<<std::setw(14)<<"max depth"<<std::setw(24)<<"identical to 1 thread"<<std::endl;
+    for(int N : {2000, 8000})
+    {
+        // Spheres dropped from random positions, settled with the default solver
+        std::vector<particle_structure> pile(N);
+        float const r = 0.03f*std::cbrt(8000.0f/N);
+        for(particle_structure& particle : pile) {
+            particle.p = {rand_interval(-0.9f,0.9f), rand_interval(-0.9f,0.9f), rand_interval(-0.9f,0.9f)};
+            particle.v = {0,0,0};
+            particle.r = r*(1-0.3f*rand_interval());
+            particle.m = std::pow(particle.r/r, 3.0f);
+        }
+        broad_phase broad;
+        contact_solver settle;
+        for(int k_step=0; k_step<400; ++k_step)
+            simulate(pile, dt, broad, settle);
+
+        struct run_parameters { bool colored; int iterations; int threads; };
+        std::vector<run_parameters> const runs = { {false,1,1}, {false,4,1}, {true,1,1}, {true,2,1}, {true,4,1}, {true,4,2}, {true,4,4}, {true,8,1}, {true,16,1}, {true,16,4} };
+        std::vector<particle_structure> reference;
+        float depth_previous = 0.0f; // Mean depth of the previous number of iterations (colored, 1 thread)
+        bool decreasing = true;
+        for(run_parameters const& run : runs)
+        {
+            parallel_set_thread_count(run.threads);
+            std::vector<particle_structure> particles = pile;
+            contact_solver solver;
+            solver.colored = run.colored;
+            solver.iterations = run.iterations;
+            broad_phase broad_run;
+
+            int contacts = 0, colors = 0;
+            auto const t0 = std::chrono::steady_clock::now();
+            for(int k_step=0; k_step<N_steps; ++k_step) {
+                simulate(particles, dt, broad_run, solver);
+                contacts += solver.contact_count();
+                colors = std::max(colors, solver.color_count());
+            }
+            float const t = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now()-t0).count()/N_steps;
+
+            std::string identical = "";
+            if(run.colored && run.threads==1)
+                reference = particles;
+            else if(run.colored)
+                identical = std::memcmp(particles.data(), reference.data(), N*sizeof(particle_structure))==0 ? "yes" : "no";
+
+            float depth_mean, depth_max;
+            measure_penetration(particles, broad_run, depth_mean, depth_max);
+            if(run.colored && run.threads==1) {
+                if(run.iterations>1 && depth_mean>=depth_previous)
+                    decreasing = false;
+                depth_previous = depth_mean;
+            }
+            std::cout<<std::setw(8)<<N<<std::setw(12)<<(run.colored ? "colored" : "sequential")<<std::setw(12)<<run.iterations<<std::setw(10)<<run.threads
+                     <<std::setw(12)<<contacts/N_steps<<std::setw(10)<<colors<<std::setw(14)<<t<<std::setw(14)<<depth_mean<<std::setw(14)<<depth_max<<std::setw(24)<<identical<<std::endl;
+        }
+        std::cout<<"Depth per sphere decreasing with the iterations: "<<(decreasing ? "yes" : "no")<<std::endl;
+    }
+    parallel_set_thread_count(thread_count_initial);
+}
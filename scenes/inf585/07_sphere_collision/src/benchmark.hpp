@@ -0,0 +1,17 @@
+#pragma once
+
+#include "simulation.hpp"
+
+
+// Candidate pairs of 1000 to 16000 spheres in the cube [-1,1]^3 for the hash grid, the sweep and prune and the test of all the pairs
+//  Called when the program is run as: ./07_sphere_collision benchmark
+//  Spheres of equal radii, then of very uneven radii (1 to 20 times the smallest one), with the same volume fraction.
+//  Reports the time of a search, the time of the next search after a small motion of the spheres (the sweep and prune reuses
+//  its sorted order), and the number of pairs found (identical for all the methods)
+void benchmark_broad_phase();
+
+// Contact solver on piles of 2000 and 8000 spheres settled at the bottom of the cube
+//  Contacts solved one at a time (single thread) against the colored batches for 1 to 4 threads and increasing iterations.
+//  Reports the contacts and colors, the time of a step of the pile, the penetration per sphere and the largest one relative to the radius,
+//  and checks that the colored results are bitwise identical whatever the number of threads, and that more iterations reduce the penetration per sphere
+void benchmark_contact_solver();
@@ -0,0 +1,162 @@
+#include "broad_phase.hpp"
+#include "simulation.hpp"
+
+#include <algorithm>
+
+using namespace vcl;
+
+
+bool bounding_box_overlap(particle_structure const& a, particle_structure const& b)
+{
+    float const r = a.r + b.r;
+    return std::abs(a.p.x-b.p.x)<=r && std::abs(a.p.y-b.p.y)<=r && std::abs(a.p.z-b.p.z)<=r;
+}
+
+void broad_phase::find_pairs(std::vector<particle_structure> const& particles)
+{
+    pairs.clear();
+    if(type==broad_phase_hash_grid)
+        find_pairs_hash_grid(particles);
+    else if(type==broad_phase_sweep_and_prune)
+        find_pairs_sweep_and_prune(particles);
+    else
+        find_pairs_all(particles);
+}
+
+// Same test on spheres stored as (center, radius)
+static bool bounding_box_overlap(vec4 const& a, vec4 const& b)
+{
+    float const r = a.w + b.w;
+    return std::abs(a.x-b.x)<=r && std::abs(a.y-b.y)<=r && std::abs(a.z-b.z)<=r;
+}
+
+static bool same_cell(int3 const& a, int3 const& b)
+{
+    return a.x==b.x && a.y==b.y && a.z==b.z;
+}
+
+int broad_phase::bucket(int3 const& c) const
+{
+    // Hash of the cell coordinates [Teschner et al. 2003], the number of buckets is a power of two (mask instead of a modulo)
+    unsigned int const h = (unsigned(c.x)*73856093u) ^ (unsigned(c.y)*19349663u) ^ (unsigned(c.z)*83492791u);
+    return int(h & bucket_mask);
+}
+
+void broad_phase::find_pairs_hash_grid(std::vector<particle_structure> const& particles)
+{
+    int const N = int(particles.size());
+    if(N==0)
+        return;
+
+    // Two overlapping spheres have their centers closer than the largest diameter: they are in neighbor cells
+    float r_max = 0.0f;
+    for(particle_structure const& particle : particles)
+        r_max = std::max(r_max, particle.r);
+    cell_size = 2*r_max;
+
+    cell.resize(N);
+    for(int k=0; k<N; ++k) {
+        vec3 const& p = particles[k].p;
+        cell[k] = { int(std::floor(p.x/cell_size)), int(std::floor(p.y/cell_size)), int(std::floor(p.z/cell_size)) };
+    }
+
+    // Counting sort of the spheres by bucket (at least two buckets per sphere: unrelated cells seldom share a bucket)
+    int N_bucket = 1;
+    while(N_bucket<2*N)
+        N_bucket *= 2;
+    bucket_mask = unsigned(N_bucket-1);
+    bucket_start.assign(N_bucket+1, 0);
+    for(int k=0; k<N; ++k)
+        bucket_start[bucket(cell[k])+1]++;
+    for(int b=0; b<N_bucket; ++b)
+        bucket_start[b+1] += bucket_start[b];
+    sorted_index.resize(N);
+    bucket_fill.assign(bucket_start.begin(), bucket_start.end()-1);
+    for(int k=0; k<N; ++k)
+        sorted_index[bucket_fill[bucket(cell[k])]++] = k;
+
+    // Copy of the cells and of the spheres in the sorted order: the candidates of a bucket are read contiguously
+    sorted_cell.resize(N);
+    sorted_sphere.resize(N);
+    for(int k=0; k<N; ++k) {
+        particle_structure const& particle = particles[sorted_index[k]];
+        sorted_cell[k] = cell[sorted_index[k]];
+        sorted_sphere[k] = {particle.p.x, particle.p.y, particle.p.z, particle.r};
+    }
+
+    // Each pair of neighbor cells is visited once: the cell of the sphere (spheres after it in the bucket) and the 13 cells
+    //  after it in z,y,x order. Different cells can share a bucket: the spheres of the bucket that are not in the visited cell are skipped.
+    int3 const forward[13] = { {1,0,0}, {-1,1,0}, {0,1,0}, {1,1,0},
+        {-1,-1,1}, {0,-1,1}, {1,-1,1}, {-1,0,1}, {0,0,1}, {1,0,1}, {-1,1,1}, {0,1,1}, {1,1,1} };
+    for(int k_i=0; k_i<N; ++k_i) {
+        int3 const c = sorted_cell[k_i];
+        vec4 const sphere = sorted_sphere[k_i];
+        int const i = sorted_index[k_i];
+
+        int const b = bucket(c);
+        for(int k=k_i+1; k<bucket_start[b+1]; ++k)
+            if(same_cell(sorted_cell[k], c) && bounding_box_overlap(sphere, sorted_sphere[k]))
+                pairs.push_back({std::min(i,sorted_index[k]), std::max(i,sorted_index[k])});
+
+        for(int3 const& offset : forward) {
+            int3 const neighbor = {c.x+offset.x, c.y+offset.y, c.z+offset.z};
+            int const b_neighbor = bucket(neighbor);
+            for(int k=bucket_start[b_neighbor]; k<bucket_start[b_neighbor+1]; ++k)
+                if(same_cell(sorted_cell[k], neighbor) && bounding_box_overlap(sphere, sorted_sphere[k]))
+                    pairs.push_back({std::min(i,sorted_index[k]), std::max(i,sorted_index[k])});
+        }
+    }
+}
+
+void broad_phase::find_pairs_sweep_and_prune(std::vector<particle_structure> const& particles)
+{
+    int const N = int(particles.size());
+
+    // New spheres are appended to the order of the previous call, removed spheres are discarded
+    if(int(order.size())>N)
+        order.clear();
+    int const N_sorted = int(order.size());
+    for(int k=N_sorted; k<N; ++k)
+        order.push_back(k);
+
+    // Full sort when most of the spheres are new (first call), the insertion sort would be quadratic
+    auto start = [&particles](int k) { return particles[k].p.x - particles[k].r; };
+    if(N-N_sorted > N/8+16)
+        std::sort(order.begin(), order.end(), [&start](int a, int b) { return start(a)<start(b); });
+
+    // Insertion sort by the start of the x interval: a few swaps per sphere when the order of the previous call is almost sorted
+    interval_min.resize(N);
+    for(int k=0; k<N; ++k)
+        interval_min[k] = start(order[k]);
+    for(int k=1; k<N; ++k) {
+        int const index = order[k];
+        float const value = interval_min[k];
+        int m = k-1;
+        for(; m>=0 && interval_min[m]>value; --m) {
+            order[m+1] = order[m];
+            interval_min[m+1] = interval_min[m];
+        }
+        order[m+1] = index;
+        interval_min[m+1] = value;
+    }
+
+    // Sweep: the spheres starting before the end of the interval of a sphere overlap it along x
+    for(int k=0; k<N; ++k) {
+        int const i = order[k];
+        float const interval_max = particles[i].p.x + particles[i].r;
+        for(int m=k+1; m<N && interval_min[m]<=interval_max; ++m) {
+            int const j = order[m];
+            if(bounding_box_overlap(particles[i], particles[j]))
+                pairs.push_back({std::min(i,j), std::max(i,j)});
+        }
+    }
+}
+
+void broad_phase::find_pairs_all(std::vector<particle_structure> const& particles)
+{
+    int const N = int(particles.size());
+    for(int i=0; i<N; ++i)
+        for(int j=i+1; j<N; ++j)
+            if(bounding_box_overlap(particles[i], particles[j]))
+                pairs.push_back({i, j});
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "vcl/vcl.hpp"
+
+#include <vector>
+
+struct particle_structure;
+
+
+// Broad phase of the sphere-sphere collisions: candidate pairs of spheres whose bounding boxes overlap, without testing all the pairs
+//  - hash_grid: uniform grid of cells of the largest diameter, each sphere is stored in the cell of its center (counting sort of
+//    the spheres by hashed cell, table of two to four buckets per sphere). The overlapping spheres are in the 27 neighbor cells.
+//  - sweep_and_prune: the spheres are sorted along x by the start of their interval [p.x-r, p.x+r] and the overlapping intervals
+//    are swept. The order of the previous call is kept: the insertion sort of an almost sorted list is close to linear.
+//    Independent of the sizes of the spheres, adapted to very uneven radii (the cells of the hash grid are sized by the largest sphere).
+//  - all_pairs: reference test of the N(N-1)/2 pairs
+enum broad_phase_type { broad_phase_hash_grid, broad_phase_sweep_and_prune, broad_phase_all_pairs };
+
+struct broad_phase
+{
+    broad_phase_type type = broad_phase_hash_grid;
+    std::vector<vcl::int2> pairs; // Candidate pairs (i<j) of the last call
+
+    // Fill pairs with the spheres whose bounding boxes overlap
+    void find_pairs(std::vector<particle_structure> const& particles);
+
+private:
+    void find_pairs_hash_grid(std::vector<particle_structure> const& particles);
+    void find_pairs_sweep_and_prune(std::vector<particle_structure> const& particles);
+    void find_pairs_all(std::vector<particle_structure> const& particles);
+
+    // Hash grid
+    float cell_size = 0.0f;
+    std::vector<vcl::int3> cell;     // Cell of the center of each sphere
+    std::vector<int> bucket_start;   // Offset of the first sphere of each bucket in sorted_index (size = number of buckets + 1)
+    std::vector<int> sorted_index;   // Spheres sorted by bucket
+    std::vector<vcl::int3> sorted_cell;   // Cells and spheres (center, radius) in the order of sorted_index
+    std::vector<vcl::vec4> sorted_sphere;
+    std::vector<int> bucket_fill;    // Insertion offset per bucket used by the counting sort
+    unsigned int bucket_mask = 0;    // Number of buckets - 1
+    int bucket(vcl::int3 const& c) const;
+
+    // Sweep and prune
+    std::vector<int> order;          // Spheres sorted by the start of their x interval
+    std::vector<float> interval_min; // Start of the x interval of the spheres in order
+};
+
+// Overlap of the axis aligned bounding boxes of two spheres
+bool bounding_box_overlap(particle_structure const& a, particle_structure const& b);
@@ -0,0 +1,87 @@
+#include "contact_solver.hpp"
+#include "simulation.hpp"
+
+using namespace vcl;
+
+
+void contact_solver::color_contacts(int N)
+{
+    int const N_contact = int(contacts_unsorted.size());
+    used_colors.assign(N, 0);
+    contact_color.resize(N_contact);
+
+    // Greedy coloring: lowest color free on both spheres (color_max if there is none)
+    int color_count = 0;
+    for(int k=0; k<N_contact; ++k) {
+        int2 const& c = contacts_unsorted[k];
+        uint64_t const used = used_colors[c.x] | used_colors[c.y];
+        int color = 0;
+        while(color<color_max && (used>>color)&1)
+            ++color;
+        if(color<color_max) {
+            used_colors[c.x] |= uint64_t(1)<<color;
+            used_colors[c.y] |= uint64_t(1)<<color;
+        }
+        contact_color[k] = color;
+        color_count = std::max(color_count, color+1);
+    }
+
+    // Counting sort of the contacts by color
+    color_start.assign(color_count+1, 0);
+    for(int k=0; k<N_contact; ++k)
+        color_start[contact_color[k]+1]++;
+    for(int color=0; color<color_count; ++color)
+        color_start[color+1] += color_start[color];
+    color_fill.assign(color_start.begin(), color_start.end()-1);
+    contacts.resize(N_contact);
+    for(int k=0; k<N_contact; ++k)
+        contacts[color_fill[contact_color[k]]++] = contacts_unsorted[k];
+}
+
+void contact_solver::solve(std::vector<particle_structure>& particles, std::vector<int2> const& pairs)
+{
+    int const N = int(particles.size());
+
+    // Narrow phase: the candidate pairs that intersect or are about to (within the margin)
+    contacts_unsorted.clear();
+    for(int2 const& pair : pairs) {
+        particle_structure const& a = particles[pair.x];
+        particle_structure const& b = particles[pair.y];
+        if(norm(a.p-b.p) < (1+margin)*(a.r+b.r))
+            contacts_unsorted.push_back(pair);
+    }
+
+    if(!colored) {
+        contacts = contacts_unsorted;
+        color_start = {0, int(contacts.size())};
+        for(int k_iteration=0; k_iteration<iterations; ++k_iteration) {
+            for(int2 const& contact : contacts)
+                collide_spheres(particles[contact.x], particles[contact.y], k_iteration==0);
+            for(particle_structure& particle : particles)
+                collide_cube(particle);
+        }
+        return;
+    }
+
+    color_contacts(N);
+    int const color_count = int(color_start.size())-1;
+    for(int k_iteration=0; k_iteration<iterations; ++k_iteration) {
+        bool const bounce = k_iteration==0;
+        for(int color=0; color<color_count; ++color) {
+            int const k_start = color_start[color], k_end = color_start[color+1];
+            if(color==color_max) {
+                // Extra contacts of the spheres with more than color_max contacts
+                for(int k=k_start; k<k_end; ++k)
+                    collide_spheres(particles[contacts[k].x], particles[contacts[k].y], bounce);
+                continue;
+            }
+            #pragma omp parallel for
+            for(int k=k_start; k<k_end; ++k)
+                collide_spheres(particles[contacts[k].x], particles[contacts[k].y], bounce);
+        }
+
+        #pragma omp parallel for
+        for(int k=0; k<N; ++k)
+            collide_cube(particles[k]);
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "vcl/vcl.hpp"
+
+#include <cstdint>
+#include <vector>
+
+struct particle_structure;
+
+
+// Resolution of the sphere-sphere contacts by batches of independent contacts
+//  - The contacts (pairs of the broad phase closer than the margin) are the edges of a graph on the spheres. A greedy coloring gives each
+//    contact the smallest color not used yet by the contacts of its two spheres (bit mask of the used colors per sphere).
+//  - Two contacts of the same color share no sphere: the contacts of a color are solved in parallel without synchronization,
+//    the colors one after the other. The result does not depend on the number of threads.
+//  - An iteration solves all the colors with collide_spheres (projection of the positions, impulse on the approaching velocities),
+//    then the walls. More iterations propagate the corrections through the layers of a dense pile.
+//  - Only the first iteration bounces the contacts with restitution: the next ones remove the approaching velocities (inelastic),
+//    a contact reflected again at each iteration would gain velocity instead of settling.
+//  - The pairs that do not intersect yet are kept as contacts within the margin: the corrections of an iteration push the spheres
+//    into their near neighbors, which the next iterations can then separate (collide_spheres ignores the pairs that do not intersect).
+//  A sphere with more than color_max contacts is very unlikely: its extra contacts are solved sequentially after the colors.
+struct contact_solver
+{
+    static int const color_max = 64;
+
+    int iterations = 4;
+    bool colored = true; // false: the contacts are solved one at a time in the order of the pairs (single thread)
+    float margin = 0.1f; // The pairs closer than (1+margin)(r_a+r_b) are kept as contacts even if they do not intersect yet
+
+    // Solve the contacts among the candidate pairs of the broad phase, and the collisions with the cube
+    void solve(std::vector<particle_structure>& particles, std::vector<vcl::int2> const& pairs);
+
+    // Statistics of the last call
+    int contact_count() const { return int(contacts.size()); }
+    int color_count() const { return int(color_start.size())-1; }
+
+private:
+    std::vector<vcl::int2> contacts;      // Pairs within the margin, sorted by color
+    std::vector<int> color_start;         // Offset of the first contact of each color (the last color holds the extra contacts)
+    std::vector<vcl::int2> contacts_unsorted;
+    std::vector<int> contact_color;
+    std::vector<int> color_fill;          // Insertion offset per color used by the counting sort
+    std::vector<uint64_t> used_colors;    // Colors of the contacts of each sphere
+
+    void color_contacts(int N);
+};
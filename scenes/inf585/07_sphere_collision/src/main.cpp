@@ -2,6 +2,7 @@
 #include <iostream>
 
 #include "simulation.hpp"
+#include "benchmark.hpp"
 
 
 using namespace vcl;
@@ -9,6 +10,9 @@ using namespace vcl;
 struct gui_parameters {
 	bool display_frame = true;
 	bool add_sphere = true;
+	bool adaptive_timestep = true; // Subdivide the frame into stable substeps (CFL condition)
+	int spheres_per_event = 1;     // Spheres emitted at each event of the timer
+	float radius_variation = 0.0f; // Radii drawn in [r(1-variation), r]
 };
 
 struct user_interaction_parameters {
@@ -33,7 +37,10 @@ mesh_drawable sphere;
 segments_drawable cube_wireframe;
 
 timer_event_periodic timer(0.5f);
+timestep_adaptive timestep;
 std::vector<particle_structure> particles;
+broad_phase collision_pairs;
+contact_solver contacts;
 
 
 void mouse_move_callback(GLFWwindow* window, double xpos, double ypos);
@@ -45,11 +52,18 @@ void display_interface();
 void emit_particle();
 
 
-int main(int, char* argv[])
+int main(int argc, char* argv[])
 {
 
 	std::cout << "Run " << argv[0] << std::endl;
 
+	// Run the timing of the broad phase and of the contact solver without display: ./07_sphere_collision benchmark
+	if(argc>1 && std::string(argv[1])=="benchmark") {
+		benchmark_broad_phase();
+		benchmark_contact_solver();
+		return 0;
+	}
+
 	int const width = 1280, height = 1024;
 	GLFWwindow* window = create_window(width, height);
 	window_size_callback(window, width, height);
@@ -90,7 +104,13 @@ int main(int, char* argv[])
 		emit_particle();
 		display_interface();
 		float const dt = 0.01f * timer.scale;
-		simulate(particles, dt);
+		if(user.gui.adaptive_timestep) {
+			timestep.frame_start(dt);
+			while(timestep.frame_running())
+				simulate(particles, timestep.next(measure_timestep(particles)), collision_pairs, contacts);
+		}
+		else
+			simulate(particles, dt, collision_pairs, contacts);
 		display_scene();
 
 
@@ -114,17 +134,21 @@ void emit_particle()
 	//  Assume first that all particles have the same radius and mass
 	static buffer<vec3> const color_lut = {{1,0,0},{0,1,0},{0,0,1},{1,1,0},{1,0,1},{0,1,1}};
 	if (timer.event && user.gui.add_sphere) {
-		float const theta = rand_interval(0, 2*pi);
-		vec3 const v = vec3(1.0f*std::cos(theta), 1.0f*std::sin(theta), 4.0f);
-
-		particle_structure particle;
-		particle.p = {0,0,0};
-		particle.r = 0.08f;
-		particle.c = color_lut[int(rand_interval()*color_lut.size())];
-		particle.v = v;
-		particle.m = 1.0f; //
-
-		particles.push_back(particle);
+		for(int k=0; k<user.gui.spheres_per_event; ++k) {
+			float const theta = rand_interval(0, 2*pi);
+			vec3 const v = vec3(1.0f*std::cos(theta), 1.0f*std::sin(theta), 4.0f);
+
+			particle_structure particle;
+			particle.p = {0,0,0};
+			if(k>0) // Several spheres per event start at different positions
+				particle.p = {rand_interval(-0.6f,0.6f), rand_interval(-0.6f,0.6f), rand_interval(-0.3f,0.3f)};
+			particle.r = 0.08f*(1-user.gui.radius_variation*rand_interval());
+			particle.c = color_lut[int(rand_interval()*color_lut.size())];
+			particle.v = v;
+			particle.m = std::pow(particle.r/0.08f, 3.0f); // Same density for all the spheres
+
+			particles.push_back(particle);
+		}
 	}
 }
 
@@ -177,6 +201,21 @@ void display_interface()
 	ImGui::SliderFloat("Time scale", &timer.scale, 0.05f, 2.0f, "%.2f s");
     ImGui::SliderFloat("Interval create sphere", &timer.event_period, 0.05f, 2.0f, "%.2f s");
     ImGui::Checkbox("Add sphere", &user.gui.add_sphere);
+    ImGui::Checkbox("Adaptive time step", &user.gui.adaptive_timestep);
+    ImGui::Text("Substeps: %d", timestep.substeps);
+    ImGui::SliderInt("Spheres per event", &user.gui.spheres_per_event, 1, 50);
+    ImGui::SliderFloat("Radius variation", &user.gui.radius_variation, 0.0f, 0.9f, "%.2f");
+
+    int* ptr_broad_phase = reinterpret_cast<int*>(&collision_pairs.type);
+    ImGui::RadioButton("Hash grid", ptr_broad_phase, broad_phase_hash_grid); ImGui::SameLine();
+    ImGui::RadioButton("Sweep and prune", ptr_broad_phase, broad_phase_sweep_and_prune); ImGui::SameLine();
+    ImGui::RadioButton("All pairs", ptr_broad_phase, broad_phase_all_pairs);
+    ImGui::Text("%d spheres, %d candidate pairs", int(particles.size()), int(collision_pairs.pairs.size()));
+    ImGui::Checkbox("Colored parallel contacts", &contacts.colored);
+    ImGui::SliderInt("Contact iterations", &contacts.iterations, 1, 32);
+    ImGui::Text("%d contacts, %d colors", contacts.contact_count(), contacts.color_count());
+    if(ImGui::Button("Clear spheres"))
+        particles.clear();
 }
 
 
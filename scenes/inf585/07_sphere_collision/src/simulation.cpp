@@ -5,7 +5,11 @@ using namespace vcl;
 
 
 
-void simulate(std::vector<particle_structure>& particles, float dt)
+// Fraction of the normal velocity kept after a collision
+static float const restitution = 0.6f;
+
+
+void simulate(std::vector<particle_structure>& particles, float dt, broad_phase& collision_pairs, contact_solver& contacts)
 {
 	vec3 const g = {0,0,-9.81f};
 	size_t const N = particles.size();
@@ -15,10 +19,66 @@ void simulate(std::vector<particle_structure>& particles, float dt)
 
 		vec3 const f = particle.m * g;
 
-		particle.v = (1-0.9f*dt)*particle.v + dt*f;
+		particle.v = (1-0.9f*dt)*particle.v + dt*f/particle.m;
 		particle.p = particle.p + dt*particle.v;
 	}
 
-	// To do :
-	//  Handle collision ...
+	// Collisions between spheres: exact test of the candidate pairs only
+	collision_pairs.find_pairs(particles);
+	contacts.solve(particles, collision_pairs.pairs);
+}
+
+void collide_spheres(particle_structure& a, particle_structure& b, bool bounce)
+{
+	vec3 const d = a.p - b.p;
+	float const distance = norm(d);
+	float const penetration = a.r + b.r - distance;
+	if(penetration<=0 || distance<1e-6f)
+		return;
+
+	vec3 const n = d/distance;
+	float const w_a = 1.0f/a.m, w_b = 1.0f/b.m;
+	a.p += penetration*w_a/(w_a+w_b)*n;
+	b.p -= penetration*w_b/(w_a+w_b)*n;
+
+	float const v_normal = dot(a.v-b.v, n);
+	if(v_normal<0) {
+		float const impulse = -(1+(bounce ? restitution : 0.0f))*v_normal/(w_a+w_b);
+		a.v += impulse*w_a*n;
+		b.v -= impulse*w_b*n;
+	}
+}
+
+void collide_cube(particle_structure& particle)
+{
+	for(int c=0; c<3; ++c) {
+		float const limit = 1.0f - particle.r;
+		if(particle.p[c] < -limit) {
+			particle.p[c] = -limit;
+			particle.v[c] = std::abs(particle.v[c])*restitution;
+		}
+		if(particle.p[c] > limit) {
+			particle.p[c] = limit;
+			particle.v[c] = -std::abs(particle.v[c])*restitution;
+		}
+	}
+}
+
+timestep_measure measure_timestep(std::vector<particle_structure> const& particles)
+{
+	timestep_measure measure;
+	if(particles.size()==0)
+		return measure;
+
+	float r_min = particles[0].r;
+	float v_max = 0.0f;
+	for(particle_structure const& particle : particles) {
+		r_min = std::min(r_min, particle.r);
+		v_max = std::max(v_max, norm(particle.v));
+	}
+
+	measure.length = r_min;
+	measure.velocity_max = v_max;
+	measure.acceleration_max = 9.81f;
+	return measure;
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "vcl/vcl.hpp"
+#include "broad_phase.hpp"
+#include "contact_solver.hpp"
 
 struct particle_structure
 {
@@ -12,6 +14,15 @@ struct particle_structure
     float m;     // mass
 };
 
-void simulate(std::vector<particle_structure>& particles, float dt);
+// Integration of the spheres, then collisions between the spheres (candidate pairs given by the broad phase) and with the cube [-1,1]^3
+//  solved by the contact solver
+void simulate(std::vector<particle_structure>& particles, float dt, broad_phase& collision_pairs, contact_solver& contacts);
 
+// Response to the contact of two spheres (nothing is done if they do not intersect): the spheres are separated along their
+//  normal in proportion to their inverse mass, and the approaching normal velocity is reflected with restitution
+//  (bounce=false: the approaching normal velocity is only removed, inelastic correction)
+void collide_spheres(particle_structure& a, particle_structure& b, bool bounce=true);
+void collide_cube(particle_structure& particle);
 
+// Stability measure for the adaptive time step: a sphere should not move more than a fraction of the smallest radius per step (no tunneling through collisions)
+vcl::timestep_measure measure_timestep(std::vector<particle_structure> const& particles);
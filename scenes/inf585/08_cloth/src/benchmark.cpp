@@ -0,0 +1,446 @@
+#include "benchmark.hpp"
+#include "closest_point.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+
+using namespace vcl;
+
+
+// Cloth of N x N particles at z=1 attached by two corners, as in the scene
+struct cloth_benchmark
+{
+    grid_2D<vec3> position, velocity, forces, normal;
+    std::map<size_t, vec3> positional_constraints;
+    implicit_solver_data implicit_solver;
+    buffer<uint3> triangles;
+
+    explicit cloth_benchmark(int N)
+    {
+        position.resize(N, N);
+        for(int kv=0; kv<N; ++kv)
+            for(int ku=0; ku<N; ++ku)
+                position(ku,kv) = {ku/(N-1.0f), kv/(N-1.0f), 1.0f};
+        for(int kv=0; kv<N-1; ++kv) {
+            for(int ku=0; ku<N-1; ++ku) {
+                unsigned int const k = ku+N*kv;
+                triangles.push_back({k, k+1, k+1+N});
+                triangles.push_back({k, k+1+N, k+N});
+            }
+        }
+        velocity.resize(N, N);
+        forces.resize(N, N);
+        normal.resize(N, N);
+        positional_constraints[position.index_to_offset(0,0)] = position(0,0);
+        positional_constraints[position.index_to_offset(N-1,0)] = position(N-1,0);
+    }
+};
+
+// Maximal relative elongation of the structural springs
+static float stretch_max(grid_2D<vec3> const& position)
+{
+    int const N = int(position.dimension.x);
+    float const L0 = 1.0f/(N-1.0f);
+    float stretch = 0.0f;
+    for_each_spring(N, L0, [&](int i, int j, int s, float L) {
+        if(s<2)
+            stretch = std::max(stretch, norm(position[j]-position[i])/L-1);
+    });
+    return stretch;
+}
+
+enum benchmark_run { run_explicit, run_adaptive, run_implicit, run_projective };
+
+// Simulate N_frames of the cloth and print one line of the table
+//  explicit: 5 fixed steps per frame - adaptive: explicit with the adaptive time step - implicit and projective: one step per frame
+static void benchmark_run_cloth(int N, float K, benchmark_run run, int N_frames, float dt_frame)
+{
+    simulation_parameters parameters;
+    initialize_simulation_parameters(parameters, 1.0f, N);
+    parameters.K = K;
+    parameters.integrator = run==run_implicit ? cloth_integrator_implicit : (run==run_projective ? cloth_integrator_projective : cloth_integrator_explicit);
+    float const m = parameters.mass_total/(N*N);
+    obstacles_parameters obstacles;
+    obstacles.z_ground = -10.0f; // no contact
+
+    cloth_benchmark cloth(N);
+    projective_dynamics_data projective_solver;
+    timestep_adaptive timestep;
+    initialize_timestep(timestep);
+    int steps = 0, iterations = 0;
+    bool diverged = false;
+
+    auto const t0 = std::chrono::steady_clock::now();
+    for(int k_frame=0; k_frame<N_frames && !diverged; ++k_frame)
+    {
+        timestep.frame_start(dt_frame);
+        while(timestep.frame_running() && !diverged)
+        {
+            float const dt = run==run_adaptive ?
+                timestep.next(measure_timestep(cloth.velocity, cloth.forces, parameters)) :
+                timestep.next(run==run_explicit ? dt_frame/5 : dt_frame);
+            compute_forces(cloth.forces, cloth.position, cloth.velocity, cloth.normal, parameters, 0.0f);
+            if(run==run_implicit) {
+                numerical_integration_implicit(cloth.position, cloth.velocity, cloth.forces, cloth.positional_constraints, parameters, cloth.implicit_solver, dt);
+                iterations += cloth.implicit_solver.iterations;
+            }
+            else if(run==run_projective) {
+                numerical_integration_projective(cloth.position, cloth.velocity, cloth.positional_constraints, parameters, projective_solver, dt);
+                iterations += projective_solver.iterations;
+            }
+            else
+                numerical_integration(cloth.position, cloth.velocity, cloth.forces, m, dt);
+            apply_constraints(cloth.position, cloth.velocity, cloth.positional_constraints, obstacles);
+            steps++;
+
+            // Same criterion than the scene, without its console messages
+            diverged = detect_simulation_divergence(cloth.forces, cloth.position, false);
+        }
+    }
+    auto const t1 = std::chrono::steady_clock::now();
+
+    char const* name[] = {"explicit", "adaptive", "implicit", "projective"};
+    std::cout<<std::setw(10)<<K<<std::setw(12)<<name[run]<<std::setw(14)<<float(steps)/N_frames;
+    std::cout<<std::setw(18)<<float(iterations)/steps<<std::setw(14)<<(diverged ? 0.0f : 100*stretch_max(cloth.position));
+    std::cout<<std::setw(12)<<(diverged?"yes":"no")<<std::setw(14)<<std::chrono::duration<float, std::milli>(t1-t0).count()/N_frames<<std::endl;
+}
+
+void benchmark_cloth_integrator()
+{
+    int const N_frames = 200;
+    float const dt_frame = 5*0.005f; // Duration of a frame in the scene
+
+    // The explicit integrations are only run on the small cloth
+    for(int N : {30, 100})
+    {
+        std::cout<<std::endl<<N<<"x"<<N<<" cloth - "<<N_frames<<" frames of "<<dt_frame<<"s"<<std::endl;
+        std::cout<<std::setw(10)<<"K"<<std::setw(12)<<"integrator"<<std::setw(14)<<"steps/frame"<<std::setw(18)<<"iterations/step"<<std::setw(14)<<"stretch (%)"<<std::setw(12)<<"diverged"<<std::setw(14)<<"frame (ms)"<<std::endl;
+        for(float K : {5.0f, 50.0f, 500.0f, 5000.0f})
+            for(benchmark_run run : {run_explicit, run_adaptive, run_implicit, run_projective})
+                if(N<=30 || run==run_implicit || run==run_projective)
+                    benchmark_run_cloth(N, K, run, N_frames, dt_frame);
+    }
+}
+
+void benchmark_cloth_projective_timestep()
+{
+    int const N_frames = 120;
+    float const dt_frame = 5*0.005f;
+
+    for(int N : {50, 100})
+    {
+        std::cout<<std::endl<<N<<"x"<<N<<" cloth falling on the sphere - projective dynamics with the adaptive time step, "<<N_frames<<" frames of "<<dt_frame<<"s"<<std::endl;
+        std::cout<<std::setw(14)<<"dt tolerance"<<std::setw(14)<<"steps/frame"<<std::setw(16)<<"factorizations"<<std::setw(14)<<"frame (ms)"<<std::setw(14)<<"stretch (%)"<<std::setw(26)<<"difference to tolerance 1"<<std::endl;
+        grid_2D<vec3> position_reference;
+        for(float dt_tolerance : {1.0f, 1.2f, 1.5f})
+        {
+            simulation_parameters parameters;
+            initialize_simulation_parameters(parameters, 1.0f, N);
+            parameters.integrator = cloth_integrator_projective;
+            obstacles_parameters obstacles;
+
+            cloth_benchmark cloth(N);
+            projective_dynamics_data projective_solver;
+            projective_solver.dt_tolerance = dt_tolerance;
+            timestep_adaptive timestep;
+            int steps = 0;
+
+            auto const t0 = std::chrono::steady_clock::now();
+            for(int k_frame=0; k_frame<N_frames; ++k_frame)
+            {
+                timestep.frame_start(dt_frame);
+                while(timestep.frame_running())
+                {
+                    float const dt = timestep.next(measure_timestep(cloth.velocity, cloth.forces, parameters));
+                    compute_forces(cloth.forces, cloth.position, cloth.velocity, cloth.normal, parameters, 0.0f);
+                    numerical_integration_projective(cloth.position, cloth.velocity, cloth.positional_constraints, parameters, projective_solver, dt);
+                    apply_constraints(cloth.position, cloth.velocity, cloth.positional_constraints, obstacles);
+                    steps++;
+                }
+            }
+            auto const t1 = std::chrono::steady_clock::now();
+
+            if(dt_tolerance==1.0f)
+                position_reference = cloth.position;
+            float difference = 0.0f;
+            for(size_t k=0; k<cloth.position.size(); ++k)
+                difference = std::max(difference, norm(cloth.position[k]-position_reference[k]));
+
+            std::cout<<std::setw(14)<<dt_tolerance<<std::setw(14)<<float(steps)/N_frames<<std::setw(16)<<projective_solver.factorizations;
+            std::cout<<std::setw(14)<<std::chrono::duration<float, std::milli>(t1-t0).count()/N_frames<<std::setw(14)<<100*stretch_max(cloth.position)<<std::setw(26)<<difference<<std::endl;
+        }
+    }
+}
+
+void benchmark_cloth_self_collision()
+{
+    int const N_frames = 60;
+    float const dt_frame = 5*0.005f;
+
+    std::cout<<std::endl<<"Cloth falling on the sphere and the ground - projective dynamics, "<<N_frames<<" frames of "<<dt_frame<<"s"<<std::endl;
+    std::cout<<std::setw(10)<<"N"<<std::setw(18)<<"self collision"<<std::setw(12)<<"contacts"<<std::setw(16)<<"solver (ms)"<<std::setw(18)<<"collision (ms)"<<std::endl;
+    for(int N : {50, 100, 200})
+    {
+        for(bool self_collision : {false, true})
+        {
+            simulation_parameters parameters;
+            initialize_simulation_parameters(parameters, 1.0f, N);
+            parameters.K = 50.0f;
+            obstacles_parameters obstacles;
+            obstacles.sphere_center = {0.5f, 0.5f, 0.0f};
+            obstacles.sphere_radius = 0.3f;
+
+            cloth_benchmark cloth(N);
+            cloth.positional_constraints.clear(); // The cloth falls freely
+            projective_dynamics_data projective_solver;
+            cloth_self_collision collision;
+
+            float t_solver = 0.0f, t_collision = 0.0f;
+            int contacts = 0;
+            for(int k_frame=0; k_frame<N_frames; ++k_frame)
+            {
+                auto const t0 = std::chrono::steady_clock::now();
+                numerical_integration_projective(cloth.position, cloth.velocity, cloth.positional_constraints, parameters, projective_solver, dt_frame);
+                auto const t1 = std::chrono::steady_clock::now();
+                if(self_collision) {
+                    apply_self_collision(cloth.position, cloth.velocity, cloth.triangles, collision);
+                    contacts += collision.contacts;
+                }
+                auto const t2 = std::chrono::steady_clock::now();
+                apply_constraints(cloth.position, cloth.velocity, cloth.positional_constraints, obstacles);
+
+                // The first frame includes the factorization of the projective dynamics
+                if(k_frame>0) {
+                    t_solver += std::chrono::duration<float, std::milli>(t1-t0).count();
+                    t_collision += std::chrono::duration<float, std::milli>(t2-t1).count();
+                }
+            }
+
+            std::cout<<std::setw(10)<<N<<std::setw(18)<<(self_collision?"yes":"no")<<std::setw(12)<<contacts/N_frames;
+            std::cout<<std::setw(16)<<t_solver/(N_frames-1)<<std::setw(18)<<t_collision/(N_frames-1)<<std::endl;
+        }
+    }
+}
+
+// Closest point on all the triangles, without hierarchy (reference for the timing of the BVH)
+static void collide_brute_force(mesh_obstacle const& obstacle, grid_2D<vec3> const& position, buffer<float>& distance)
+{
+    mesh const& shape = obstacle.shape;
+    for(size_t i=0; i<position.size(); ++i) {
+        float d2_min = obstacle.query_distance*obstacle.query_distance;
+        for(uint3 const& f : shape.connectivity) {
+            vec3 const& a = shape.position[f[0]];
+            vec3 const& b = shape.position[f[1]];
+            vec3 const& c = shape.position[f[2]];
+            vec3 const bary = closest_point_triangle(position[i], a, b, c);
+            vec3 const d = position[i] - (bary[0]*a + bary[1]*b + bary[2]*c);
+            d2_min = std::min(d2_min, dot(d,d));
+        }
+        distance[i] = std::sqrt(d2_min);
+    }
+}
+
+void benchmark_cloth_mesh_obstacle()
+{
+    int const N = 50;
+    int const N_frames = 60;
+    float const dt_frame = 5*0.005f;
+
+    std::cout<<std::endl<<N<<"x"<<N<<" cloth falling on a sphere mesh - projective dynamics, "<<N_frames<<" frames of "<<dt_frame<<"s"<<std::endl;
+    std::cout<<std::setw(12)<<"triangles"<<std::setw(12)<<"build (ms)"<<std::setw(12)<<"refit (ms)"<<std::setw(20)<<"BVH queries (ms)"<<std::setw(22)<<"brute force (ms)"<<std::setw(16)<<"z center"<<std::endl;
+    for(int N_sphere : {20, 80, 320})
+    {
+        simulation_parameters parameters;
+        initialize_simulation_parameters(parameters, 1.0f, N);
+        parameters.K = 50.0f;
+        obstacles_parameters obstacles;
+        obstacles.sphere_radius = 0.0f;
+        mesh const sphere = mesh_primitive_sphere(0.3f, {0.5f,0.5f,0.3f}, 2*N_sphere, N_sphere);
+
+        auto const t0 = std::chrono::steady_clock::now();
+        obstacles.meshes.push_back(mesh_obstacle(sphere));
+        auto const t1 = std::chrono::steady_clock::now();
+        mesh_obstacle& obstacle = obstacles.meshes[0];
+        for(int k=0; k<10; ++k)
+            obstacle.update_position(sphere.position);
+        auto const t2 = std::chrono::steady_clock::now();
+
+        cloth_benchmark cloth(N);
+        cloth.positional_constraints.clear();
+        projective_dynamics_data projective_solver;
+        float t_query = 0.0f, t_brute = 0.0f;
+        buffer<float> distance(cloth.position.size());
+        for(int k_frame=0; k_frame<N_frames; ++k_frame)
+        {
+            numerical_integration_projective(cloth.position, cloth.velocity, cloth.positional_constraints, parameters, projective_solver, dt_frame);
+            if(k_frame==N_frames/2 && sphere.connectivity.size()<100000) { // A single frame, skipped for the largest mesh (more than a minute)
+                auto const t3 = std::chrono::steady_clock::now();
+                collide_brute_force(obstacle, cloth.position, distance);
+                t_brute = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now()-t3).count();
+            }
+            auto const t3 = std::chrono::steady_clock::now();
+            obstacle.collide(cloth.position, cloth.velocity);
+            t_query += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now()-t3).count();
+            apply_constraints(cloth.position, cloth.velocity, cloth.positional_constraints, obstacles);
+        }
+
+        // The center of the cloth lies on the top of the sphere (z = 0.6)
+        float const z_center = cloth.position(N/2,N/2).z;
+
+        std::cout<<std::setw(12)<<sphere.connectivity.size()<<std::setw(12)<<std::chrono::duration<float, std::milli>(t1-t0).count();
+        std::cout<<std::setw(12)<<std::chrono::duration<float, std::milli>(t2-t1).count()/10<<std::setw(20)<<t_query/N_frames<<std::setw(22)<<(t_brute>0 ? str(t_brute) : "-")<<std::setw(16)<<z_center<<std::endl;
+    }
+}
+
+// Sequential accumulation of the spring forces (reference of the colored parallel version of compute_forces)
+static void compute_spring_forces_sequential(grid_2D<vec3>& force, grid_2D<vec3> const& position, float K)
+{
+    int const N_dim = int(position.dimension.x);
+    force.fill({0,0,0});
+    for_each_spring(N_dim, 1.0f/(N_dim-1.0f), [&](int i, int j, int, float L) {
+        vec3 const d = position[j]-position[i];
+        float const l = norm(d);
+        vec3 const f = K*(l-L)*d/l;
+        force[i] += f;
+        force[j] -= f;
+    });
+}
+
+void benchmark_cloth_forces()
+{
+    int const N_repeat = 20;
+    int const thread_count_initial = parallel_thread_count();
+
+    std::cout<<std::endl<<"Spring forces - "<<parallel_processor_count()<<" processor(s) available"<<std::endl;
+    std::cout<<std::setw(8)<<"N"<<std::setw(18)<<"sequential (ms)"<<std::setw(10)<<"threads"<<std::setw(16)<<"colored (ms)"<<std::setw(12)<<"speedup"<<std::setw(28)<<"identical to 1 thread"<<std::endl;
+    for(int N : {64, 128, 256, 512})
+    {
+        // Wavy cloth: all the springs are stretched or compressed
+        cloth_benchmark cloth(N);
+        for(int kv=0; kv<N; ++kv)
+            for(int ku=0; ku<N; ++ku)
+                cloth.position(ku,kv) += vec3{0.1f*std::sin(0.3f*kv)/N, 0.0f, 0.05f*std::sin(0.2f*ku+0.1f*kv)};
+        simulation_parameters parameters;
+        initialize_simulation_parameters(parameters, 1.0f, N);
+        parameters.mu = 0.0f;
+
+        auto t0 = std::chrono::steady_clock::now();
+        for(int k=0; k<N_repeat; ++k)
+            compute_spring_forces_sequential(cloth.forces, cloth.position, parameters.K);
+        float const t_sequential = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now()-t0).count()/N_repeat;
+
+        float t_reference = 0.0f;
+        grid_2D<vec3> force_reference;
+        for(int thread_count : {1, 2, 4, 8, 16})
+        {
+            parallel_set_thread_count(thread_count);
+            t0 = std::chrono::steady_clock::now();
+            for(int k=0; k<N_repeat; ++k)
+                compute_forces(cloth.forces, cloth.position, cloth.velocity, cloth.normal, parameters, 0.0f);
+            float const t = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now()-t0).count()/N_repeat;
+
+            if(thread_count==1) {
+                t_reference = t;
+                force_reference = cloth.forces;
+            }
+            bool const identical = std::memcmp(cloth.forces.data.data.data(), force_reference.data.data.data(), cloth.forces.size()*sizeof(vec3))==0;
+
+            std::cout<<std::setw(8)<<N<<std::setw(18)<<t_sequential<<std::setw(10)<<thread_count<<std::setw(16)<<t<<std::setw(12)<<t_reference/t<<std::setw(28)<<(identical?"yes":"no")<<std::endl;
+        }
+    }
+    parallel_set_thread_count(thread_count_initial);
+}
+
+// Largest stretch of the hanging cloth during N_frames of implicit integration (one step per frame)
+static float stretch_reference(int N, float K, int N_frames, float dt_frame)
+{
+    simulation_parameters parameters;
+    initialize_simulation_parameters(parameters, 1.0f, N);
+    parameters.K = K;
+    obstacles_parameters obstacles;
+    obstacles.z_ground = -10.0f;
+
+    cloth_benchmark cloth(N);
+    float stretch = 0.0f;
+    for(int k_frame=0; k_frame<N_frames; ++k_frame) {
+        compute_forces(cloth.forces, cloth.position, cloth.velocity, cloth.normal, parameters, 0.0f);
+        numerical_integration_implicit(cloth.position, cloth.velocity, cloth.forces, cloth.positional_constraints, parameters, cloth.implicit_solver, dt_frame);
+        apply_constraints(cloth.position, cloth.velocity, cloth.positional_constraints, obstacles);
+        stretch = std::max(stretch, stretch_max(cloth.position));
+    }
+    return stretch;
+}
+
+void benchmark_cloth_rollback()
+{
+    int const N = 30;
+    int const N_frames = 200;
+    float const dt_frame = 5*0.005f;
+
+    std::cout<<std::endl<<N<<"x"<<N<<" cloth - explicit integration with 5 fixed steps per frame, "<<N_frames<<" frames of "<<dt_frame<<"s"<<std::endl;
+    std::cout<<std::setw(10)<<"K"<<std::setw(10)<<"rollback"<<std::setw(10)<<"frames"<<std::setw(12)<<"rollbacks"<<std::setw(14)<<"resimulated"<<std::setw(14)<<"steps/frame"<<std::setw(14)<<"dt factor"
+             <<std::setw(18)<<"max stretch (%)"<<std::setw(18)<<"reference (%)"<<std::setw(14)<<"frame (ms)"<<std::endl;
+    for(float K : {5.0f, 50.0f, 500.0f, 5000.0f})
+    {
+        float const reference = stretch_reference(N, K, N_frames, dt_frame);
+        for(bool use_rollback : {false, true})
+        {
+            simulation_parameters parameters;
+            initialize_simulation_parameters(parameters, 1.0f, N);
+            parameters.K = K;
+            float const m = parameters.mass_total/(N*N);
+            obstacles_parameters obstacles;
+            obstacles.z_ground = -10.0f;
+
+            cloth_benchmark cloth(N);
+            cloth_rollback rollback;
+            timestep_adaptive timestep;
+            int steps = 0, frames = 0;
+            int resimulated = 0; // Frames simulated again after a fall back to an older checkpoint
+            bool stopped = false;
+            float stretch = 0.0f; // Largest stretch of the valid steps
+
+            auto const t0 = std::chrono::steady_clock::now();
+            for(int k_frame=0; k_frame<N_frames && !stopped; ++k_frame)
+            {
+                rollback.frame_start(cloth.position, cloth.velocity);
+                timestep.frame_start(dt_frame);
+                while(timestep.frame_running())
+                {
+                    float const dt = timestep.next(rollback.dt_factor*dt_frame/5);
+                    compute_forces(cloth.forces, cloth.position, cloth.velocity, cloth.normal, parameters, 0.0f);
+                    numerical_integration(cloth.position, cloth.velocity, cloth.forces, m, dt);
+                    apply_constraints(cloth.position, cloth.velocity, cloth.positional_constraints, obstacles);
+                    steps++;
+
+                    float const stretch_step = stretch_max(cloth.position);
+                    if(!detect_simulation_divergence(cloth.forces, cloth.position, false) && stretch_step<=2*reference) {
+                        stretch = std::max(stretch, stretch_step);
+                        continue;
+                    }
+
+                    // The frames since the restored checkpoint are simulated again
+                    if(use_rollback && rollback.rollback(cloth.position, cloth.velocity)) {
+                        compute_forces(cloth.forces, cloth.position, cloth.velocity, cloth.normal, parameters, 0.0f);
+                        timestep.frame_start(rollback.resimulated_frames()*dt_frame);
+                        resimulated += rollback.resimulated_frames()-1;
+                    }
+                    else {
+                        stopped = true;
+                        break;
+                    }
+                }
+                if(!stopped) {
+                    rollback.frame_end();
+                    frames++;
+                }
+            }
+            auto const t1 = std::chrono::steady_clock::now();
+
+            std::cout<<std::setw(10)<<K<<std::setw(10)<<(use_rollback?"yes":"no")<<std::setw(10)<<frames<<std::setw(12)<<rollback.rollbacks<<std::setw(14)<<resimulated;
+            std::cout<<std::setw(14)<<float(steps)/std::max(frames,1)<<std::setw(14)<<rollback.dt_factor<<std::setw(18)<<100*stretch<<std::setw(18)<<100*reference;
+            std::cout<<std::setw(14)<<std::chrono::duration<float, std::milli>(t1-t0).count()/std::max(frames,1)<<std::endl;
+        }
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "simulation.hpp"
+#include "implicit_integration.hpp"
+#include "projective_dynamics.hpp"
+#include "self_collision.hpp"
+#include "rollback.hpp"
+
+
+// Compare the explicit, implicit and projective integrations of a hanging cloth for increasing stiffness and resolution
+//  Called when the program is run as: ./08_cloth benchmark
+//  Reports the number of steps per frame, the solver iterations (conjugate gradient or local/global), the stretch of the springs and the computation time
+void benchmark_cloth_integrator();
+
+// Projective dynamics of the hanging cloth falling on the sphere with the adaptive time step of the scene, on 50^2 and 100^2 cloths
+//  The factorization is kept while dt stays within dt_tolerance of its time step (1: refactorized at every change of dt)
+//  Reports the steps per frame, the number of factorizations, the time per frame and the largest difference of position to dt_tolerance=1
+void benchmark_cloth_projective_timestep();
+
+// Cost of the self collision of a cloth falling on the sphere, for increasing resolutions
+//  Reports the average number of particles in contact, and the time of the projective dynamics step and of the self collision per frame
+void benchmark_cloth_self_collision();
+
+// Cost of the collision of a cloth with a triangle mesh obstacle of increasing resolution
+//  Reports the construction and refit times of the hierarchy, and the time of the queries per frame compared to a brute force search
+void benchmark_cloth_mesh_obstacle();
+
+// Scaling of the colored parallel accumulation of the spring forces on 64^2 to 512^2 cloths
+//  Reports the time of the sequential accumulation and of compute_forces for increasing numbers of threads,
+//  and checks that the forces are bitwise identical whatever the number of threads
+void benchmark_cloth_forces();
+
+// Explicit integration of the hanging cloth with fixed time steps, stopped at the first divergence or recovered by rollbacks
+//  A stretch larger than twice the largest stretch of the implicit integration (stable reference) is a divergence too: a step
+//  slightly above the stability limit tangles the cloth long before its forces become large
+//  Reports the number of frames simulated, the rollbacks, the frames simulated again after a fall back to an older checkpoint,
+//  the average steps per frame, the final reduction of the time step and the largest stretch of the run
+void benchmark_cloth_rollback();
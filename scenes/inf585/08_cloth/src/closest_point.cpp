@@ -0,0 +1,41 @@
+#include "closest_point.hpp"
+
+using namespace vcl;
+
+
+vec3 closest_point_triangle(vec3 const& p, vec3 const& a, vec3 const& b, vec3 const& c)
+{
+    vec3 const ab = b-a, ac = c-a, ap = p-a;
+    float const d1 = dot(ab,ap), d2 = dot(ac,ap);
+    if(d1<=0 && d2<=0) return {1,0,0};
+
+    vec3 const bp = p-b;
+    float const d3 = dot(ab,bp), d4 = dot(ac,bp);
+    if(d3>=0 && d4<=d3) return {0,1,0};
+
+    float const vc = d1*d4-d3*d2;
+    if(vc<=0 && d1>=0 && d3<=0) {
+        float const v = d1/(d1-d3);
+        return {1-v,v,0};
+    }
+
+    vec3 const cp = p-c;
+    float const d5 = dot(ab,cp), d6 = dot(ac,cp);
+    if(d6>=0 && d5<=d6) return {0,0,1};
+
+    float const vb = d5*d2-d1*d6;
+    if(vb<=0 && d2>=0 && d6<=0) {
+        float const w = d2/(d2-d6);
+        return {1-w,0,w};
+    }
+
+    float const va = d3*d6-d5*d4;
+    if(va<=0 && (d4-d3)>=0 && (d5-d6)>=0) {
+        float const w = (d4-d3)/((d4-d3)+(d5-d6));
+        return {0,1-w,w};
+    }
+
+    float const denom = 1/(va+vb+vc);
+    float const v = vb*denom, w = vc*denom;
+    return {1-v-w,v,w};
+}
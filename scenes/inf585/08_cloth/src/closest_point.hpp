@@ -0,0 +1,7 @@
+#pragma once
+
+#include "vcl/vcl.hpp"
+
+
+// Barycentric coordinates of the closest point to p on the triangle (a,b,c) [Ericson, Real-Time Collision Detection, 5.1.5]
+vcl::vec3 closest_point_triangle(vcl::vec3 const& p, vcl::vec3 const& a, vcl::vec3 const& b, vcl::vec3 const& c);
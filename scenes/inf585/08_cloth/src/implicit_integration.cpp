@@ -0,0 +1,139 @@
+#include "implicit_integration.hpp"
+
+using namespace vcl;
+
+
+// Jacobian dF_i/dp_j of the force of a spring of stiffness K and rest length L on its particle i, with d = p_j-p_i
+//  K [ (1-L/l) I + L/l n n^t ], n = d/l
+//  The transverse term (1-L/l) is clamped to 0 for compressed springs (its negative value would make the system indefinite)
+static mat3 spring_jacobian(vec3 const& d, float K, float L)
+{
+    float const l = norm(d);
+    if(l<1e-8f)
+        return K*mat3::identity();
+    vec3 const n = d/l;
+    float const transverse = std::max(1-L/l, 0.0f);
+    float const longitudinal = L/l;
+
+    mat3 J;
+    for(int a=0; a<3; ++a)
+        for(int c=0; c<3; ++c)
+            J(a,c) = K*(longitudinal*n[a]*n[c] + (a==c ? transverse : 0.0f));
+    return J;
+}
+
+static float scalar_product(buffer<vec3> const& a, buffer<vec3> const& b)
+{
+    float s = 0.0f;
+    for(size_t k=0; k<a.size(); ++k)
+        s += dot(a[k], b[k]);
+    return s;
+}
+
+// y = A x (constrained particles are filtered: y_i = 0)
+static void multiply(implicit_solver_data const& solver, int N_dim, buffer<vec3> const& x, buffer<vec3>& y)
+{
+    int const N = N_dim*N_dim;
+    #pragma omp parallel for
+    for(int i=0; i<N; ++i)
+        y[i] = solver.diagonal[i]*x[i];
+    for_each_spring_parallel(N_dim, 1.0f, [&](int i, int j, int s, float) {
+        mat3 const& A_ij = solver.spring[cloth_spring_offset_count*i+s];
+        y[i] += A_ij*x[j];
+        y[j] += A_ij*x[i];
+    });
+    for(int i=0; i<N; ++i)
+        if(solver.fixed[i])
+            y[i] = {0,0,0};
+}
+
+void numerical_integration_implicit(grid_2D<vec3>& position, grid_2D<vec3>& velocity, grid_2D<vec3> const& force, std::map<size_t, vec3> const& positional_constraints, simulation_parameters const& parameters, implicit_solver_data& solver, float dt)
+{
+    int const N = int(position.size());
+    int const N_dim = int(position.dimension.x);
+    float const m = parameters.mass_total/N;
+    float const L0 = 1.0f/(N_dim-1.0f);
+
+    if(int(solver.dv.size())!=N) {
+        solver.dv.resize(N);
+        solver.dv.fill({0,0,0});
+    }
+    solver.diagonal.resize(N);
+    solver.spring.resize(cloth_spring_offset_count*N);
+    solver.preconditioner.resize(N);
+    solver.fixed.resize(N);
+    solver.b.resize(N); solver.r.resize(N); solver.z.resize(N); solver.d.resize(N); solver.q.resize(N);
+
+    solver.fixed.fill(0);
+    for(auto const& constraint : positional_constraints)
+        solver.fixed[constraint.first] = 1;
+
+    // Assemble A = (1 + dt mu) M - dt^2 dF/dx   and   b = dt (F + dt dF/dx v)
+    //  Drag -mu m v: dF/dv = -mu m I
+    //  Spring (i,j): dF_i/dp_j = J, dF_i/dp_i = -J (and symmetrically for j)
+    for(int i=0; i<N; ++i) {
+        solver.diagonal[i] = (1+dt*parameters.mu)*m*mat3::identity();
+        solver.b[i] = dt*force[i];
+    }
+    for_each_spring_parallel(N_dim, L0, [&](int i, int j, int s, float L) {
+        mat3 const J = spring_jacobian(position[j]-position[i], parameters.K, L);
+        solver.spring[cloth_spring_offset_count*i+s] = -dt*dt*J;
+        solver.diagonal[i] += dt*dt*J;
+        solver.diagonal[j] += dt*dt*J;
+        vec3 const Jv = J*(velocity[j]-velocity[i]);
+        solver.b[i] += dt*dt*Jv;
+        solver.b[j] -= dt*dt*Jv;
+    });
+    for(int i=0; i<N; ++i) {
+        // A_ii >= m I: inverted after normalization by m, its determinant would be below the threshold of inverse() otherwise
+        solver.preconditioner[i] = (1.0f/m)*inverse((1.0f/m)*solver.diagonal[i]);
+        if(solver.fixed[i]) {
+            solver.b[i] = {0,0,0};
+            solver.dv[i] = {0,0,0};
+        }
+    }
+
+    // Preconditioned conjugate gradient, starting from the previous velocity change
+    buffer<vec3>& x = solver.dv;
+    buffer<vec3>& r = solver.r;
+    buffer<vec3>& z = solver.z;
+    buffer<vec3>& d = solver.d;
+    buffer<vec3>& q = solver.q;
+
+    multiply(solver, N_dim, x, q);
+    for(int i=0; i<N; ++i) {
+        r[i] = solver.b[i]-q[i];
+        z[i] = solver.preconditioner[i]*r[i];
+        d[i] = z[i];
+    }
+    float const b2 = scalar_product(solver.b, solver.b);
+    float const threshold = solver.tolerance*solver.tolerance*b2;
+    float delta = scalar_product(r, z);
+    float r2 = scalar_product(r, r);
+
+    solver.iterations = 0;
+    while(solver.iterations<solver.iteration_max && r2>threshold)
+    {
+        multiply(solver, N_dim, d, q);
+        float const alpha = delta/scalar_product(d, q);
+        for(int i=0; i<N; ++i) {
+            x[i] += alpha*d[i];
+            r[i] -= alpha*q[i];
+            z[i] = solver.preconditioner[i]*r[i];
+        }
+        float const delta_new = scalar_product(r, z);
+        float const beta = delta_new/delta;
+        delta = delta_new;
+        for(int i=0; i<N; ++i)
+            d[i] = z[i] + beta*d[i];
+        r2 = scalar_product(r, r);
+        solver.iterations++;
+    }
+    solver.residual = b2>0 ? std::sqrt(r2/b2) : 0.0f;
+
+    // Update of the state
+    for(int i=0; i<N; ++i) {
+        velocity[i] += x[i];
+        position[i] += dt*velocity[i];
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "simulation.hpp"
+
+
+// Linear system of the backward Euler step and state of its conjugate gradient solver
+//  The system A dv = b is stored by 3x3 blocks following the grid of the cloth:
+//   - one diagonal block per particle
+//   - one block per spring (offset s of cloth_spring_offsets), shared by its two particles (A is symmetric)
+struct implicit_solver_data
+{
+    vcl::buffer<vcl::mat3> diagonal;      // A_ii
+    vcl::buffer<vcl::mat3> spring;        // A_ij for the spring starting at i with offset s, at index cloth_spring_offset_count*i+s
+    vcl::buffer<vcl::mat3> preconditioner; // Inverse of the diagonal blocks (block Jacobi)
+    vcl::buffer<int> fixed;               // Particles with a positional constraint (dv = 0)
+
+    vcl::buffer<vcl::vec3> dv; // Velocity change of the last step, initial guess of the next one
+    vcl::buffer<vcl::vec3> b, r, z, d, q; // Right hand side and vectors of the conjugate gradient
+
+    // Stopping criteria: |r| < tolerance |b|
+    int iteration_max = 200;
+    float tolerance = 1e-4f;
+
+    // Statistics of the last step
+    int iterations = 0;
+    float residual = 0.0f; // |r|/|b|
+};
+
+
+// Backward Euler step of the cloth [Baraff and Witkin 1998]
+//  Solves (M - dt dF/dv - dt^2 dF/dx) dv = dt (F + dt dF/dx v) with a preconditioned conjugate gradient warm-started from the previous dv,
+//  then v += dv and p += dt v
+//  - force: forces F at the current state (compute_forces), the Jacobian dF/dx of the springs is assembled here
+//  - the compressed springs keep only their stiffness along their direction (the system remains positive definite)
+//  - the particles with a positional constraint are filtered out of the system
+void numerical_integration_implicit(vcl::grid_2D<vcl::vec3>& position, vcl::grid_2D<vcl::vec3>& velocity, vcl::grid_2D<vcl::vec3> const& force, std::map<size_t, vcl::vec3> const& positional_constraints, simulation_parameters const& parameters, implicit_solver_data& solver, float dt);
@@ -2,6 +2,11 @@
 #include <iostream>
 
 #include "simulation.hpp"
+#include "implicit_integration.hpp"
+#include "projective_dynamics.hpp"
+#include "self_collision.hpp"
+#include "rollback.hpp"
+#include "benchmark.hpp"
 
 
 using namespace vcl;
@@ -11,6 +16,10 @@ struct gui_parameters {
 	bool wireframe = false;
 	float wind_magnitude = 1.0f;
 	bool run = true;
+	bool adaptive_timestep = true; // Subdivide the frame into stable substeps (CFL condition)
+	bool self_collision = false;
+	bool mesh_obstacle = false;    // Torus mesh obstacle (collision through its BVH)
+	bool animate_obstacle = false; // Rotation of the torus (refit of the BVH)
 };
 
 struct user_interaction_parameters {
@@ -47,6 +56,10 @@ struct cloth_structure
 	std::map<size_t,vec3> positional_constraints;
 
 	simulation_parameters parameters;
+	implicit_solver_data implicit_solver; // System and conjugate gradient of the implicit integration
+	projective_dynamics_data projective_solver; // Prefactorized system of the projective dynamics
+	cloth_self_collision self_collision; // Spatial hash of the triangles
+	cloth_rollback rollback; // Checkpoints of the last frames restored on divergence
 };
 
 
@@ -59,6 +72,7 @@ void initialize_data();
 void display_scene();
 void display_interface();
 void initialize_cloth();
+void animate_mesh_obstacle(float t);
 
 
 cloth_structure cloth;
@@ -67,15 +81,29 @@ GLuint texture_cloth;
 
 mesh_drawable ground;
 mesh_drawable sphere;
+mesh torus;                // Rest shape of the mesh obstacle
+mesh_drawable torus_visual;
 
 timer_basic timer;
+timestep_adaptive timestep;
 
-int main(int, char* argv[])
+int main(int argc, char* argv[])
 {
 
 
 	std::cout << "Run " << argv[0] << std::endl;
 
+	// Run the timing of the simulation without display: ./08_cloth benchmark
+	if(argc>1 && std::string(argv[1])=="benchmark") {
+		benchmark_cloth_integrator();
+		benchmark_cloth_projective_timestep();
+		benchmark_cloth_self_collision();
+		benchmark_cloth_mesh_obstacle();
+		benchmark_cloth_forces();
+		benchmark_cloth_rollback();
+		return 0;
+	}
+
 	GLFWwindow* window = create_window(1280,1024);
 	window_size_callback(window, 1280, 1024);
 	std::cout << opengl_info_display() << std::endl;;
@@ -113,26 +141,63 @@ int main(int, char* argv[])
 		
 		if(user.gui.display_frame) draw(user.global_frame, scene);
 		display_interface();
+		if(user.gui.mesh_obstacle && user.gui.animate_obstacle)
+			animate_mesh_obstacle(timer.t);
 
 		if(user.gui.run){
-			float const dt = 0.005f * timer.scale;
+			float const dt_fixed = 0.005f * timer.scale;
 			float const m = cloth.parameters.mass_total/cloth.position.size();
 			size_t const N_substeps = 5;
-			for(size_t k_substep=0; k_substep<N_substeps; ++k_substep){
+
+			// The frame lasts N_substeps fixed time steps (a single step with the implicit and projective integrations)
+			//  With the adaptive time step, it is subdivided into the minimal number of stable steps instead
+			cloth_integrator_type const integrator = cloth.parameters.integrator;
+			// A checkpoint of the state is saved at each frame: on divergence the simulation goes back to it with a reduced time step
+			cloth.rollback.frame_start(cloth.position, cloth.velocity);
+			timestep.dt_factor = cloth.rollback.dt_factor;
+			timestep.frame_start(N_substeps*dt_fixed);
+			while(timestep.frame_running()){
+				float const dt = user.gui.adaptive_timestep ?
+					timestep.next(measure_timestep(cloth.velocity, cloth.forces, cloth.parameters)) :
+					timestep.next(cloth.rollback.dt_factor * (integrator!=cloth_integrator_explicit ? N_substeps*dt_fixed : dt_fixed));
 				compute_forces(cloth.forces, cloth.position, cloth.velocity, cloth.normal, cloth.parameters, user.gui.wind_magnitude);
-				numerical_integration(cloth.position, cloth.velocity, cloth.forces, m, dt);
+				if(integrator==cloth_integrator_implicit)
+					numerical_integration_implicit(cloth.position, cloth.velocity, cloth.forces, cloth.positional_constraints, cloth.parameters, cloth.implicit_solver, dt);
+				else if(integrator==cloth_integrator_projective)
+					numerical_integration_projective(cloth.position, cloth.velocity, cloth.positional_constraints, cloth.parameters, cloth.projective_solver, dt);
+				else
+					numerical_integration(cloth.position, cloth.velocity, cloth.forces, m, dt);
+				if(user.gui.self_collision)
+					apply_self_collision(cloth.position, cloth.velocity, cloth.triangle_connectivity, cloth.self_collision);
 				apply_constraints(cloth.position, cloth.velocity, cloth.positional_constraints, obstacles);
 
 
 				bool simulation_diverged = detect_simulation_divergence(cloth.forces, cloth.position);
 				if(simulation_diverged==true)
 				{
+					if(cloth.rollback.rollback(cloth.position, cloth.velocity))
+					{
+						std::cerr<<" **** Simulation has diverged **** "<<std::endl;
+						std::cerr<<" > Rollback to the last valid state, time step x"<<cloth.rollback.dt_factor<<std::endl;
+
+						// The frames since the checkpoint are simulated again: the forces, the stable step and the warm start
+						//  of the implicit solver still come from the diverged state
+						compute_forces(cloth.forces, cloth.position, cloth.velocity, cloth.normal, cloth.parameters, user.gui.wind_magnitude);
+						cloth.implicit_solver.dv.clear();
+						timestep.dt_factor = cloth.rollback.dt_factor;
+						timestep.dt_stable = 0.0f;
+						timestep.frame_start(cloth.rollback.resimulated_frames()*N_substeps*dt_fixed);
+						continue;
+					}
+
 					std::cerr<<" **** Simulation has diverged **** "<<std::endl;
 					std::cerr<<" > Stop simulation iterations"<<std::endl;
 					user.gui.run = false;
 					break;
 				}
 			}
+			if(user.gui.run)
+				cloth.rollback.frame_end();
 		}
 
 		display_scene();
@@ -178,12 +243,17 @@ void initialize_data()
 	sphere.transform.scale = obstacles.sphere_radius;
 	sphere.shading.color = {1,0,0};
 
+	torus = mesh_primitive_torus(0.25f, 0.06f, {0.5f,0.5f,0.4f}, {1,0,0});
+	torus_visual = mesh_drawable(torus);
+	torus_visual.shading.color = {0.3f,0.3f,1.0f};
+
 	ground.texture = opengl_texture_to_gpu(image_load_png("assets/wood.png"));
 	texture_cloth = opengl_texture_to_gpu(image_load_png("assets/cloth.png"));
 
 	cloth.N_cloth = 30;
 	initialize_cloth();
 	initialize_simulation_parameters(cloth.parameters, 1.0f, cloth.position.dimension.x);
+	initialize_timestep(timestep);
 
 }
 
@@ -195,11 +265,14 @@ void initialize_cloth()
 	cloth.position = grid_2D<vec3>::from_buffer(cloth_mesh.position, N_cloth, N_cloth);
 
 	cloth.velocity.clear();
-	cloth.velocity.resize(N_cloth*N_cloth);
+	cloth.velocity.resize(N_cloth,N_cloth);
 
 	cloth.forces.clear();
 	cloth.forces.resize(N_cloth,N_cloth);
 
+	cloth.implicit_solver = implicit_solver_data();
+	cloth.rollback.clear();
+
 	cloth.visual.clear();
 	cloth.visual = mesh_drawable(cloth_mesh);
 	cloth.visual.texture = texture_cloth;
@@ -219,7 +292,7 @@ void initialize_cloth()
 void display_scene()
 {
 	cloth.visual.update_position(cloth.position.data);
-	normal_per_vertex(cloth.position.data, cloth.triangle_connectivity, cloth.normal.data);
+	normal_per_vertex_grid(cloth.position, cloth.normal);
 	cloth.visual.update_normal(cloth.normal.data);
 	draw(cloth.visual, scene);
 
@@ -228,6 +301,22 @@ void display_scene()
 
 	draw(sphere, scene);
 	draw(ground, scene);
+	if(user.gui.mesh_obstacle)
+		draw(torus_visual, scene);
+}
+
+// Rotation of the torus around the vertical axis: the obstacle is deformed in place and its hierarchy is refitted
+void animate_mesh_obstacle(float t)
+{
+	vec3 const center = {0.5f,0.5f,0.4f};
+	rotation const r = rotation({0,0,1}, 0.5f*t);
+	buffer<vec3> position = torus.position;
+	for(vec3& p : position)
+		p = center + r*(p-center);
+
+	obstacles.meshes[0].update_position(position);
+	torus_visual.update_position(position);
+	torus_visual.update_normal(normal_per_vertex(position, torus.connectivity));
 }
 void display_interface()
 {
@@ -236,11 +325,41 @@ void display_interface()
 	ImGui::Checkbox("Texture", &cloth.visual.shading.use_texture);
 	ImGui::SliderFloat("Time scale", &timer.scale, 0.05f, 2.0f, "%.2f s");
 
-	ImGui::SliderFloat("Stiffness", &cloth.parameters.K, 0.1f, 10.0f, "%.2f s");
+	int integrator = cloth.parameters.integrator;
+	ImGui::RadioButton("Explicit", &integrator, cloth_integrator_explicit); ImGui::SameLine();
+	ImGui::RadioButton("Implicit", &integrator, cloth_integrator_implicit); ImGui::SameLine();
+	ImGui::RadioButton("Projective", &integrator, cloth_integrator_projective);
+	cloth.parameters.integrator = cloth_integrator_type(integrator);
+	if(cloth.parameters.integrator==cloth_integrator_implicit)
+		ImGui::Text("Conjugate gradient: %d iterations (residual %.1e)", cloth.implicit_solver.iterations, cloth.implicit_solver.residual);
+	if(cloth.parameters.integrator==cloth_integrator_projective)
+		ImGui::SliderInt("Local/global iterations", &cloth.projective_solver.iterations, 1, 50);
+
+	ImGui::SliderFloat("Stiffness", &cloth.parameters.K, 0.1f, 5000.0f, "%.2f s", 4.0f);
 	ImGui::SliderFloat("Damping", &cloth.parameters.mu, 0.0f, 30.0f, "%.2f s");
 	ImGui::SliderFloat("Wind", &user.gui.wind_magnitude, 0.0f, 50.0f, "%.2f s");
 	ImGui::SliderFloat("Mass", &cloth.parameters.mass_total, 0.0f, 5.0f, "%.2f s");
-	ImGui::SliderInt("Samples", &cloth.N_cloth, 5, 50);
+	ImGui::Checkbox("Adaptive time step", &user.gui.adaptive_timestep);
+	if(ImGui::Checkbox("Torus obstacle", &user.gui.mesh_obstacle)) {
+		obstacles.meshes.clear();
+		if(user.gui.mesh_obstacle)
+			obstacles.meshes.push_back(mesh_obstacle(torus));
+	}
+	if(user.gui.mesh_obstacle) {
+		ImGui::SameLine();
+		ImGui::Checkbox("Rotate", &user.gui.animate_obstacle);
+	}
+	ImGui::Checkbox("Self collision", &user.gui.self_collision);
+	if(user.gui.self_collision) {
+		ImGui::SameLine();
+		ImGui::Text("(%d contacts)", cloth.self_collision.contacts);
+	}
+	ImGui::Text("Substeps: %d", timestep.substeps);
+	if(cloth.rollback.rollbacks>0) {
+		ImGui::SameLine();
+		ImGui::Text("(%d rollbacks, time step x%.3f)", cloth.rollback.rollbacks, cloth.rollback.dt_factor);
+	}
+	ImGui::SliderInt("Samples", &cloth.N_cloth, 5, 150);
 	bool change_samples = ImGui::IsItemDeactivatedAfterEdit();
 	bool restart = ImGui::Button("Restart"); ImGui::SameLine();
 	bool run = ImGui::Checkbox("run", &user.gui.run);
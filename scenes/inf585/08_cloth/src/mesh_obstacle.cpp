@@ -0,0 +1,205 @@
+#include "mesh_obstacle.hpp"
+#include "closest_point.hpp"
+
+#include <algorithm>
+
+using namespace vcl;
+
+
+// Squared distance between p and the box of the node (0 inside)
+static float distance2(vec3 const& p, triangle_bvh::node const& n)
+{
+    float d2 = 0.0f;
+    for(int c=0; c<3; ++c) {
+        float const d = std::max(std::max(n.p_min[c]-p[c], p[c]-n.p_max[c]), 0.0f);
+        d2 += d*d;
+    }
+    return d2;
+}
+
+void triangle_bvh::build(buffer<vec3> const& position, buffer<uint3> const& connectivity)
+{
+    int const N = int(connectivity.size());
+    buffer<vec3> center(N);
+    triangle_index.resize(N);
+    for(int k=0; k<N; ++k) {
+        uint3 const& f = connectivity[k];
+        center[k] = (position[f[0]]+position[f[1]]+position[f[2]])/3.0f;
+        triangle_index[k] = k;
+    }
+
+    nodes.clear();
+    if(N>0)
+        build_node(0, N, center);
+    refit(position, connectivity);
+}
+
+int triangle_bvh::build_node(int start, int end, buffer<vec3> const& center)
+{
+    int const k = int(nodes.size());
+    nodes.push_back(node());
+    if(end-start<=leaf_size) {
+        nodes[k].start = start;
+        nodes[k].count = end-start;
+        return k;
+    }
+
+    // Split at the median of the triangle centers along the largest axis of their box
+    vec3 c_min = center[triangle_index[start]];
+    vec3 c_max = c_min;
+    for(int i=start+1; i<end; ++i) {
+        vec3 const& c = center[triangle_index[i]];
+        for(int d=0; d<3; ++d) {
+            c_min[d] = std::min(c_min[d], c[d]);
+            c_max[d] = std::max(c_max[d], c[d]);
+        }
+    }
+    vec3 const extent = c_max-c_min;
+    int const axis = extent.x>=extent.y ? (extent.x>=extent.z?0:2) : (extent.y>=extent.z?1:2);
+
+    int const mid = (start+end)/2;
+    auto const first = triangle_index.data.begin();
+    std::nth_element(first+start, first+mid, first+end, [&](int a, int b) { return center[a][axis]<center[b][axis]; });
+
+    build_node(start, mid, center);
+    int const right = build_node(mid, end, center);
+    nodes[k].right = right;
+    return k;
+}
+
+void triangle_bvh::refit(buffer<vec3> const& position, buffer<uint3> const& connectivity)
+{
+    int const N = int(connectivity.size());
+    normal.resize(N);
+    for(int k=0; k<N; ++k) {
+        uint3 const& f = connectivity[k];
+        vec3 const n = cross(position[f[1]]-position[f[0]], position[f[2]]-position[f[0]]);
+        float const l = norm(n);
+        normal[k] = l>1e-12f ? n/l : vec3{0,0,0};
+    }
+
+    // Children are stored after their parent: a reverse traversal updates them first
+    for(int k=int(nodes.size())-1; k>=0; --k)
+    {
+        node& n = nodes[k];
+        if(n.count>0) {
+            n.p_min = position[connectivity[triangle_index[n.start]][0]];
+            n.p_max = n.p_min;
+            for(int i=n.start; i<n.start+n.count; ++i) {
+                uint3 const& f = connectivity[triangle_index[i]];
+                for(int v=0; v<3; ++v) {
+                    vec3 const& p = position[f[v]];
+                    for(int d=0; d<3; ++d) {
+                        n.p_min[d] = std::min(n.p_min[d], p[d]);
+                        n.p_max[d] = std::max(n.p_max[d], p[d]);
+                    }
+                }
+            }
+        }
+        else {
+            node const& left = nodes[k+1];
+            node const& right = nodes[n.right];
+            for(int d=0; d<3; ++d) {
+                n.p_min[d] = std::min(left.p_min[d], right.p_min[d]);
+                n.p_max[d] = std::max(left.p_max[d], right.p_max[d]);
+            }
+        }
+    }
+}
+
+int triangle_bvh::closest(vec3 const& p, float d_max, buffer<vec3> const& position, buffer<uint3> const& connectivity, vec3& q) const
+{
+    int closest_triangle = -1;
+    float d2_min = d_max*d_max;
+    if(nodes.size()==0)
+        return closest_triangle;
+
+    // Depth-first traversal visiting the nearest child first, the nodes farther than the current closest triangle are skipped
+    int stack[64];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+    while(stack_size>0)
+    {
+        int const k = stack[--stack_size];
+        node const& n = nodes[k];
+        if(distance2(p, n)>=d2_min)
+            continue;
+
+        if(n.count>0) {
+            for(int i=n.start; i<n.start+n.count; ++i) {
+                int const t = triangle_index[i];
+                if(normal[t].x==0 && normal[t].y==0 && normal[t].z==0)
+                    continue;
+                uint3 const& f = connectivity[t];
+                vec3 const& a = position[f[0]];
+                vec3 const& b = position[f[1]];
+                vec3 const& c = position[f[2]];
+                vec3 const bary = closest_point_triangle(p, a, b, c);
+                vec3 const q_t = bary[0]*a + bary[1]*b + bary[2]*c;
+                float const d2 = dot(p-q_t, p-q_t);
+                if(d2<d2_min) {
+                    d2_min = d2;
+                    closest_triangle = t;
+                    q = q_t;
+                }
+            }
+        }
+        else {
+            int near = k+1, far = n.right;
+            if(distance2(p, nodes[far])<distance2(p, nodes[near]))
+                std::swap(near, far);
+            stack[stack_size++] = far;
+            stack[stack_size++] = near;
+        }
+    }
+    return closest_triangle;
+}
+
+
+mesh_obstacle::mesh_obstacle(mesh const& shape_arg)
+    :shape(shape_arg)
+{
+    // Orient the triangles along the normals of the mesh when they are given (ex. inward triangles of mesh_primitive_torus)
+    if(shape.normal.size()==shape.position.size()) {
+        int outward = 0;
+        for(uint3 const& f : shape.connectivity) {
+            vec3 const n = cross(shape.position[f[1]]-shape.position[f[0]], shape.position[f[2]]-shape.position[f[0]]);
+            outward += dot(n, shape.normal[f[0]]+shape.normal[f[1]]+shape.normal[f[2]])>0 ? 1 : -1;
+        }
+        if(outward<0)
+            shape.flip_connectivity();
+    }
+
+    bvh.build(shape.position, shape.connectivity);
+}
+
+void mesh_obstacle::update_position(buffer<vec3> const& position)
+{
+    shape.position = position;
+    bvh.refit(shape.position, shape.connectivity);
+}
+
+void mesh_obstacle::collide(grid_2D<vec3>& position, grid_2D<vec3>& velocity) const
+{
+    // All the particles are queried in a single parallel pass (grid order: neighbor queries traverse the same nodes)
+    int const N = int(position.size());
+    #pragma omp parallel for
+    for(int i=0; i<N; ++i)
+    {
+        vec3& p = position[i];
+        vec3 q;
+        int const t = bvh.closest(p, query_distance, shape.position, shape.connectivity, q);
+        if(t<0)
+            continue;
+
+        vec3 const& n = bvh.normal[t];
+        float const s = dot(p-q, n); // Signed distance along the normal (negative behind the surface)
+        if(s<thickness) {
+            p += (thickness-s)*n;
+            vec3& v = velocity[i];
+            float const vn = dot(v, n);
+            if(vn<0)
+                v -= vn*n;
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "vcl/vcl.hpp"
+
+
+// Bounding volume hierarchy of the triangles of a mesh (axis aligned boxes)
+//  - build: top-down median split along the largest axis of the box of the triangle centers, leaves of at most leaf_size triangles
+//  - refit: recomputes the boxes bottom-up for deformed positions, the tree structure is kept (animated obstacles)
+//  - the unit normals of the triangles are computed with the boxes: the degenerate triangles (no area) get a zero normal and are ignored
+//  The nodes are stored in depth-first order: the left child of an inner node directly follows it, the children are after their parent
+struct triangle_bvh
+{
+    struct node
+    {
+        vcl::vec3 p_min, p_max;
+        int right = 0; // Index of the right child (inner node)
+        int start = 0; // First triangle in triangle_index (leaf)
+        int count = 0; // Number of triangles (leaf), 0 for an inner node
+    };
+
+    static int const leaf_size = 4;
+
+    vcl::buffer<node> nodes;
+    vcl::buffer<int> triangle_index; // Triangles sorted by leaf
+    vcl::buffer<vcl::vec3> normal;   // Unit normal of each triangle (zero for a degenerate triangle)
+
+    void build(vcl::buffer<vcl::vec3> const& position, vcl::buffer<vcl::uint3> const& connectivity);
+    void refit(vcl::buffer<vcl::vec3> const& position, vcl::buffer<vcl::uint3> const& connectivity);
+
+    // Closest non-degenerate triangle to p at distance smaller than d_max (-1 if there is none)
+    //  q: closest point on this triangle
+    int closest(vcl::vec3 const& p, float d_max, vcl::buffer<vcl::vec3> const& position, vcl::buffer<vcl::uint3> const& connectivity, vcl::vec3& q) const;
+
+private:
+    int build_node(int start, int end, vcl::buffer<vcl::vec3> const& center);
+};
+
+
+// Static or animated triangle mesh the cloth collides with
+//  The mesh is expected to be closed, its outside is given by the orientation of its triangles (or by its normals when they are given)
+//  A particle closer than thickness to the surface, or behind it by less than query_distance, is projected at the thickness distance
+//  along the normal of its closest triangle, and its velocity toward the obstacle is removed
+struct mesh_obstacle
+{
+    vcl::mesh shape;
+    triangle_bvh bvh;
+    float thickness = 0.01f;
+    float query_distance = 0.05f; // Largest distance searched around a particle (also the deepest penetration that is recovered)
+
+    mesh_obstacle() = default;
+    explicit mesh_obstacle(vcl::mesh const& shape);
+
+    // New positions of the vertices of an animated obstacle (same connectivity): the hierarchy is refitted
+    void update_position(vcl::buffer<vcl::vec3> const& position);
+
+    // Projection of all the particles out of the obstacle, in parallel
+    void collide(vcl::grid_2D<vcl::vec3>& position, vcl::grid_2D<vcl::vec3>& velocity) const;
+};
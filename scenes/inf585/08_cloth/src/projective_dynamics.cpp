@@ -0,0 +1,148 @@
+#include "projective_dynamics.hpp"
+
+using namespace vcl;
+
+
+// Global matrix M/dt^2 + K sum A^t A, with A p = p_j-p_i for each spring
+//  The fixed particles are eliminated: their row and column are replaced by the identity (their terms move to the right hand side)
+static void factorize(projective_dynamics_data& solver)
+{
+    int const N_dim = solver.N_dim;
+    int const N = N_dim*N_dim;
+    float const K = solver.K;
+
+    buffer<float> diagonal(N);
+    diagonal.fill(solver.m/(solver.dt*solver.dt));
+
+    std::vector<Eigen::Triplet<float> > coefficients;
+    coefficients.reserve(N*(2*cloth_spring_offset_count+1));
+    for_each_spring(N_dim, 1.0f, [&](int i, int j, int, float) {
+        diagonal[i] += K;
+        diagonal[j] += K;
+        if(!solver.fixed[i] && !solver.fixed[j]) {
+            coefficients.push_back({i, j, -K});
+            coefficients.push_back({j, i, -K});
+        }
+    });
+    for(int i=0; i<N; ++i)
+        coefficients.push_back({i, i, solver.fixed[i] ? 1.0f : diagonal[i]});
+
+    Eigen::SparseMatrix<float> M(N, N);
+    M.setFromTriplets(coefficients.begin(), coefficients.end());
+    solver.solver.compute(M);
+    solver.factorizations++;
+}
+
+void numerical_integration_projective(grid_2D<vec3>& position, grid_2D<vec3>& velocity, std::map<size_t, vec3> const& positional_constraints, simulation_parameters const& parameters, projective_dynamics_data& solver, float dt)
+{
+    int const N = int(position.size());
+    int const N_dim = int(position.dimension.x);
+    float const m = parameters.mass_total/N;
+    float const K = parameters.K;
+    float const mu = parameters.mu;
+    float const L0 = 1.0f/(N_dim-1.0f);
+
+    // Refactorize the global matrix only when it changes (or when dt is too far from the time step of the factorization)
+    std::vector<size_t> fixed_index;
+    for(auto const& constraint : positional_constraints)
+        fixed_index.push_back(constraint.first);
+    bool const dt_changed = !(dt<=solver.dt*solver.dt_tolerance && dt*solver.dt_tolerance>=solver.dt);
+    if(N_dim!=solver.N_dim || K!=solver.K || m!=solver.m || dt_changed || fixed_index!=solver.fixed_index)
+    {
+        solver.N_dim = N_dim;
+        solver.K = K;
+        solver.m = m;
+        solver.dt = dt;
+        solver.fixed_index = fixed_index;
+        solver.fixed.resize(N);
+        solver.fixed.fill(0);
+        for(size_t i : fixed_index)
+            solver.fixed[i] = 1;
+        factorize(solver);
+
+        solver.inertia.resize(N);
+        solver.q.resize(N);
+        solver.projection.resize(cloth_spring_offset_count*N);
+        solver.rhs.resize(N, 3);
+        solver.x.resize(N, 3);
+    }
+
+    // Mass term of the actual time step missing from the factorized matrix
+    float const mass_correction = m/(dt*dt) - m/(solver.dt*solver.dt);
+
+    float L[cloth_spring_offset_count];
+    for(int s=0; s<cloth_spring_offset_count; ++s) {
+        int2 const& o = cloth_spring_offsets[s];
+        L[s] = L0*std::sqrt(float(o.x*o.x+o.y*o.y));
+    }
+
+    // Inertial position, with the gravity and the drag -mu m v as external forces
+    vec3 const g = {0,0,-9.81f};
+    #pragma omp parallel for
+    for(int i=0; i<N; ++i) {
+        solver.inertia[i] = position[i] + dt*velocity[i] + dt*dt*(g-mu*velocity[i]);
+        solver.q[i] = solver.inertia[i];
+    }
+    for(auto const& constraint : positional_constraints)
+        solver.q[constraint.first] = constraint.second;
+
+    for(int k_iteration=0; k_iteration<solver.iterations; ++k_iteration)
+    {
+        // Local step: closest vector of rest length to each spring
+        #pragma omp parallel for
+        for(int i=0; i<N; ++i) {
+            int const ku = i%N_dim;
+            int const kv = i/N_dim;
+            for(int s=0; s<cloth_spring_offset_count; ++s) {
+                int2 const& o = cloth_spring_offsets[s];
+                if(ku+o.x>=N_dim || kv+o.y<0 || kv+o.y>=N_dim)
+                    continue;
+                vec3 const d = solver.q[i+o.x+N_dim*o.y]-solver.q[i];
+                float const l = norm(d);
+                solver.projection[cloth_spring_offset_count*i+s] = l>1e-8f ? L[s]/l*d : d;
+            }
+        }
+
+        // Right hand side M/dt^2 s + K sum A^t proj, gathered per particle over the springs leaving and reaching it
+        //  (minus the mass correction applied to the current positions)
+        #pragma omp parallel for
+        for(int i=0; i<N; ++i) {
+            vec3 r = solver.q[i];
+            if(!solver.fixed[i]) {
+                int const ku = i%N_dim;
+                int const kv = i/N_dim;
+                r = m/(dt*dt)*solver.inertia[i] - mass_correction*solver.q[i];
+                for(int s=0; s<cloth_spring_offset_count; ++s) {
+                    int2 const& o = cloth_spring_offsets[s];
+                    if(ku+o.x<N_dim && kv+o.y>=0 && kv+o.y<N_dim) {
+                        int const j = i+o.x+N_dim*o.y;
+                        r -= K*solver.projection[cloth_spring_offset_count*i+s];
+                        if(solver.fixed[j])
+                            r += K*solver.q[j];
+                    }
+                    if(ku-o.x>=0 && kv-o.y>=0 && kv-o.y<N_dim) {
+                        int const j = i-o.x-N_dim*o.y;
+                        r += K*solver.projection[cloth_spring_offset_count*j+s];
+                        if(solver.fixed[j])
+                            r += K*solver.q[j];
+                    }
+                }
+            }
+            for(int c=0; c<3; ++c)
+                solver.rhs(i,c) = r[c];
+        }
+
+        // Global step: back-substitutions with the prefactorized matrix
+        solver.x = solver.solver.solve(solver.rhs);
+        #pragma omp parallel for
+        for(int i=0; i<N; ++i)
+            solver.q[i] = {solver.x(i,0), solver.x(i,1), solver.x(i,2)};
+    }
+
+    // Update of the state
+    #pragma omp parallel for
+    for(int i=0; i<N; ++i) {
+        velocity[i] = (solver.q[i]-position[i])/dt;
+        position[i] = solver.q[i];
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "simulation.hpp"
+
+// Include Eigen
+#define EIGEN_NO_DEBUG
+#include "third_party/src/eigen/Eigen/Sparse"
+
+
+// Projective dynamics solver of the cloth [Bouaziz et al. 2014], [Liu et al. 2013]
+//  Each spring (i,j) is a constraint of energy K/2 |(p_j-p_i) - proj_ij|^2 where proj_ij is the closest vector of length L
+//  A step alternates:
+//   - local step: projection of every spring on its rest length (independent, in parallel)
+//   - global step: solution of (M/dt^2 + K sum A^t A) p = M/dt^2 s + K sum A^t proj, s being the inertial position
+//  The matrix of the global step only depends on the topology, the stiffness, the mass, the time step and the fixed particles:
+//   it is factorized once (sparse Cholesky) and each iteration only runs back-substitutions
+//  The adaptive time step changes dt at almost every step: the factorization of a close time step dt_f is kept, and the difference
+//   of the mass terms m (1/dt^2-1/dt_f^2) q is moved to the right hand side with the positions q of the previous iteration
+//   (the iterations converge to the same positions, slightly slower when dt is far from dt_f)
+struct projective_dynamics_data
+{
+    Eigen::SimplicialLDLT< Eigen::SparseMatrix<float> > solver; // Factorization of the global matrix
+    int iterations = 10; // Local/global iterations per step
+    float dt_tolerance = 1.2f; // Largest ratio between dt and the time step of the factorization (1: refactorized when dt changes)
+    int factorizations = 0;    // Number of factorizations since the creation of the solver
+
+    // State of the current factorization (refactorized when one of them changes)
+    int N_dim = 0;
+    float K = 0.0f;
+    float m = 0.0f;
+    float dt = 0.0f; // Time step of the factorization
+    std::vector<size_t> fixed_index; // Particles with a positional constraint, eliminated from the system (identity rows)
+    vcl::buffer<int> fixed;
+
+    vcl::buffer<vcl::vec3> inertia;    // s = p + dt v + dt^2 f_ext/m
+    vcl::buffer<vcl::vec3> q;          // Positions of the current iteration
+    vcl::buffer<vcl::vec3> projection; // proj_ij of the spring starting at i with offset s, at index cloth_spring_offset_count*i+s
+    Eigen::MatrixXf rhs;               // N x 3 right hand side of the global step
+    Eigen::MatrixXf x;                 // N x 3 solution of the global step
+};
+
+
+// Projective dynamics step of the cloth: p and v are updated, v = (p_new-p)/dt
+//  - external forces: gravity and drag (explicit)
+//  - the positional constraints are exactly satisfied
+void numerical_integration_projective(vcl::grid_2D<vcl::vec3>& position, vcl::grid_2D<vcl::vec3>& velocity, std::map<size_t, vcl::vec3> const& positional_constraints, simulation_parameters const& parameters, projective_dynamics_data& solver, float dt);
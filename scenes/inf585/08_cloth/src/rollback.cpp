@@ -0,0 +1,66 @@
+#include "rollback.hpp"
+
+using namespace vcl;
+
+
+void cloth_rollback::clear()
+{
+    ring.clear();
+    newest = -1;
+    count = 0;
+    retries = 0;
+    frames_behind = 0;
+    dt_factor = 1.0f;
+    dt_factor_max = 1.0f;
+    rollbacks = 0;
+}
+
+void cloth_rollback::frame_start(grid_2D<vec3> const& position, grid_2D<vec3> const& velocity)
+{
+    if(int(ring.size())!=capacity) {
+        ring.resize(capacity);
+        newest = -1;
+        count = 0;
+    }
+
+    // The buffers of the overwritten checkpoint are reused (no allocation once the ring is full)
+    newest = (newest+1)%capacity;
+    ring[newest].position = position;
+    ring[newest].velocity = velocity;
+    count = std::min(count+1, capacity);
+    retries = 0;
+    frames_behind = 0;
+}
+
+void cloth_rollback::frame_end()
+{
+    dt_factor = std::min(dt_factor*growth, dt_factor_max);
+}
+
+bool cloth_rollback::rollback(grid_2D<vec3>& position, grid_2D<vec3>& velocity)
+{
+    if(count==0)
+        return false;
+
+    // The first divergence since a valid frame bounds the factor: the following retries may fail because of the checkpoint itself
+    if(retries==0 && frames_behind==0)
+        dt_factor_max = std::min(dt_factor_max, dt_factor/growth);
+
+    // The newest checkpoint may already be on its way to diverge: fall back to the previous one
+    retries++;
+    if(retries>retries_max && count>1) {
+        newest = (newest-1+capacity)%capacity;
+        count--;
+        retries = 1;
+        frames_behind++;
+    }
+
+    dt_factor *= 0.5f;
+    if(dt_factor<dt_factor_min)
+        return false;
+
+    position = ring[newest].position;
+    velocity = ring[newest].velocity;
+    rollbacks++;
+    return true;
+}
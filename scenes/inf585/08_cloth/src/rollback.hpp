@@ -0,0 +1,48 @@
+#pragma once
+
+#include "vcl/vcl.hpp"
+
+
+// Recovery of a diverging cloth simulation from checkpoints instead of stopping it
+//  - A checkpoint (position, velocity) is saved at the start of every frame in a ring of the last capacity frames
+//  - On divergence, the state is restored from the newest checkpoint and the time step is halved (dt_factor)
+//    When the retries from the same checkpoint keep failing, this checkpoint is dropped and the previous one is used:
+//    the frames since this older checkpoint have to be simulated again (resimulated_frames) so that no simulated time is lost
+//  - After each frame without divergence, dt_factor grows back progressively, but stays below the factor that diverged from a valid
+//    frame (dt_factor_max): a step just above the stability limit diverges slowly, the cloth would tangle at each attempt to grow back
+//  The simulation only pays small time steps around the stiff events, not for the whole run
+struct cloth_rollback
+{
+    int capacity = 4;              // Number of checkpoints kept (one per frame)
+    int retries_max = 3;           // Failed retries from a checkpoint before falling back to the previous one
+    float dt_factor = 1.0f;        // Current reduction of the time step
+    float dt_factor_min = 1/256.0f; // Below this reduction the simulation is considered unrecoverable
+    float growth = 1.05f;          // Increase of dt_factor after each valid frame
+    float dt_factor_max = 1.0f;    // Upper bound of dt_factor (below the last factor that diverged, reset by clear)
+
+    int rollbacks = 0; // Total number of rollbacks (statistics)
+
+    void clear();
+
+    // Save the state at the start of a frame (the oldest checkpoint is overwritten when the ring is full)
+    void frame_start(vcl::grid_2D<vcl::vec3> const& position, vcl::grid_2D<vcl::vec3> const& velocity);
+    // Frame completed without divergence: dt_factor grows back
+    void frame_end();
+
+    // Restore a valid state and halve the time step. Returns false if the simulation can't be recovered.
+    bool rollback(vcl::grid_2D<vcl::vec3>& position, vcl::grid_2D<vcl::vec3>& velocity);
+    // Number of frames to simulate from the restored checkpoint to reach the end of the current frame (1 for the newest checkpoint)
+    int resimulated_frames() const { return frames_behind+1; }
+
+private:
+    struct checkpoint
+    {
+        vcl::grid_2D<vcl::vec3> position;
+        vcl::grid_2D<vcl::vec3> velocity;
+    };
+    std::vector<checkpoint> ring;
+    int newest = -1; // Index of the newest checkpoint in the ring
+    int count = 0;   // Number of valid checkpoints
+    int retries = 0; // Consecutive rollbacks to the newest checkpoint
+    int frames_behind = 0; // Checkpoints dropped since the start of the current frame
+};
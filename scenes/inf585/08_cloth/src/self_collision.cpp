@@ -0,0 +1,97 @@
+#include "self_collision.hpp"
+#include "closest_point.hpp"
+
+using namespace vcl;
+
+
+static int3 triangle_index(uint3 const& t)
+{
+    return {int(t[0]), int(t[1]), int(t[2])};
+}
+
+void apply_self_collision(grid_2D<vec3>& position, grid_2D<vec3>& velocity, buffer<uint3> const& triangles, cloth_self_collision& collision)
+{
+    int const N = int(position.size());
+    int const N_dim = int(position.dimension.x);
+    float const L0 = 1.0f/(N_dim-1.0f);
+    float const h = collision.thickness*L0;
+
+    // Spatial hash of the triangles enlarged by the thickness
+    collision.hash.build(triangles.size(), [&](int k, vec3& p_min, vec3& p_max) {
+        int3 const t = triangle_index(triangles[k]);
+        vec3 const& a = position[t[0]];
+        vec3 const& b = position[t[1]];
+        vec3 const& c = position[t[2]];
+        for(int d=0; d<3; ++d) {
+            p_min[d] = std::min(std::min(a[d],b[d]),c[d]) - h;
+            p_max[d] = std::max(std::max(a[d],b[d]),c[d]) + h;
+        }
+    }, L0);
+
+    // Closest triangle of each particle within the thickness
+    collision.dp.resize(N);
+    collision.dv.resize(N);
+    int contacts = 0;
+    #pragma omp parallel for reduction(+:contacts)
+    for(int i=0; i<N; ++i)
+    {
+        vec3 const& p = position[i];
+        float depth_max = 0.0f;
+        vec3 n_contact, v_triangle;
+        collision.hash.for_each_candidate(p, [&](int k) {
+            int3 const t = triangle_index(triangles[k]);
+            if(t[0]==i || t[1]==i || t[2]==i)
+                return;
+            vec3 const& a = position[t[0]];
+            vec3 const& b = position[t[1]];
+            vec3 const& c = position[t[2]];
+            vec3 const bary = closest_point_triangle(p, a, b, c);
+            vec3 const d = p - (bary[0]*a + bary[1]*b + bary[2]*c);
+            float const l = norm(d);
+            if(h-l <= depth_max)
+                return;
+
+            vec3 const v = bary[0]*velocity[t[0]] + bary[1]*velocity[t[1]] + bary[2]*velocity[t[2]];
+            vec3 n;
+            if(l>1e-6f)
+                n = d/l;
+            else {
+                // Particle on the triangle: push it back on the side it comes from
+                //  A collapsed triangle of a folded cloth has no normal: the particle goes back along its relative velocity
+                vec3 const normal = cross(b-a, c-a);
+                float const normal_length = norm(normal);
+                vec3 const v_relative = velocity[i]-v;
+                float const v_relative_length = norm(v_relative);
+                if(normal_length>1e-6f*L0*L0)
+                    n = normal/normal_length;
+                else if(v_relative_length>1e-6f)
+                    n = v_relative/v_relative_length;
+                else
+                    return; // no direction to separate them
+                if(dot(v_relative, n)>0)
+                    n = -n;
+            }
+
+            depth_max = h-l;
+            v_triangle = v;
+            n_contact = n;
+        });
+
+        collision.dp[i] = {0,0,0};
+        collision.dv[i] = {0,0,0};
+        if(depth_max>0) {
+            float const vn = dot(velocity[i]-v_triangle, n_contact);
+            collision.dp[i] = depth_max*n_contact;
+            if(vn<0)
+                collision.dv[i] = -vn*n_contact;
+            contacts++;
+        }
+    }
+    collision.contacts = contacts;
+
+    #pragma omp parallel for
+    for(int i=0; i<N; ++i) {
+        position[i] += collision.dp[i];
+        velocity[i] += collision.dv[i];
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "simulation.hpp"
+#include "spatial_hash.hpp"
+
+
+// Self collision of the cloth: proximity between the particles and the triangles that do not contain them
+//  - The triangles, enlarged by the thickness, are stored in a spatial hash rebuilt at every step (cells of the size of the springs)
+//  - Each particle closer than the thickness to a triangle is pushed back at the thickness distance along the closest direction,
+//    and its velocity toward the triangle is removed (inelastic contact)
+//  - The corrections are computed independently per particle (in parallel) and only move the particle
+//  Only proximity is handled: a particle that already went through the cloth in a single step is not brought back
+struct cloth_self_collision
+{
+    float thickness = 0.4f; // Minimal distance to a triangle, relative to the rest length of the structural springs
+
+    spatial_hash hash;        // Triangles of the cloth
+    vcl::buffer<vcl::vec3> dp; // Position correction of each particle
+    vcl::buffer<vcl::vec3> dv; // Velocity correction of each particle
+
+    int contacts = 0; // Number of particles in contact at the last step
+};
+
+void apply_self_collision(vcl::grid_2D<vcl::vec3>& position, vcl::grid_2D<vcl::vec3>& velocity, vcl::buffer<vcl::uint3> const& triangles, cloth_self_collision& collision);
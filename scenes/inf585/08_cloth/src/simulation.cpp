@@ -2,6 +2,7 @@
 
 using namespace vcl;
 
+int2 const cloth_spring_offsets[cloth_spring_offset_count] = { {1,0}, {0,1}, {1,1}, {1,-1}, {2,0}, {0,2} };
 
 // Fill value of force applied on each particle
 // - Gravity
@@ -18,18 +19,23 @@ void compute_forces(grid_2D<vec3>& force, grid_2D<vec3> const& position, grid_2D
     float const mu = parameters.mu;
     float const	L0 = 1.0f/(N_dim-1.0f);
 
-    // Gravity
+    // Gravity and drag
     const vec3 g = {0,0,-9.81f};
-    for(size_t k=0; k<N; ++k)
-        force[k] = m*g;
-
-    // Drag
-    for(size_t k=0; k<N; ++k)
-        force[k] += -mu*m*velocity[k];
-
-
-    // TO DO: Add spring forces ...
-
+    #pragma omp parallel for
+    for(int k=0; k<int(N); ++k)
+        force[k] = m*g - mu*m*velocity[k];
+
+
+    // Springs: structural, shear and bending (colored: no concurrent accumulation on a particle)
+    for_each_spring_parallel(int(N_dim), L0, [&](int i, int j, int, float L) {
+        vec3 const d = position[j]-position[i];
+        float const l = norm(d);
+        if(l<1e-8f) // coincident particles: no defined direction
+            return;
+        vec3 const f = K*(l-L)*d/l;
+        force[i] += f;
+        force[j] -= f;
+    });
 
 }
 
@@ -47,11 +53,39 @@ void numerical_integration(grid_2D<vec3>& position, grid_2D<vec3>& velocity, gri
 
 void apply_constraints(grid_2D<vec3>& position, grid_2D<vec3>& velocity, std::map<size_t, vec3> const& positional_constraints, obstacles_parameters const& obstacles)
 {
-    // Fixed positions of the cloth
-    for(const auto& constraints : positional_constraints)
-        position[constraints.first] = constraints.second;
+    // Ground and sphere: the particles are projected on the surface (slightly above it) and their velocity toward the obstacle is removed
+    float const epsilon = 1e-3f;
+    size_t const N = position.size();
+    for(size_t k=0; k<N; ++k)
+    {
+        vec3& p = position[k];
+        vec3& v = velocity[k];
+        if(p.z < obstacles.z_ground+epsilon) {
+            p.z = obstacles.z_ground+epsilon;
+            v.z = std::max(v.z, 0.0f);
+        }
 
-    // To do: apply external constraints
+        vec3 const d = p-obstacles.sphere_center;
+        float const l = norm(d);
+        float const r = obstacles.sphere_radius+epsilon;
+        if(l<r && l>1e-6f) {
+            vec3 const n = d/l;
+            p = obstacles.sphere_center + r*n;
+            float const vn = dot(v,n);
+            if(vn<0)
+                v -= vn*n;
+        }
+    }
+
+    // Triangle meshes
+    for(mesh_obstacle const& obstacle : obstacles.meshes)
+        obstacle.collide(position, velocity);
+
+    // Fixed positions of the cloth (and null velocity)
+    for(const auto& constraints : positional_constraints) {
+        position[constraints.first] = constraints.second;
+        velocity[constraints.first] = {0,0,0};
+    }
 }
 
 
@@ -62,7 +96,30 @@ void initialize_simulation_parameters(simulation_parameters& parameters, float L
 	parameters.mu = 10.0f;
 }
 
-bool detect_simulation_divergence(grid_2D<vec3> const& force, grid_2D<vec3> const& position)
+void initialize_timestep(timestep_adaptive& timestep)
+{
+    timestep.cfl_frequency = 1.3f;
+}
+
+timestep_measure measure_timestep(grid_2D<vec3> const& velocity, grid_2D<vec3> const& force, simulation_parameters const& parameters)
+{
+    size_t const N = force.size();
+    size_t const N_dim = force.dimension[0];
+    float const m = parameters.mass_total/N;
+
+    float v_max = 0.0f;
+    for(size_t k=0; k<N; ++k)
+        v_max = std::max(v_max, norm(velocity[k]));
+
+    timestep_measure measure;
+    measure.length = 1.0f/(N_dim-1.0f);
+    measure.velocity_max = v_max;
+    if(parameters.integrator==cloth_integrator_explicit)
+        measure.frequency = std::max(2*std::sqrt(3*parameters.K/m), parameters.mu);
+    return measure;
+}
+
+bool detect_simulation_divergence(grid_2D<vec3> const& force, grid_2D<vec3> const& position, bool verbose)
 {
     bool simulation_diverged = false;
     const size_t N = position.size();
@@ -73,19 +130,22 @@ bool detect_simulation_divergence(grid_2D<vec3> const& force, grid_2D<vec3> cons
 
         if( std::isnan(f) ) // detect NaN in force
         {
-            std::cout<<"NaN detected in forces"<<std::endl;
+            if(verbose)
+                std::cout<<"NaN detected in forces"<<std::endl;
             simulation_diverged = true;
         }
 
         if( f>600.0f ) // detect strong force magnitude
         {
-            std::cout<<" **** Warning : Strong force magnitude detected "<<f<<" at vertex "<<k<<" ****"<<std::endl;
+            if(verbose)
+                std::cout<<" **** Warning : Strong force magnitude detected "<<f<<" at vertex "<<k<<" ****"<<std::endl;
             simulation_diverged = true;
         }
 
         if( std::isnan(p.x) || std::isnan(p.y) || std::isnan(p.z) ) // detect NaN in position
         {
-            std::cout<<"NaN detected in positions"<<std::endl;
+            if(verbose)
+                std::cout<<"NaN detected in positions"<<std::endl;
             simulation_diverged = true;
         }
     }
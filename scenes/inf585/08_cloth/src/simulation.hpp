@@ -1,25 +1,104 @@
 #pragma once
 
 #include "vcl/vcl.hpp"
+#include "mesh_obstacle.hpp"
+
+// Time integration of the cloth
+//  - explicit: semi-implicit Euler, stable only for small time steps (dt < ~sqrt(m/K))
+//  - implicit: backward Euler [Baraff and Witkin 1998], stable for stiff springs and large time steps
+//  - projective: projective dynamics [Bouaziz et al. 2014], fixed number of iterations with a prefactorized matrix, cost independent of the stiffness
+enum cloth_integrator_type { cloth_integrator_explicit, cloth_integrator_implicit, cloth_integrator_projective };
 
 struct simulation_parameters
 {
     float mass_total; // total mass of the cloth
     float K; // stiffness
     float mu; // damping    
+    cloth_integrator_type integrator = cloth_integrator_explicit;
 };
 
+// Springs of the cloth: the particle (ku,kv) is linked to (ku+du,kv+dv) for each offset (du,dv)
+//  structural (1,0),(0,1) - shear (1,1),(1,-1) - bending (2,0),(0,2)
+//  Each spring is listed once, from the particle with the lowest index along the offset
+int const cloth_spring_offset_count = 6;
+extern vcl::int2 const cloth_spring_offsets[cloth_spring_offset_count];
+
+// Call f(i, j, s, L) for every spring between the particles of offsets i and j in a N_dim x N_dim grid
+//  s: index of the spring offset, L: rest length of the spring (L0 is the rest length of the structural springs)
+template <typename F> void for_each_spring(int N_dim, float L0, F const& f);
+
+// Same as for_each_spring with the springs processed in parallel, f is called from several threads
+//  The springs of an offset are split into two colors by the parity of their start along the offset (in units of its length):
+//  two springs of the same color never share a particle, so f can accumulate on i and j without synchronization
+//  The colors are processed one after the other: the result does not depend on the number of threads
+template <typename F> void for_each_spring_parallel(int N_dim, float L0, F const& f);
+
 struct obstacles_parameters
 {
 	float z_ground = 0.0f;
     vcl::vec3 sphere_center = {0.15f,0.5f,0};
     float sphere_radius = 0.1f;
+    std::vector<mesh_obstacle> meshes; // Arbitrary triangle meshes (ex. loaded with mesh_load_file_obj)
 };
 
 void initialize_simulation_parameters(simulation_parameters& parameters, float L_cloth, size_t N_cloth);
+// Safety factors of the adaptive time step for the cloth
+//  The explicit integration diverges for dt > 2/frequency: the frequency limit is set at 0.65 of it, the fixed step of the scene
+void initialize_timestep(vcl::timestep_adaptive& timestep);
 void compute_forces(vcl::grid_2D<vcl::vec3>& force, vcl::grid_2D<vcl::vec3> const& position, vcl::grid_2D<vcl::vec3> const& velocity, vcl::grid_2D<vcl::vec3>& normals, simulation_parameters const& parameters, float wind_magnitude);
 
 void numerical_integration(vcl::grid_2D<vcl::vec3>& position, vcl::grid_2D<vcl::vec3>& velocity, vcl::grid_2D<vcl::vec3> const& forces, float mass, float dt);
 
 void apply_constraints(vcl::grid_2D<vcl::vec3>& position, vcl::grid_2D<vcl::vec3>& velocity, std::map<size_t, vcl::vec3> const& positional_constraints, obstacles_parameters const& obstacles);
-bool detect_simulation_divergence(vcl::grid_2D<vcl::vec3> const& force, vcl::grid_2D<vcl::vec3> const& position);
\ No newline at end of file
+// NaN or force too large (messages on the console if verbose)
+bool detect_simulation_divergence(vcl::grid_2D<vcl::vec3> const& force, vcl::grid_2D<vcl::vec3> const& position, bool verbose=true);
+
+// Stability measure of the cloth for the adaptive time step
+//  - length: rest length of the springs, frequency: highest oscillation of the cloth 2*sqrt(3K/m) or drag rate mu
+//    (a particle pulled along an axis by its structural, shear and bending springs has a stiffness 3K)
+//  - the spring forces are bounded by the frequency limit: the acceleration limit is not used, the fixed particles carry
+//    the weight of the whole cloth and their forces would limit the step for nothing
+//  - the implicit and projective integrations are stable for any stiffness: only the velocity limit applies
+vcl::timestep_measure measure_timestep(vcl::grid_2D<vcl::vec3> const& velocity, vcl::grid_2D<vcl::vec3> const& force, simulation_parameters const& parameters);
+
+
+
+template <typename F>
+void for_each_spring(int N_dim, float L0, F const& f)
+{
+    for(int s=0; s<cloth_spring_offset_count; ++s) {
+        vcl::int2 const& o = cloth_spring_offsets[s];
+        float const L = L0*std::sqrt(float(o.x*o.x+o.y*o.y));
+        for(int kv=std::max(-o.y,0); kv<N_dim-std::max(o.y,0); ++kv)
+            for(int ku=0; ku<N_dim-o.x; ++ku)
+                f(ku+N_dim*kv, ku+o.x+N_dim*(kv+o.y), s, L);
+    }
+}
+
+template <typename F>
+void for_each_spring_parallel(int N_dim, float L0, F const& f)
+{
+    for(int s=0; s<cloth_spring_offset_count; ++s) {
+        vcl::int2 const& o = cloth_spring_offsets[s];
+        float const L = L0*std::sqrt(float(o.x*o.x+o.y*o.y));
+        int const kv_start = std::max(-o.y,0);
+        int const kv_end = N_dim-std::max(o.y,0);
+        int const ku_end = N_dim-o.x;
+        int const length = o.x!=0 ? std::abs(o.x) : std::abs(o.y);
+        for(int color=0; color<2; ++color) {
+            #pragma omp parallel for
+            for(int kv=kv_start; kv<kv_end; ++kv) {
+                if(o.x!=0) {
+                    // Blocks of length springs along u, one block over two
+                    for(int ku0=color*length; ku0<ku_end; ku0+=2*length)
+                        for(int ku=ku0; ku<std::min(ku0+length,ku_end); ++ku)
+                            f(ku+N_dim*kv, ku+o.x+N_dim*(kv+o.y), s, L);
+                }
+                else if((kv/length)%2==color) {
+                    for(int ku=0; ku<ku_end; ++ku)
+                        f(ku+N_dim*kv, ku+N_dim*(kv+o.y), s, L);
+                }
+            }
+        }
+    }
+}
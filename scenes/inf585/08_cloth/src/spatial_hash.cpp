@@ -0,0 +1,19 @@
+#include "spatial_hash.hpp"
+
+using namespace vcl;
+
+
+int3 spatial_hash::cell_coordinates(vec3 const& p) const
+{
+    int3 idx;
+    for(int c=0; c<3; ++c)
+        idx[c] = int(std::floor(std::min(1e8f, std::max(-1e8f, p[c]/cell_size))));
+    return idx;
+}
+
+int spatial_hash::bucket(int3 const& cell) const
+{
+    // Large primes of [Teschner et al. 2003]
+    unsigned int const h = (unsigned int)(cell.x)*73856093u ^ (unsigned int)(cell.y)*19349663u ^ (unsigned int)(cell.z)*83492791u;
+    return int(h % (unsigned int)(bucket_start.size()-1));
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "vcl/vcl.hpp"
+
+
+// Spatial hash of elements covering axis aligned boxes [Teschner et al. 2003]
+//  - The space is split into cubic cells, each cell is mapped to a bucket of a table of fixed size by a hash of its integer coordinates
+//  - An element is stored in the buckets of all the cells overlapped by its bounding box
+//  - Element indices are sorted per bucket using a counting sort, rebuilt at every time step
+//  There is no bounding grid: the memory only depends on the number of elements, whatever the extent of the cloth
+//  Different cells can share a bucket: the caller still has to check the exact proximity of the candidates
+struct spatial_hash
+{
+    float cell_size = 0.0f;
+    static int const cell_range_max = 8; // Maximal number of cells covered by an element along each axis
+
+    vcl::buffer<int> bucket_start; // Offset of the first element of each bucket in sorted_index (size = number of buckets + 1)
+    vcl::buffer<int> sorted_index; // Element indices sorted by bucket (an element appears once per overlapped cell)
+
+    // Rebuild the table from the current bounding boxes
+    //  box(k, p_min, p_max) must fill the bounding box of the k-th element
+    template <typename F> void build(size_t N, F const& box, float cell_size);
+
+    // Call f(k) for every element stored in the bucket of the cell containing p
+    template <typename F> void for_each_candidate(vcl::vec3 const& p, F const& f) const;
+
+    vcl::int3 cell_coordinates(vcl::vec3 const& p) const;
+    int bucket(vcl::int3 const& cell) const;
+
+private:
+    vcl::buffer<vcl::int3> box_min, box_max; // Cell ranges of the elements
+    vcl::buffer<int> bucket_fill;            // Temporary insertion offset per bucket used by the counting sort
+};
+
+
+
+template <typename F>
+void spatial_hash::build(size_t N, F const& box, float cell_size_arg)
+{
+    using namespace vcl;
+    cell_size = cell_size_arg;
+
+    // Cell range of each element
+    box_min.resize(N);
+    box_max.resize(N);
+    #pragma omp parallel for
+    for(int k=0; k<int(N); ++k) {
+        vec3 p_min, p_max;
+        box(k, p_min, p_max);
+        box_min[k] = cell_coordinates(p_min);
+        box_max[k] = cell_coordinates(p_max);
+        // Limit the range of very large elements (ex. diverging simulation): they are then missed by some far cells
+        for(int c=0; c<3; ++c)
+            box_max[k][c] = std::min(box_max[k][c], box_min[k][c]+cell_range_max-1);
+    }
+
+    // Table of about two buckets per element: unrelated cells seldom share a bucket
+    size_t const N_bucket = 2*N+1;
+
+    // Counting sort of the (element, cell) pairs by bucket
+    bucket_start.resize(N_bucket+1);
+    bucket_start.fill(0);
+    for(size_t k=0; k<N; ++k)
+        for(int z=box_min[k].z; z<=box_max[k].z; ++z)
+            for(int y=box_min[k].y; y<=box_max[k].y; ++y)
+                for(int x=box_min[k].x; x<=box_max[k].x; ++x)
+                    bucket_start[bucket({x,y,z})+1]++;
+
+    for(size_t b=0; b<N_bucket; ++b)
+        bucket_start[b+1] += bucket_start[b];
+
+    sorted_index.resize(bucket_start[N_bucket]);
+    bucket_fill = bucket_start;
+    for(size_t k=0; k<N; ++k)
+        for(int z=box_min[k].z; z<=box_max[k].z; ++z)
+            for(int y=box_min[k].y; y<=box_max[k].y; ++y)
+                for(int x=box_min[k].x; x<=box_max[k].x; ++x)
+                    sorted_index[bucket_fill[bucket({x,y,z})]++] = int(k);
+}
+
+template <typename F>
+void spatial_hash::for_each_candidate(vcl::vec3 const& p, F const& f) const
+{
+    int const b = bucket(cell_coordinates(p));
+    int const* index = sorted_index.data.data();
+    int const k_end = bucket_start[b+1];
+    for(int k=bucket_start[b]; k<k_end; ++k)
+        f(index[k]);
+}
@@ -0,0 +1,33 @@
+#include "advection.hpp"
+
+using namespace vcl;
+
+
+void cell_velocity(grid_2D<vec2>& velocity_cell, grid_2D<vec2> const& velocity)
+{
+    // The average of the bilinear interpolations at (x+-0.5,y+-0.5) is the 3x3 stencil [1 2 1; 2 4 2; 1 2 1]/16
+    int const N = int(velocity.dimension.x);
+    velocity_cell.resize(N, N);
+    velocity_cell.fill({0,0});
+
+    #pragma omp parallel for
+    for(int y=1; y<N-1; ++y) {
+        for(int x=1; x<N-1; ++x) {
+            vec2 const corners = velocity(x-1,y-1)+velocity(x+1,y-1)+velocity(x-1,y+1)+velocity(x+1,y+1);
+            vec2 const sides = velocity(x-1,y)+velocity(x+1,y)+velocity(x,y-1)+velocity(x,y+1);
+            velocity_cell(x,y) = (corners + 2.0f*sides + 4.0f*velocity(x,y))/16.0f;
+        }
+    }
+}
+
+void cell_velocity(grid_2D<vec2>& velocity_cell, velocity_mac const& velocity)
+{
+    int const N = velocity.size();
+    velocity_cell.resize(N, N);
+    velocity_cell.fill({0,0});
+
+    #pragma omp parallel for
+    for(int y=1; y<N-1; ++y)
+        for(int x=1; x<N-1; ++x)
+            velocity_cell(x,y) = velocity.at_cell(x,y);
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "vcl/vcl.hpp"
+#include "boundary.hpp"
+#include "velocity_mac.hpp"
+
+
+// Advection schemes of the cell-centered fields (density, collocated velocity)
+//  - semi_lagrangian: value at the back-traced position by bilinear interpolation (first order, smooths the field at every step)
+//  - maccormack: the semi-Lagrangian result is advected backward in time, half of its difference with the initial field estimates
+//    the error of the step and is added to the result (2 advections)
+//  - bfecc: back and forth error compensation, the estimated error is removed from the initial field which is then advected (3 advections)
+//  The corrected values are clamped to the range of the 4 cells around the back-traced position (limiter): the compensation
+//  cannot create new extrema, which would oscillate and grow near discontinuities.
+enum advection_type { advection_semi_lagrangian, advection_maccormack, advection_bfecc };
+
+// Working grids of the compensated advection of a field of T, kept by the caller between the steps (one per advected field)
+template <typename T>
+struct advection_workspace
+{
+    vcl::grid_2D<vcl::vec2> velocity_cell; // Velocity at the cell centers (cell_velocity)
+    vcl::grid_2D<T> value_backward;        // Backward step, then corrected initial field (bfecc)
+};
+
+// Velocity used to trace the cell centers (the boundary cells are set to 0)
+//  Collocated velocity: average of the bilinear interpolations at the 4 corners of the cell (as in advect)
+//  Staggered velocity: average of the two faces in each direction
+void cell_velocity(vcl::grid_2D<vcl::vec2>& velocity_cell, vcl::grid_2D<vcl::vec2> const& velocity);
+void cell_velocity(vcl::grid_2D<vcl::vec2>& velocity_cell, velocity_mac const& velocity);
+
+// Advection of the interior cells of value_reference by velocity_cell (cell_velocity) with one of the schemes
+//  The boundary cells of new_value are copied from value_reference, value_backward is a working grid
+template <typename T>
+void advect_compensated(vcl::grid_2D<T>& new_value, vcl::grid_2D<T> const& value_reference, vcl::grid_2D<vcl::vec2> const& velocity_cell, float dt, advection_type type, vcl::grid_2D<T>& value_backward);
+
+// One semi-Lagrangian step of the interior cells along velocity_cell (dt<0 traces the cells forward in time)
+template <typename T>
+void advect_cells(vcl::grid_2D<T>& new_value, vcl::grid_2D<T> const& value_reference, vcl::grid_2D<vcl::vec2> const& velocity_cell, float dt);
+
+// Clamp each component of value to the range of the 4 cells of field used by the bilinear interpolation at (x,y)
+template <typename T>
+T clamp_to_interpolation_range(T value, vcl::grid_2D<T> const& field, float x, float y);
+
+
+
+
+template <typename T>
+void advect_cells(vcl::grid_2D<T>& new_value, vcl::grid_2D<T> const& value_reference, vcl::grid_2D<vcl::vec2> const& velocity_cell, float dt)
+{
+    using namespace vcl;
+    int const N = int(new_value.dimension.x);
+
+    #pragma omp parallel for
+    for(int y=1; y<N-1; ++y) {
+        for(int x=1; x<N-1; ++x) {
+            vec2 const p_back = vec2(float(x),float(y)) - dt*velocity_cell(x,y);
+            new_value(x,y) = interpolation_bilinear_clamped(value_reference, p_back.x, p_back.y);
+        }
+    }
+}
+
+template <typename T>
+T clamp_to_interpolation_range(T value, vcl::grid_2D<T> const& field, float x, float y)
+{
+    int constexpr D = int(sizeof(T)/sizeof(float)); // The components are processed as D floats
+    // Same cells as interpolation_bilinear_clamped
+    x = std::min(std::max(x, 0.0f), field.dimension.x-1.001f);
+    y = std::min(std::max(y, 0.0f), field.dimension.y-1.001f);
+    int const x0 = int(x);
+    int const y0 = int(y);
+
+    float const* c00 = reinterpret_cast<float const*>(&field(x0,y0));
+    float const* c10 = reinterpret_cast<float const*>(&field(x0+1,y0));
+    float const* c01 = reinterpret_cast<float const*>(&field(x0,y0+1));
+    float const* c11 = reinterpret_cast<float const*>(&field(x0+1,y0+1));
+    float* v = reinterpret_cast<float*>(&value);
+    for(int d=0; d<D; ++d) {
+        float const v_min = std::min(std::min(c00[d], c10[d]), std::min(c01[d], c11[d]));
+        float const v_max = std::max(std::max(c00[d], c10[d]), std::max(c01[d], c11[d]));
+        v[d] = std::min(std::max(v[d], v_min), v_max);
+    }
+    return value;
+}
+
+template <typename T>
+void advect_compensated(vcl::grid_2D<T>& new_value, vcl::grid_2D<T> const& value_reference, vcl::grid_2D<vcl::vec2> const& velocity_cell, float dt, advection_type type, vcl::grid_2D<T>& value_backward)
+{
+    using namespace vcl;
+    int const N = int(new_value.dimension.x);
+    if(value_backward.dimension.x!=new_value.dimension.x || value_backward.dimension.y!=new_value.dimension.y)
+        value_backward.resize(new_value.dimension.x, new_value.dimension.y);
+
+    // Semi-Lagrangian step
+    copy_boundary(new_value, value_reference);
+    advect_cells(new_value, value_reference, velocity_cell, dt);
+    if(type==advection_semi_lagrangian)
+        return;
+
+    // Backward step of the result: equal to value_reference up to twice the error of one step
+    copy_boundary(value_backward, value_reference);
+    advect_cells(value_backward, new_value, velocity_cell, -dt);
+
+    if(type==advection_maccormack) {
+        // Correction of the result by half the difference, then limiter
+        #pragma omp parallel for
+        for(int y=1; y<N-1; ++y) {
+            for(int x=1; x<N-1; ++x) {
+                vec2 const p_back = vec2(float(x),float(y)) - dt*velocity_cell(x,y);
+                T const corrected = new_value(x,y) + 0.5f*(value_reference(x,y)-value_backward(x,y));
+                new_value(x,y) = clamp_to_interpolation_range(corrected, value_reference, p_back.x, p_back.y);
+            }
+        }
+    }
+    else {
+        // Corrected initial field (stored in value_backward), advected again, then limiter
+        #pragma omp parallel for
+        for(int y=1; y<N-1; ++y)
+            for(int x=1; x<N-1; ++x)
+                value_backward(x,y) = value_reference(x,y) + 0.5f*(value_reference(x,y)-value_backward(x,y));
+
+        #pragma omp parallel for
+        for(int y=1; y<N-1; ++y) {
+            for(int x=1; x<N-1; ++x) {
+                vec2 const p_back = vec2(float(x),float(y)) - dt*velocity_cell(x,y);
+                T const corrected = interpolation_bilinear_clamped(value_backward, p_back.x, p_back.y);
+                new_value(x,y) = clamp_to_interpolation_range(corrected, value_reference, p_back.x, p_back.y);
+            }
+        }
+    }
+}
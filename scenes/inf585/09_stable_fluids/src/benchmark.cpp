@@ -0,0 +1,509 @@
+#include "benchmark.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <vector>
+
+using namespace vcl;
+
+
+// Swirling velocity field with a strong divergent part (cells/s, same motion relative to the domain for all resolutions)
+static void initialize_velocity_benchmark(grid_2D<vec2>& velocity, int N)
+{
+    velocity.resize(N, N);
+    for(int y=0; y<N; ++y) {
+        for(int x=0; x<N; ++x) {
+            float const u = x/(N-1.0f), v = y/(N-1.0f);
+            vec2 const swirl = {-std::sin(3.14159f*u)*std::cos(3.14159f*v), std::cos(3.14159f*u)*std::sin(3.14159f*v)};
+            vec2 const source = vec2(u-0.3f, v-0.6f)*std::exp(-40.0f*((u-0.3f)*(u-0.3f)+(v-0.6f)*(v-0.6f)));
+            velocity(x,y) = 0.05f*N*(swirl + 4.0f*source);
+        }
+    }
+    set_boundary_reflective(velocity);
+}
+
+static std::string relaxation_name(relaxation_type type)
+{
+    char const* name[] = {"Gauss-Seidel", "red-black", "Jacobi"};
+    return name[type];
+}
+
+void benchmark_pressure_solver()
+{
+    int const N_frames = 8;
+    float const dt = 0.2f;
+
+    std::cout<<std::endl<<"Pressure projection - "<<N_frames<<" frames"<<std::endl;
+    std::cout<<std::setw(8)<<"N"<<std::setw(24)<<"solver"<<std::setw(14)<<"iterations"<<std::setw(14)<<"residual"<<std::setw(18)<<"projection (ms)"<<std::endl;
+    for(int N : {128, 256, 512, 1024})
+    {
+        // Relaxations with a fixed number of sweeps, then the multigrid
+        struct run_parameters { pressure_solver_type type; relaxation_type relaxation; int iterations; };
+        std::vector<run_parameters> const runs = {
+            {pressure_relaxation, relaxation_gauss_seidel, 20}, {pressure_relaxation, relaxation_red_black, 20},
+            {pressure_relaxation, relaxation_jacobi, 20}, {pressure_relaxation, relaxation_red_black, 100}, {pressure_multigrid, relaxation_red_black, 0},
+            {pressure_conjugate_gradient, relaxation_red_black, 0} };
+        for(run_parameters const& run : runs)
+        {
+            pressure_solver solver;
+            solver.type = run.type;
+            solver.relaxation.type = run.relaxation;
+            solver.relaxation.iterations = run.iterations;
+
+            grid_2D<vec2> velocity, velocity_previous;
+            initialize_velocity_benchmark(velocity, N);
+            velocity_previous = velocity;
+            grid_2D<float> divergence(N, N), gradient_field(N, N);
+
+            int iterations = 0;
+            float residual = 0.0f, t_projection = 0.0f;
+            for(int k_frame=0; k_frame<N_frames; ++k_frame)
+            {
+                velocity_previous = velocity;
+                auto const t0 = std::chrono::steady_clock::now();
+                divergence_free(velocity, velocity_previous, divergence, gradient_field, solver);
+                auto const t1 = std::chrono::steady_clock::now();
+                t_projection += std::chrono::duration<float, std::milli>(t1-t0).count();
+                iterations += solver.iterations;
+                residual += solver.residual_relative;
+
+                velocity_previous = velocity;
+                advect(velocity, velocity_previous, velocity_previous, dt);
+            }
+
+            std::string name = "conjugate gradient";
+            if(run.type==pressure_relaxation)
+                name = relaxation_name(run.relaxation)+" ("+str(run.iterations)+")";
+            if(run.type==pressure_multigrid)
+                name = "multigrid ("+str(solver.multigrid.level_count())+" levels)";
+            std::cout<<std::setw(8)<<N<<std::setw(24)<<name<<std::setw(14)<<float(iterations)/N_frames<<std::setw(14)<<residual/N_frames<<std::setw(18)<<t_projection/N_frames<<std::endl;
+        }
+    }
+}
+
+// |f_reference - (f - a Laplacian(f))| over the interior cells
+template <typename T>
+static double diffusion_residual(grid_2D<T> const& field, grid_2D<T> const& field_reference, float a)
+{
+    int const N = int(field.dimension.x);
+    double sum = 0.0;
+    for(int y=1; y<N-1; ++y) {
+        for(int x=1; x<N-1; ++x) {
+            T const r = field_reference(x,y) - (1+4*a)*field(x,y) + a*(field(x-1,y)+field(x+1,y)+field(x,y-1)+field(x,y+1));
+            sum += dot(r,r);
+        }
+    }
+    return std::sqrt(sum);
+}
+
+template <typename T>
+static void benchmark_diffusion_field(int N, std::string const& field_name, T const& value_a, T const& value_b, boundary_condition boundary)
+{
+    int const N_calls = 5;
+    float const mu = 0.005f, dt = 0.2f;
+    float const a = mu*dt*(N-2.0f)*(N-2.0f);
+
+    // Two half planes of different values
+    grid_2D<T> field_reference(N, N);
+    for(int y=0; y<N; ++y)
+        for(int x=0; x<N; ++x)
+            field_reference(x,y) = x<N/2 ? value_a : value_b;
+    double const residual_initial = diffusion_residual(field_reference, field_reference, a);
+
+    for(relaxation_type type : {relaxation_gauss_seidel, relaxation_red_black, relaxation_jacobi})
+    {
+        relaxation_parameters relaxation;
+        relaxation.type = type;
+        grid_2D<T> field;
+
+        float t = 0.0f;
+        for(int k=0; k<N_calls; ++k) {
+            field = field_reference;
+            auto const t0 = std::chrono::steady_clock::now();
+            diffuse(field, field_reference, mu, dt, boundary, relaxation);
+            auto const t1 = std::chrono::steady_clock::now();
+            t += std::chrono::duration<float, std::milli>(t1-t0).count();
+        }
+        float const residual = float(diffusion_residual(field, field_reference, a)/residual_initial);
+
+        std::cout<<std::setw(8)<<N<<std::setw(8)<<field_name<<std::setw(16)<<relaxation_name(type)<<std::setw(16)<<t/N_calls<<std::setw(22)<<residual<<std::endl;
+    }
+}
+
+void benchmark_diffusion()
+{
+    relaxation_parameters const relaxation;
+    std::cout<<std::endl<<"Diffusion - "<<relaxation.iterations<<" sweeps, "<<parallel_thread_count()<<" threads"<<std::endl;
+    std::cout<<std::setw(8)<<"N"<<std::setw(8)<<"field"<<std::setw(16)<<"relaxation"<<std::setw(16)<<"diffuse (ms)"<<std::setw(22)<<"residual reduction"<<std::endl;
+    for(int N : {128, 256, 512, 1024})
+    {
+        benchmark_diffusion_field(N, "vec2", vec2(1,0), vec2(0,1), reflective);
+        benchmark_diffusion_field(N, "vec3", vec3(1,0,0), vec3(0,1,0), copy);
+    }
+}
+
+// |divergence| over the interior cells, with the discretization used by each projection
+static float divergence_norm(grid_2D<vec2> const& velocity)
+{
+    int const N = int(velocity.dimension.x);
+    double sum = 0.0;
+    for(int y=1; y<N-1; ++y) {
+        for(int x=1; x<N-1; ++x) {
+            float const d = 0.5f*(velocity(x+1,y).x-velocity(x-1,y).x + velocity(x,y+1).y-velocity(x,y-1).y);
+            sum += d*d;
+        }
+    }
+    return float(std::sqrt(sum));
+}
+static float divergence_norm(velocity_mac const& velocity)
+{
+    int const N = velocity.size();
+    double sum = 0.0;
+    for(int y=1; y<N-1; ++y) {
+        for(int x=1; x<N-1; ++x) {
+            float const d = velocity.u(x+1,y)-velocity.u(x,y) + velocity.v(x,y+1)-velocity.v(x,y);
+            sum += d*d;
+        }
+    }
+    return float(std::sqrt(sum));
+}
+
+void benchmark_staggered_velocity()
+{
+    int const N_calls = 5;
+    float const dt = 0.2f;
+
+    std::cout<<std::endl<<"Collocated vs staggered velocity - "<<parallel_thread_count()<<" threads"<<std::endl;
+    std::cout<<std::setw(8)<<"N"<<std::setw(14)<<"velocity"<<std::setw(20)<<"self-advect (ms)"<<std::setw(22)<<"density advect (ms)"<<std::setw(22)<<"divergence after"<<std::endl;
+    for(int N : {128, 256, 512, 1024})
+    {
+        grid_2D<vec2> velocity_reference;
+        initialize_velocity_benchmark(velocity_reference, N);
+        grid_2D<vec3> density_reference(N, N), density(N, N);
+        for(int y=0; y<N; ++y)
+            for(int x=0; x<N; ++x)
+                density_reference(x,y) = ((x*8/N+y*8/N)%2==0) ? vec3(1,0,0) : vec3(0,0,1);
+
+        // Collocated
+        {
+            grid_2D<vec2> velocity = velocity_reference, velocity_previous = velocity_reference;
+            float t_velocity = 0.0f, t_density = 0.0f;
+            for(int k=0; k<N_calls; ++k) {
+                auto const t0 = std::chrono::steady_clock::now();
+                advect(velocity, velocity_previous, velocity_previous, dt);
+                auto const t1 = std::chrono::steady_clock::now();
+                advect(density, density_reference, velocity_previous, dt);
+                auto const t2 = std::chrono::steady_clock::now();
+                t_velocity += std::chrono::duration<float, std::milli>(t1-t0).count();
+                t_density += std::chrono::duration<float, std::milli>(t2-t1).count();
+            }
+
+            pressure_solver solver;
+            grid_2D<float> divergence(N, N), gradient_field(N, N);
+            divergence_free(velocity, velocity_reference, divergence, gradient_field, solver);
+            float const divergence_after = divergence_norm(velocity)/divergence_norm(velocity_reference);
+            std::cout<<std::setw(8)<<N<<std::setw(14)<<"collocated"<<std::setw(20)<<t_velocity/N_calls<<std::setw(22)<<t_density/N_calls<<std::setw(22)<<divergence_after<<std::endl;
+        }
+
+        // Staggered
+        {
+            velocity_mac velocity_previous;
+            velocity_previous.resize(N);
+            velocity_previous.add_collocated(velocity_reference);
+            velocity_mac velocity = velocity_previous;
+            float t_velocity = 0.0f, t_density = 0.0f;
+            for(int k=0; k<N_calls; ++k) {
+                auto const t0 = std::chrono::steady_clock::now();
+                advect(velocity, velocity_previous, dt);
+                auto const t1 = std::chrono::steady_clock::now();
+                advect(density, density_reference, velocity_previous, dt);
+                auto const t2 = std::chrono::steady_clock::now();
+                t_velocity += std::chrono::duration<float, std::milli>(t1-t0).count();
+                t_density += std::chrono::duration<float, std::milli>(t2-t1).count();
+            }
+
+            pressure_solver solver;
+            grid_2D<float> divergence(N, N), gradient_field(N, N);
+            velocity = velocity_previous;
+            float const divergence_before = divergence_norm(velocity);
+            divergence_free(velocity, divergence, gradient_field, solver);
+            float const divergence_after = divergence_norm(velocity)/divergence_before;
+            std::cout<<std::setw(8)<<N<<std::setw(14)<<"staggered"<<std::setw(20)<<t_velocity/N_calls<<std::setw(22)<<t_density/N_calls<<std::setw(22)<<divergence_after<<std::endl;
+        }
+    }
+}
+
+void benchmark_double_buffer()
+{
+    int const N_frames = 5;
+    float const dt = 0.2f, mu_velocity = 0.001f, mu_density = 0.005f;
+
+    std::cout<<std::endl<<"Simulation step - copies vs double buffer, "<<N_frames<<" frames"<<std::endl;
+    std::cout<<std::setw(8)<<"N"<<std::setw(18)<<"copies (ms)"<<std::setw(22)<<"double buffer (ms)"<<std::setw(18)<<"max difference"<<std::endl;
+    for(int N : {128, 256, 512, 1024})
+    {
+        grid_2D<vec2> velocity_initial;
+        initialize_velocity_benchmark(velocity_initial, N);
+        grid_2D<vec3> density_initial(N, N);
+        for(int y=0; y<N; ++y)
+            for(int x=0; x<N; ++x)
+                density_initial(x,y) = ((x*8/N+y*8/N)%2==0) ? vec3(1,0,0) : vec3(0,0,1);
+
+        // Step of the scene before the double buffer: a copy of the field before each stage
+        grid_2D<vec2> velocity = velocity_initial, velocity_previous;
+        grid_2D<vec3> density = density_initial, density_previous;
+        grid_2D<float> divergence(N, N), gradient_field(N, N);
+        pressure_solver solver;
+        auto const t0 = std::chrono::steady_clock::now();
+        for(int k_frame=0; k_frame<N_frames; ++k_frame) {
+            velocity_previous = velocity;
+            density_previous = density;
+            diffuse(velocity, velocity_previous, mu_velocity, dt, reflective); velocity_previous = velocity;
+            divergence_free(velocity, velocity_previous, divergence, gradient_field, solver); velocity_previous = velocity;
+            advect(velocity, velocity_previous, velocity_previous, dt);
+            diffuse(density, density_previous, mu_density, dt, copy); density_previous = density;
+            advect(density, density_previous, velocity, dt);
+        }
+        auto const t1 = std::chrono::steady_clock::now();
+
+        double_buffer<grid_2D<vec2>> velocity_buffer;
+        double_buffer<grid_2D<vec3>> density_buffer;
+        velocity_buffer.current() = velocity_initial; velocity_buffer.synchronize();
+        density_buffer.current() = density_initial; density_buffer.synchronize();
+        grid_2D<float> divergence_buffer(N, N), gradient_field_buffer(N, N);
+        pressure_solver solver_buffer;
+        auto const t2 = std::chrono::steady_clock::now();
+        for(int k_frame=0; k_frame<N_frames; ++k_frame) {
+            diffuse(velocity_buffer, mu_velocity, dt, reflective);
+            divergence_free(velocity_buffer, divergence_buffer, gradient_field_buffer, solver_buffer);
+            advect(velocity_buffer, dt);
+            diffuse(density_buffer, mu_density, dt, copy);
+            advect(density_buffer, velocity_buffer.current(), dt);
+        }
+        auto const t3 = std::chrono::steady_clock::now();
+
+        float difference = 0.0f;
+        for(size_t k=0; k<density.size(); ++k)
+            difference = std::max(difference, norm(density[k]-density_buffer.current()[k]));
+        for(size_t k=0; k<velocity.size(); ++k)
+            difference = std::max(difference, norm(velocity[k]-velocity_buffer.current()[k]));
+
+        float const t_copies = std::chrono::duration<float, std::milli>(t1-t0).count()/N_frames;
+        float const t_buffer = std::chrono::duration<float, std::milli>(t3-t2).count()/N_frames;
+        std::cout<<std::setw(8)<<N<<std::setw(18)<<t_copies<<std::setw(22)<<t_buffer<<std::setw(18)<<difference<<std::endl;
+    }
+}
+
+void benchmark_smoke_3D()
+{
+    int const N_steps = 60;
+    float const dt = 0.2f;
+
+    std::cout<<std::endl<<"3D smoke on sparse tiles ("<<sparse_grid_3D<float>::tile_size<<"^3 cells) - "<<parallel_thread_count()<<" threads"<<std::endl;
+    std::cout<<std::setw(8)<<"N"<<std::setw(8)<<"step"<<std::setw(14)<<"step (ms)"<<std::setw(14)<<"tiles"<<std::setw(16)<<"memory (MB)"<<std::setw(20)<<"dense grids (MB)"<<std::endl;
+    for(int N : {64, 128, 256})
+    {
+        smoke_3D smoke;
+        smoke.initialize(N);
+        // Same fields stored as dense grids: velocity and density (double-buffered), pressure and divergence
+        double const dense = double(N)*N*N*(2*sizeof(vec3)+4*sizeof(float))/(1024.0*1024.0);
+
+        float t = 0.0f;
+        for(int k_step=1; k_step<=N_steps; ++k_step) {
+            auto const t0 = std::chrono::steady_clock::now();
+            smoke.simulate(dt);
+            auto const t1 = std::chrono::steady_clock::now();
+            t += std::chrono::duration<float, std::milli>(t1-t0).count();
+            if(k_step%20==0) {
+                std::cout<<std::setw(8)<<N<<std::setw(8)<<k_step<<std::setw(14)<<t/20<<std::setw(14)<<smoke.active_tiles().size()<<std::setw(16)<<smoke.memory()/(1024.0*1024.0)<<std::setw(20)<<dense<<std::endl;
+                t = 0.0f;
+            }
+        }
+    }
+}
+
+// Central divergence with periodic wrap
+static float divergence_norm_periodic(grid_2D<vec2> const& velocity)
+{
+    int const N = int(velocity.dimension.x);
+    double sum = 0.0;
+    for(int y=0; y<N; ++y) {
+        for(int x=0; x<N; ++x) {
+            float const d = 0.5f*(velocity((x+1)%N,y).x-velocity((x+N-1)%N,y).x + velocity(x,(y+1)%N).y-velocity(x,(y+N-1)%N).y);
+            sum += d*d;
+        }
+    }
+    return float(std::sqrt(sum));
+}
+
+void benchmark_spectral()
+{
+    int const N_frames = 5;
+    float const dt = 0.2f, mu_velocity = 0.001f, mu_density = 0.005f;
+
+    std::cout<<std::endl<<"Spectral (periodic) vs relaxation solvers - "<<N_frames<<" frames, "<<parallel_thread_count()<<" threads"<<std::endl;
+    std::cout<<std::setw(8)<<"N"<<std::setw(24)<<"solver"<<std::setw(26)<<"diffuse+project (ms)"<<std::setw(14)<<"step (ms)"<<std::setw(20)<<"divergence after"<<std::endl;
+    for(int N : {128, 256, 512, 1024})
+    {
+        grid_2D<vec2> velocity_initial;
+        initialize_velocity_benchmark(velocity_initial, N);
+        grid_2D<vec3> density_initial(N, N);
+        for(int y=0; y<N; ++y)
+            for(int x=0; x<N; ++x)
+                density_initial(x,y) = ((x*8/N+y*8/N)%2==0) ? vec3(1,0,0) : vec3(0,0,1);
+
+        // Scene step with walls: Gauss-Seidel diffusion, relaxation or multigrid pressure
+        for(pressure_solver_type type : {pressure_relaxation, pressure_multigrid})
+        {
+            pressure_solver solver;
+            solver.type = type;
+            solver.relaxation.type = relaxation_gauss_seidel;
+            relaxation_parameters relaxation;
+            relaxation.type = relaxation_gauss_seidel;
+            double_buffer<grid_2D<vec2>> velocity;
+            double_buffer<grid_2D<vec3>> density;
+            velocity.current() = velocity_initial; velocity.synchronize();
+            density.current() = density_initial; density.synchronize();
+            grid_2D<float> divergence(N, N), gradient_field(N, N);
+
+            float t_projection = 0.0f, t_step = 0.0f, divergence_after = 0.0f;
+            for(int k_frame=0; k_frame<N_frames; ++k_frame) {
+                auto const t0 = std::chrono::steady_clock::now();
+                diffuse(velocity, mu_velocity, dt, reflective, relaxation);
+                auto const t1 = std::chrono::steady_clock::now();
+                float const divergence_before = divergence_norm(velocity.current());
+                auto const t2 = std::chrono::steady_clock::now();
+                divergence_free(velocity, divergence, gradient_field, solver);
+                auto const t3 = std::chrono::steady_clock::now();
+                divergence_after += divergence_norm(velocity.current())/divergence_before;
+                auto const t4 = std::chrono::steady_clock::now();
+                advect(velocity, dt);
+                diffuse(density, mu_density, dt, copy, relaxation);
+                advect(density, velocity.current(), dt);
+                auto const t5 = std::chrono::steady_clock::now();
+                t_projection += std::chrono::duration<float, std::milli>((t1-t0)+(t3-t2)).count();
+                t_step += std::chrono::duration<float, std::milli>((t1-t0)+(t3-t2)+(t5-t4)).count();
+            }
+            std::string const name = type==pressure_relaxation ? "Gauss-Seidel ("+str(solver.relaxation.iterations)+")" : "multigrid";
+            std::cout<<std::setw(8)<<N<<std::setw(24)<<name<<std::setw(26)<<t_projection/N_frames<<std::setw(14)<<t_step/N_frames<<std::setw(20)<<divergence_after/N_frames<<std::endl;
+        }
+
+        // Periodic domain: diffusion and projection of the velocity in the same transforms
+        {
+            spectral_solver spectral;
+            double_buffer<grid_2D<vec2>> velocity;
+            double_buffer<grid_2D<vec3>> density;
+            velocity.current() = velocity_initial; velocity.synchronize();
+            density.current() = density_initial; density.synchronize();
+
+            float t_projection = 0.0f, t_step = 0.0f, divergence_after = 0.0f;
+            for(int k_frame=0; k_frame<N_frames; ++k_frame) {
+                float const divergence_before = divergence_norm_periodic(velocity.current());
+                auto const t0 = std::chrono::steady_clock::now();
+                divergence_free(velocity.current(), spectral, mu_velocity, dt);
+                auto const t1 = std::chrono::steady_clock::now();
+                divergence_after += divergence_norm_periodic(velocity.current())/divergence_before;
+                auto const t2 = std::chrono::steady_clock::now();
+                advect_periodic(velocity, dt);
+                diffuse(density.current(), mu_density, dt, spectral);
+                advect_periodic(density, velocity.current(), dt);
+                auto const t3 = std::chrono::steady_clock::now();
+                t_projection += std::chrono::duration<float, std::milli>(t1-t0).count();
+                t_step += std::chrono::duration<float, std::milli>((t1-t0)+(t3-t2)).count();
+            }
+            std::cout<<std::setw(8)<<N<<std::setw(24)<<"spectral (FFT)"<<std::setw(26)<<t_projection/N_frames<<std::setw(14)<<t_step/N_frames<<std::setw(20)<<divergence_after/N_frames<<std::endl;
+        }
+    }
+}
+
+// Slotted disk (Zalesak) of radius 0.15 centered at (0.5,0.75) in the unit domain
+static void initialize_density_slotted_disk(grid_2D<vec3>& density, int N)
+{
+    density.resize(N, N);
+    for(int y=0; y<N; ++y) {
+        for(int x=0; x<N; ++x) {
+            float const u = x/(N-1.0f), v = y/(N-1.0f);
+            bool const disk = (u-0.5f)*(u-0.5f)+(v-0.75f)*(v-0.75f) < 0.15f*0.15f;
+            bool const slot = std::abs(u-0.5f)<0.025f && v<0.85f;
+            density(x,y) = (disk && !slot) ? vec3(1.0f,0.5f,0.2f) : vec3(0,0,0);
+        }
+    }
+}
+
+// Sum of |grad(f)| over the cells (forward differences)
+static double total_variation(grid_2D<vec3> const& density)
+{
+    int const N = int(density.dimension.x);
+    double sum = 0.0;
+    for(int y=0; y<N-1; ++y)
+        for(int x=0; x<N-1; ++x)
+            sum += norm(density(x+1,y)-density(x,y)) + norm(density(x,y+1)-density(x,y));
+    return sum;
+}
+
+static std::string advection_name(advection_type type)
+{
+    char const* name[] = {"semi-Lagrangian", "MacCormack", "BFECC"};
+    return name[type];
+}
+
+void benchmark_advection()
+{
+    int const N_steps = 200; // One revolution
+    float const dt = 0.2f;
+    float const omega = 2*3.14159265f/(N_steps*dt);
+
+    std::cout<<std::endl<<"Advection schemes - rotation of a slotted disk ("<<N_steps<<" steps), "<<parallel_thread_count()<<" threads"<<std::endl;
+    std::cout<<std::setw(8)<<"N"<<std::setw(18)<<"scheme"<<std::setw(16)<<"density (ms)"<<std::setw(16)<<"velocity (ms)"<<std::setw(14)<<"L1 error"<<std::setw(18)<<"variation kept"<<std::endl;
+    for(int N : {128, 256, 512})
+    {
+        // Rigid rotation around the center of the domain (cells/s), inside a disk so that the back-traced positions stay in the grid
+        grid_2D<vec2> rotation(N, N);
+        float const c = (N-1)/2.0f;
+        for(int y=0; y<N; ++y)
+            for(int x=0; x<N; ++x)
+                rotation(x,y) = norm(vec2(x-c, y-c))<0.45f*N ? omega*vec2(-(y-c), x-c) : vec2(0,0);
+
+        grid_2D<vec3> density_initial;
+        initialize_density_slotted_disk(density_initial, N);
+        double const variation_initial = total_variation(density_initial);
+        double mass_initial = 0.0;
+        for(size_t k=0; k<density_initial.size(); ++k)
+            mass_initial += norm(density_initial[k]);
+
+        grid_2D<vec2> velocity_initial;
+        initialize_velocity_benchmark(velocity_initial, N);
+
+        for(advection_type type : {advection_semi_lagrangian, advection_maccormack, advection_bfecc})
+        {
+            double_buffer<grid_2D<vec3>> density;
+            density.current() = density_initial; density.synchronize();
+            advection_workspace<vec3> workspace_density;
+            float t_density = 0.0f;
+            for(int k_step=0; k_step<N_steps; ++k_step) {
+                auto const t0 = std::chrono::steady_clock::now();
+                advect(density, rotation, dt, type, workspace_density);
+                auto const t1 = std::chrono::steady_clock::now();
+                t_density += std::chrono::duration<float, std::milli>(t1-t0).count();
+            }
+
+            double error = 0.0;
+            for(size_t k=0; k<density_initial.size(); ++k)
+                error += norm(density.current()[k]-density_initial[k]);
+            float const variation = float(total_variation(density.current())/variation_initial);
+
+            // Self-advection of the velocity (a few calls)
+            int const N_calls = 5;
+            double_buffer<grid_2D<vec2>> velocity;
+            velocity.current() = velocity_initial; velocity.synchronize();
+            advection_workspace<vec2> workspace_velocity;
+            auto const t2 = std::chrono::steady_clock::now();
+            for(int k=0; k<N_calls; ++k)
+                advect(velocity, dt, type, workspace_velocity);
+            auto const t3 = std::chrono::steady_clock::now();
+            float const t_velocity = std::chrono::duration<float, std::milli>(t3-t2).count()/N_calls;
+
+            std::cout<<std::setw(8)<<N<<std::setw(18)<<advection_name(type)<<std::setw(16)<<t_density/N_steps<<std::setw(16)<<t_velocity<<std::setw(14)<<error/mass_initial<<std::setw(18)<<variation<<std::endl;
+        }
+    }
+}
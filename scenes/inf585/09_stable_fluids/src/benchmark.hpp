@@ -0,0 +1,39 @@
+#pragma once
+
+#include "simulation.hpp"
+#include "smoke_3D.hpp"
+#include "spectral.hpp"
+
+
+// Compare the relaxations (Gauss-Seidel, red-black, Jacobi), the multigrid and the conjugate gradient pressure solvers on grids of 128^2 to 1024^2 cells
+//  Called when the program is run as: ./09_stable_fluids benchmark
+//  The velocity is projected and advected over a few frames (the pressure of a frame is the initial guess of the next one),
+//  reports the iterations, the relative residual of the Poisson equation and the time of divergence_free per frame
+void benchmark_pressure_solver();
+
+// Cost of diffuse on vec2 and vec3 fields of 128^2 to 1024^2 cells for the three orderings of the relaxation
+//  Reports the time of a call and the reduction of the residual of the implicit diffusion by the sweeps
+void benchmark_diffusion();
+
+// Collocated (grid_2D<vec2>) against staggered (velocity_mac) velocity on grids of 128^2 to 1024^2 cells
+//  Reports the time of the self-advection of the velocity, of the advection of a vec3 density,
+//  and the divergence left by divergence_free relative to the initial one (multigrid solver, tolerance 1e-3)
+void benchmark_staggered_velocity();
+
+// Time of a full step (diffusion, projection and advection of the velocity, diffusion and advection of the density) on grids of 128^2 to 1024^2 cells
+//  with copies of the fields before each stage (field_previous = field) against double-buffered fields, and the largest difference of the results
+void benchmark_double_buffer();
+
+// 3D smoke plume on sparse tiles in domains of 64^3 to 256^3 cells
+//  Reports the time of a step, the number of active tiles and the memory of the fields against dense grids, along the simulation
+void benchmark_smoke_3D();
+
+// Spectral solver on a periodic domain against the Gauss-Seidel relaxations (and the multigrid) on grids of 128^2 to 1024^2 cells
+//  Reports the time of the diffusion and projection of the velocity, of a full step, and the divergence left relative to the initial one
+void benchmark_spectral();
+
+// Semi-Lagrangian, MacCormack and BFECC advections on grids of 128^2 to 512^2 cells
+//  A slotted disk of density is rotated by one revolution: reports the time of an advection of the vec3 density and of the vec2
+//  velocity, the error to the initial density and the total variation kept (sharpness of the edges) - compare a scheme at N with
+//  the semi-Lagrangian advection at 2N
+void benchmark_advection();
@@ -8,6 +8,8 @@ enum boundary_condition { copy, reflective };
 template <typename T> void set_boundary_corners(vcl::grid_2D<T>& grid);
 template <typename T> void set_boundary(vcl::grid_2D<T>& grid);
 template <typename T> void set_boundary_reflective(vcl::grid_2D<T>& grid);
+// Copy the boundary cells (first/last rows and columns) of grid_source
+template <typename T> void copy_boundary(vcl::grid_2D<T>& grid, vcl::grid_2D<T> const& grid_source);
 
 
 
@@ -65,3 +67,20 @@ void set_boundary_reflective(vcl::grid_2D<T>& grid)
 
 }
 
+
+template <typename T>
+void copy_boundary(vcl::grid_2D<T>& grid, vcl::grid_2D<T> const& grid_source)
+{
+    int const Nx = int(grid.dimension[0]);
+    int const Ny = int(grid.dimension[1]);
+
+    for(int x=0; x<Nx; ++x) {
+        grid(x,0)    = grid_source(x,0);
+        grid(x,Ny-1) = grid_source(x,Ny-1);
+    }
+
+    for(int y=1; y<Ny-1; ++y) {
+        grid(0,y)    = grid_source(0,y);
+        grid(Nx-1,y) = grid_source(Nx-1,y);
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "vcl/vcl.hpp"
+
+
+// Two storages of a field (grid_2D<T>, velocity_mac): the current value and the value before the last step
+//  A step calls swap() - O(1), the current value becomes the previous one - then writes the new current value from previous(),
+//  instead of copying the whole field (field_previous = field) before each step.
+//  After a swap, current() holds outdated values: a step must overwrite all of its cells (or start from previous()).
+template <typename FIELD>
+struct double_buffer
+{
+    FIELD& current() { return buffers[index]; }
+    FIELD const& current() const { return buffers[index]; }
+    FIELD& previous() { return buffers[1-index]; }
+    FIELD const& previous() const { return buffers[1-index]; }
+
+    void swap() { index = 1-index; }
+    // Copy of the current value in the previous storage (initialization of the field)
+    void synchronize() { buffers[1-index] = buffers[index]; }
+
+private:
+    FIELD buffers[2];
+    int index = 0;
+};
@@ -0,0 +1,157 @@
+#include "fft.hpp"
+
+using namespace vcl;
+
+using complex = std::complex<float>;
+
+
+bool is_power_of_two(int n)
+{
+    return n>0 && (n&(n-1))==0;
+}
+
+void fft_1D::resize(int n_arg)
+{
+    assert_vcl(is_power_of_two(n_arg), "FFT of a size that is not a power of two");
+    if(n==n_arg)
+        return;
+    n = n_arg;
+
+    int bits = 0;
+    while((1<<bits)<n)
+        ++bits;
+    bit_reverse.resize(n);
+    for(int k=0; k<n; ++k) {
+        int r = 0;
+        for(int b=0; b<bits; ++b)
+            r |= ((k>>b)&1) << (bits-1-b);
+        bit_reverse[k] = r;
+    }
+
+    twiddles.resize(std::max(n/2,1));
+    for(int k=0; k<n/2; ++k) {
+        double const angle = -2*3.14159265358979323846*k/n;
+        twiddles[k] = complex(float(std::cos(angle)), float(std::sin(angle)));
+    }
+}
+
+void fft_1D::transform(complex* data, bool inverse) const
+{
+    for(int k=0; k<n; ++k)
+        if(k<bit_reverse[k])
+            std::swap(data[k], data[bit_reverse[k]]);
+
+    // Butterflies of the sub-transforms of length 2, 4, ..., n
+    for(int length=2; length<=n; length*=2) {
+        int const half = length/2;
+        int const step = n/length;
+        for(int start=0; start<n; start+=length) {
+            for(int k=0; k<half; ++k) {
+                complex const w = inverse ? std::conj(twiddles[k*step]) : twiddles[k*step];
+                complex const a = data[start+k];
+                complex const b = w*data[start+k+half];
+                data[start+k] = a+b;
+                data[start+k+half] = a-b;
+            }
+        }
+    }
+}
+
+
+void fft_2D::resize(int N_arg)
+{
+    assert_vcl(is_power_of_two(N_arg) && N_arg>=4, "Real FFT of a grid size that is not a power of two");
+    if(N==N_arg)
+        return;
+    N = N_arg;
+    fft_rows.resize(N/2);
+    fft_columns.resize(N);
+    twiddles_real.resize(N/2+1);
+    for(int k=0; k<=N/2; ++k) {
+        double const angle = -2*3.14159265358979323846*k/N;
+        twiddles_real[k] = complex(float(std::cos(angle)), float(std::sin(angle)));
+    }
+}
+
+void fft_2D::forward(grid_2D<float> const& value, grid_2D<complex>& spectrum)
+{
+    int const H = N/2;
+    if(int(spectrum.dimension.x)!=H+1 || int(spectrum.dimension.y)!=N)
+        spectrum.resize(H+1, N);
+
+    // Rows: z[m] = x[2m] + i x[2m+1], Z = FFT(z), then X[k] = E[k] + exp(-2 i pi k/N) O[k] with
+    //  E[k] = (Z[k] + conj(Z[H-k]))/2 (transform of the even samples), O[k] = (Z[k] - conj(Z[H-k]))/(2i) (odd samples)
+    #pragma omp parallel
+    {
+        std::vector<complex> z(H);
+        #pragma omp for
+        for(int y=0; y<N; ++y) {
+            for(int m=0; m<H; ++m)
+                z[m] = complex(value(2*m,y), value(2*m+1,y));
+            fft_rows.forward(z.data());
+            for(int k=0; k<=H; ++k) {
+                complex const a = z[k%H];
+                complex const b = std::conj(z[(H-k)%H]);
+                complex const even = 0.5f*(a+b);
+                complex const odd = complex(0.0f,-0.5f)*(a-b);
+                spectrum(k,y) = even + twiddles_real[k]*odd;
+            }
+        }
+    }
+
+    // Columns
+    #pragma omp parallel
+    {
+        std::vector<complex> column(N);
+        #pragma omp for
+        for(int kx=0; kx<=H; ++kx) {
+            for(int y=0; y<N; ++y)
+                column[y] = spectrum(kx,y);
+            fft_columns.forward(column.data());
+            for(int ky=0; ky<N; ++ky)
+                spectrum(kx,ky) = column[ky];
+        }
+    }
+}
+
+void fft_2D::inverse(grid_2D<complex>& spectrum, grid_2D<float>& value)
+{
+    int const H = N/2;
+    if(int(value.dimension.x)!=N || int(value.dimension.y)!=N)
+        value.resize(N, N);
+
+    // Columns (normalization 1/N)
+    #pragma omp parallel
+    {
+        std::vector<complex> column(N);
+        #pragma omp for
+        for(int kx=0; kx<=H; ++kx) {
+            for(int ky=0; ky<N; ++ky)
+                column[ky] = spectrum(kx,ky);
+            fft_columns.inverse_unnormalized(column.data());
+            for(int y=0; y<N; ++y)
+                spectrum(kx,y) = column[y]/float(N);
+        }
+    }
+
+    // Rows: recombine Z[k] = E[k] + i O[k] from the half spectrum, inverse transform of size H (normalization 1/H)
+    #pragma omp parallel
+    {
+        std::vector<complex> z(H);
+        #pragma omp for
+        for(int y=0; y<N; ++y) {
+            for(int k=0; k<H; ++k) {
+                complex const a = spectrum(k,y);
+                complex const b = std::conj(spectrum(H-k,y));
+                complex const even = 0.5f*(a+b);
+                complex const odd = 0.5f*(a-b)*std::conj(twiddles_real[k]);
+                z[k] = even + complex(0.0f,1.0f)*odd;
+            }
+            fft_rows.inverse_unnormalized(z.data());
+            for(int m=0; m<H; ++m) {
+                value(2*m,y)   = z[m].real()/H;
+                value(2*m+1,y) = z[m].imag()/H;
+            }
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "vcl/vcl.hpp"
+
+#include <complex>
+#include <vector>
+
+
+// Fast Fourier transforms of power-of-two sizes (iterative radix-2, no external library)
+//  Forward transform: X[k] = sum_x x[x] exp(-2 i pi k x / n) - the inverse transforms are normalized (inverse(forward(x)) = x)
+
+// Complex transform of n values (in place)
+struct fft_1D
+{
+    // Precompute the bit reversal permutation and the twiddle factors (nothing is done if n is unchanged)
+    void resize(int n);
+    void forward(std::complex<float>* data) const { transform(data, false); }
+    // Unnormalized inverse (the result is n times the inverse transform)
+    void inverse_unnormalized(std::complex<float>* data) const { transform(data, true); }
+    int size() const { return n; }
+
+private:
+    int n = 0;
+    std::vector<int> bit_reverse;
+    std::vector<std::complex<float>> twiddles; // exp(-2 i pi k / n), k<n/2
+
+    void transform(std::complex<float>* data, bool inverse) const;
+};
+
+// Real-to-complex transform of N x N grids (periodic)
+//  The spectrum of a real grid is Hermitian: only the (N/2+1) x N coefficients kx<=N/2 are stored, spectrum(kx,ky).
+//  Rows: a real row of N values is transformed as N/2 complex values (even and odd samples), then separated.
+//  Columns: complex transforms of the N/2+1 columns.
+struct fft_2D
+{
+    void resize(int N);
+    void forward(vcl::grid_2D<float> const& value, vcl::grid_2D<std::complex<float>>& spectrum);
+    // The spectrum is used as a working buffer
+    void inverse(vcl::grid_2D<std::complex<float>>& spectrum, vcl::grid_2D<float>& value);
+    int size() const { return N; }
+
+private:
+    int N = 0;
+    fft_1D fft_rows;    // N/2 complex values per row
+    fft_1D fft_columns; // N values per column
+    std::vector<std::complex<float>> twiddles_real; // exp(-2 i pi k / N), k<=N/2
+};
+
+bool is_power_of_two(int n);
@@ -49,7 +49,7 @@ void update_velocity_visual(segments_drawable& velocity_visual, buffer<vec3>& ve
 {
 	int const N = int(velocity.dimension.x);
 	float const dL = 2.0f/(N-1.0f);
-	float const lambda = 0.01f * scale;
+	float const lambda = 0.01f * scale * 59.0f/(N-1.0f); // The velocity in cells/s grows with the resolution
 
 	for(int kx=0; kx<N; ++kx){
 		for(int ky=0; ky<N; ++ky){
@@ -83,6 +83,21 @@ void density_to_velocity_curl(grid_2D<vec3>& density, grid_2D<vec2> const& veloc
 	}
 }
 
+// Smoke seen from the front: transmittance of the light through the density integrated along z
+void density_to_smoke_3D(grid_2D<vec3>& density, smoke_3D const& smoke)
+{
+	static grid_2D<float> density_xy;
+	smoke.project_density(density_xy);
+	int const N = smoke.size();
+	density.resize(N,N);
+	for(int ky=0; ky<N; ++ky) {
+		for(int kx=0; kx<N; ++kx) {
+			float const transmittance = std::exp(-20.0f*density_xy(kx,ky)/N);
+			density(kx,ky) = vec3{0.2f,0.2f,0.3f} + transmittance*vec3{0.8f,0.8f,0.7f};
+		}
+	}
+}
+
 void mouse_velocity_to_grid(grid_2D<vec2>& velocity, vec2 const& mouse_velocity, mat4 const& P_inv, vec2 const& p_mouse)
 {
     size_t const N = velocity.dimension.x;
@@ -93,9 +108,13 @@ void mouse_velocity_to_grid(grid_2D<vec2>& velocity, vec2 const& mouse_velocity,
 	vec2 const p1 = vec2( 1+L/2, 1+L/2);
 	int const x = std::floor( N*(picked.x-p0.x)/(p1.x-p0.x) );
 	int const y = std::floor( N*(picked.y-p0.y)/(p1.y-p0.y) );
-	for (int dx = -5; dx < 5; ++dx)
+
+	// The brush and the velocity (in cells/s) follow the resolution: same motion as on the default 60x60 grid
+	int const r = std::max(5, int(0.1f/L));
+	float const velocity_scale = (N-1.0f)/59.0f;
+	for (int dx = -r; dx < r; ++dx)
 	{
-		for (int dy = -5; dy < 5; ++dy)
+		for (int dy = -r; dy < r; ++dy)
 		{
 			int const xc = x+dx;
 			int const yc = y+dy;
@@ -105,7 +124,7 @@ void mouse_velocity_to_grid(grid_2D<vec2>& velocity, vec2 const& mouse_velocity,
 				float const dist = norm(picked-vec2{-1-L/2+xc*L, -1-L/2+yc*L});
 				float const weight = exp(-(dist*dist)/(0.05f*0.05f));
 
-				velocity(xc,yc) += 5.0f * weight * mouse_velocity;
+				velocity(xc,yc) += 5.0f * velocity_scale * weight * mouse_velocity;
 			}
 		}
 	}
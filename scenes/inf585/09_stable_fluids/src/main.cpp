@@ -2,7 +2,9 @@
 #include <iostream>
 
 #include "simulation.hpp"
+#include "spectral.hpp"
 #include "helper.hpp"
+#include "benchmark.hpp"
 
 using namespace vcl;
 
@@ -13,6 +15,11 @@ struct gui_parameters {
 	float diffusion_density = 0.005f;
 	float velocity_scaling = 1.0f;
 	density_type_structure density_type = density_color;
+	int grid_size = 60;
+	relaxation_parameters diffusion_relaxation; // Ordering and number of the sweeps of the diffusion
+	advection_type advection = advection_semi_lagrangian; // Scheme of the density and of the collocated velocity
+	bool staggered_velocity = false; // Simulate the velocity on a MAC grid (velocity is then only used for the display)
+	bool periodic_spectral = false;  // Periodic domain solved in Fourier space (the grid size is rounded to a power of two)
 };
 
 struct user_interaction_parameters {
@@ -41,14 +48,25 @@ void window_size_callback(GLFWwindow* window, int width, int height);
 void initialize_data();
 void display_scene();
 void display_interface();
+void display_relaxation_interface(relaxation_parameters& relaxation, std::string const& label);
 void simulate(float dt);
+void initialize_visuals();
+bool round_grid_size_periodic();
 
 timer_basic timer;
 
-grid_2D<vec3> density, density_previous;
-grid_2D<vec2> velocity, velocity_previous;
+// Double-buffered fields: each step of the simulation swaps the storages instead of copying the field
+double_buffer<grid_2D<vec3>> density;
+double_buffer<grid_2D<vec2>> velocity;
 grid_2D<float> divergence;
 grid_2D<float> gradient_field;
+pressure_solver pressure;
+advection_workspace<vec3> advection_density;  // Working grids of the compensated advections
+advection_workspace<vec2> advection_velocity;
+double_buffer<velocity_mac> velocity_staggered;
+grid_2D<vec2> velocity_impulse; // Mouse velocity added to the staggered grid
+smoke_3D smoke; // 3D simulation displayed in the view_smoke_3D mode
+spectral_solver spectral; // FFT and spectra of the periodic domain
 
 mesh_drawable density_visual;
 segments_drawable grid_visual;
@@ -58,10 +76,22 @@ velocity_tracker velocity_track;
 
 
 
-int main(int, char* argv[])
+int main(int argc, char* argv[])
 {
 	std::cout << "Run " << argv[0] << std::endl;
 
+	// Run the timing of the solvers without display: ./09_stable_fluids benchmark
+	if(argc>1 && std::string(argv[1])=="benchmark") {
+		benchmark_pressure_solver();
+		benchmark_diffusion();
+		benchmark_staggered_velocity();
+		benchmark_double_buffer();
+		benchmark_smoke_3D();
+		benchmark_spectral();
+		benchmark_advection();
+		return 0;
+	}
+
 	int const width = 1280, height = 1024;
 	GLFWwindow* window = create_window(width, height);
 	window_size_callback(window, width, height);
@@ -100,8 +130,8 @@ int main(int, char* argv[])
 
 		float const dt = 0.2f * timer.scale;
 		simulate(dt);
-		opengl_update_texture_gpu(density_visual.texture, density);
-		update_velocity_visual(velocity_visual, velocity_grid_data, velocity, user.gui.velocity_scaling);
+		opengl_update_texture_gpu(density_visual.texture, density.current());
+		update_velocity_visual(velocity_visual, velocity_grid_data, velocity.current(), user.gui.velocity_scaling);
 		
 		display_interface();
 		display_scene();
@@ -121,47 +151,90 @@ int main(int, char* argv[])
 
 void simulate(float dt)
 {
+	// 3D smoke plume: display of the density integrated along z and of the velocity of the middle slice
+	if(user.gui.density_type==view_smoke_3D) {
+		smoke.simulate(dt);
+		density_to_smoke_3D(density.current(), smoke);
+		smoke.slice_velocity(velocity.current());
+		return;
+	}
+
+	// Each step reads the previous() value of the field and writes its current() value
 
-	velocity_previous = velocity;
-	density_previous = density;
+	// Periodic domain: the diffusion and the projection of the velocity are computed in the same Fourier transforms
+	if(user.gui.periodic_spectral) {
+		divergence_free(velocity.current(), spectral, user.gui.diffusion_velocity, dt); // in place
+		advect_periodic(velocity, dt);
+		if(user.gui.density_type!=view_velocity_curl) {
+			diffuse(density.current(), user.gui.diffusion_density, dt, spectral); // in place
+			advect_periodic(density, velocity.current(), dt);
+		}
+		else
+			density_to_velocity_curl(density.current(), velocity.current());
+		return;
+	}
 
 	// velocity
-	diffuse(velocity, velocity_previous, user.gui.diffusion_velocity, dt, reflective); velocity_previous = velocity;
-	divergence_free(velocity, velocity_previous, divergence, gradient_field); velocity_previous = velocity;
-	advect(velocity, velocity_previous, velocity_previous, dt);
+	if(user.gui.staggered_velocity) {
+		diffuse(velocity_staggered, user.gui.diffusion_velocity, dt, user.gui.diffusion_relaxation);
+		divergence_free(velocity_staggered.current(), divergence, gradient_field, pressure); // in place
+		advect(velocity_staggered, dt);
+		velocity_staggered.current().to_collocated(velocity.current());
+	}
+	else {
+		diffuse(velocity, user.gui.diffusion_velocity, dt, reflective, user.gui.diffusion_relaxation);
+		divergence_free(velocity, divergence, gradient_field, pressure);
+		advect(velocity, dt, user.gui.advection, advection_velocity);
+	}
 
 	// density
 	if(user.gui.density_type!=view_velocity_curl){
-		diffuse(density, density_previous, user.gui.diffusion_density, dt, copy); density_previous = density;
-		advect(density, density_previous, velocity, dt);
+		diffuse(density, user.gui.diffusion_density, dt, copy, user.gui.diffusion_relaxation);
+		if(user.gui.staggered_velocity)
+			advect(density, velocity_staggered.current(), dt, user.gui.advection, advection_density);
+		else
+			advect(density, velocity.current(), dt, user.gui.advection, advection_density);
 	}
 	else // in case you directly look at the velocity curl (no density advection in this case)
-		density_to_velocity_curl(density, velocity);
+		density_to_velocity_curl(density.current(), velocity.current());
 
 }
 
 void initialize_density(density_type_structure density_type, size_t N)
 {
 	if(density_type == density_color) {
-        initialize_density_color(density, N);
+        initialize_density_color(density.current(), N);
 	}
 
     if(density_type == density_texture){
-        convert(image_load_png("assets/texture.png"), density);
+		// Nearest sampling of the image on the grid of the simulation
+		grid_2D<vec3> image;
+		convert(image_load_png("assets/texture.png"), image);
+		density.current().resize(N,N);
+		for(size_t ky=0; ky<N; ++ky)
+			for(size_t kx=0; kx<N; ++kx)
+				density.current()(kx,ky) = image(kx*image.dimension.x/N, ky*image.dimension.y/N);
+	}
+
+	if(density_type == view_smoke_3D) {
+		smoke.initialize(int(N));
+		density.current().resize(N,N); density.current().fill({1,1,1});
 	}
 
 	if(density_type == view_velocity_curl) {
-		density.resize(N,N); density.fill({1,1,1});
+		density.current().resize(N,N); density.current().fill({1,1,1});
 	}
 	
-	density_previous = density;
+	density.synchronize();
 }
 
 
 void initialize_fields(density_type_structure density_type)
 {
-	size_t const N = 60;
-    velocity.resize(N,N); velocity.fill({0,0}); velocity_previous = velocity;
+	size_t const N = user.gui.grid_size;
+    velocity.current().clear(); velocity.current().resize(N,N); velocity.current().fill({0,0}); velocity.synchronize();
+	velocity_staggered.current().resize(int(N)); velocity_staggered.synchronize();
+	velocity_impulse.clear(); velocity_impulse.resize(N,N);
 	initialize_density(density_type, N);
     divergence.clear(); divergence.resize(N,N);
     gradient_field.clear(); gradient_field.resize(N,N);
@@ -184,9 +257,21 @@ void initialize_data()
 	scene.camera.look_at({0,0,1.0f}, {0,0,0}, {0,1,0});
 
 	initialize_fields(user.gui.density_type);
-	size_t const N = velocity.dimension.x;
+	initialize_visuals();
+}
+
+void initialize_visuals()
+{
+	// Release the buffers of the previous resolution
+	if(density_visual.texture!=0 && density_visual.texture!=mesh_drawable::default_texture)
+		glDeleteTextures(1, &density_visual.texture);
+	density_visual.clear();
+	grid_visual.clear();
+	velocity_visual.clear();
+
+	size_t const N = velocity.current().dimension.x;
 	initialize_density_visual(density_visual, N);
-	density_visual.texture = opengl_texture_to_gpu(density);
+	density_visual.texture = opengl_texture_to_gpu(density.current());
 	initialize_grid(grid_visual, N);
 	velocity_grid_data.resize(2*N*N);
 	velocity_visual = segments_drawable(velocity_grid_data);
@@ -204,6 +289,16 @@ void display_scene()
 	if(user.gui.display_velocity)
 		draw(velocity_visual, scene);
 }
+// Ordering and number of sweeps of a relaxation (label: unique identifier of the widgets)
+void display_relaxation_interface(relaxation_parameters& relaxation, std::string const& label)
+{
+	int* ptr_type = reinterpret_cast<int*>(&relaxation.type);
+	ImGui::RadioButton(("Gauss-Seidel##"+label).c_str(), ptr_type, relaxation_gauss_seidel); ImGui::SameLine();
+	ImGui::RadioButton(("Red-black##"+label).c_str(), ptr_type, relaxation_red_black); ImGui::SameLine();
+	ImGui::RadioButton(("Jacobi##"+label).c_str(), ptr_type, relaxation_jacobi);
+	ImGui::SliderInt(("Iterations##"+label).c_str(), &relaxation.iterations, 1, 200);
+}
+
 void display_interface()
 {
 	ImGui::SliderFloat("Timer scale", &timer.scale, 0.01f, 4.0f, "%0.2f");
@@ -216,19 +311,81 @@ void display_interface()
 	bool const cancel_velocity = ImGui::Button("Cancel Velocity"); ImGui::SameLine();
 	bool const restart = ImGui::Button("Restart");
 
+	ImGui::Text("Diffusion:"); ImGui::SameLine();
+	display_relaxation_interface(user.gui.diffusion_relaxation, "diffusion");
+
+	ImGui::Text("Pressure solver:"); ImGui::SameLine();
+	int* ptr_pressure_type = reinterpret_cast<int*>(&pressure.type);
+	ImGui::RadioButton("Relaxation", ptr_pressure_type, pressure_relaxation); ImGui::SameLine();
+	ImGui::RadioButton("Multigrid", ptr_pressure_type, pressure_multigrid); ImGui::SameLine();
+	ImGui::RadioButton("Conjugate gradient", ptr_pressure_type, pressure_conjugate_gradient);
+	if(pressure.type==pressure_relaxation)
+		display_relaxation_interface(pressure.relaxation, "pressure");
+	else
+		ImGui::SliderFloat("Tolerance", &pressure.tolerance, 1e-6f, 1e-1f, "%.1e", 4.0f);
+	ImGui::Text("%d iterations, residual %.1e", pressure.iterations, pressure.residual_relative);
+
+	ImGui::Text("Advection:"); ImGui::SameLine();
+	int* ptr_advection = reinterpret_cast<int*>(&user.gui.advection);
+	ImGui::RadioButton("Semi-Lagrangian", ptr_advection, advection_semi_lagrangian); ImGui::SameLine();
+	ImGui::RadioButton("MacCormack", ptr_advection, advection_maccormack); ImGui::SameLine();
+	ImGui::RadioButton("BFECC", ptr_advection, advection_bfecc);
+
+	// The simulated velocity is transferred when switching between the collocated and the staggered grids
+	if(ImGui::Checkbox("Staggered (MAC) velocity", &user.gui.staggered_velocity) && user.gui.staggered_velocity) {
+		user.gui.periodic_spectral = false;
+		velocity_staggered.current().fill(0.0f);
+		velocity_staggered.current().add_collocated(velocity.current());
+	}
+	ImGui::SameLine();
+	if(ImGui::Checkbox("Periodic (FFT)", &user.gui.periodic_spectral) && user.gui.periodic_spectral) {
+		user.gui.staggered_velocity = false;
+		if(round_grid_size_periodic()) {
+			initialize_fields(user.gui.density_type);
+			initialize_visuals();
+		}
+	}
+
+	ImGui::SliderInt("Grid size", &user.gui.grid_size, 16, 1024);
+	if(ImGui::IsItemDeactivatedAfterEdit()) {
+		round_grid_size_periodic();
+		initialize_fields(user.gui.density_type);
+		initialize_visuals();
+	}
+
 	bool new_density = false;
 	int* ptr_density_type  = reinterpret_cast<int*>(&user.gui.density_type);
 	new_density |= ImGui::RadioButton("Density color", ptr_density_type, density_color); ImGui::SameLine();
 	new_density |= ImGui::RadioButton("Density texture", ptr_density_type, density_texture); ImGui::SameLine();
-	new_density |= ImGui::RadioButton("Velocity Curl", ptr_density_type, view_velocity_curl);
+	new_density |= ImGui::RadioButton("Velocity Curl", ptr_density_type, view_velocity_curl); ImGui::SameLine();
+	new_density |= ImGui::RadioButton("Smoke 3D", ptr_density_type, view_smoke_3D);
+	if(user.gui.density_type==view_smoke_3D)
+		ImGui::Text("%d^3 cells: %d active tiles, %.1f MB", smoke.size(), int(smoke.active_tiles().size()), smoke.memory()/(1024.0f*1024.0f));
 	if (new_density || restart) 
-		initialize_density(user.gui.density_type, velocity.dimension.x);
-	if(cancel_velocity || restart)
-		velocity.fill({0,0});
+		initialize_density(user.gui.density_type, velocity.current().dimension.x);
+	if(cancel_velocity || restart) {
+		velocity.current().fill({0,0});
+		velocity_staggered.current().fill(0.0f);
+	}
 		
 }
 
 
+// The FFT of the periodic domain needs a power-of-two grid size: the closest one is used (returns true if the size is changed)
+bool round_grid_size_periodic()
+{
+	int& N = user.gui.grid_size;
+	if(!user.gui.periodic_spectral || is_power_of_two(N))
+		return false;
+	int N_rounded = 16;
+	while(N_rounded<N)
+		N_rounded *= 2;
+	if(N_rounded-N > N-N_rounded/2 && N_rounded>16)
+		N_rounded /= 2;
+	N = N_rounded;
+	return true;
+}
+
 void window_size_callback(GLFWwindow* , int width, int height)
 {
 	glViewport(0, 0, width, height);
@@ -264,7 +421,13 @@ void mouse_move_callback(GLFWwindow* window, double xpos, double ypos)
 	{
 		if (state.mouse_click_left)	{
 			velocity_track.add(vec3(p1,0.0f), timer.t);
-			mouse_velocity_to_grid(velocity, velocity_track.velocity.xy(), scene.projection_inverse, p1 );
+			if(user.gui.staggered_velocity) {
+				velocity_impulse.fill({0,0});
+				mouse_velocity_to_grid(velocity_impulse, velocity_track.velocity.xy(), scene.projection_inverse, p1 );
+				velocity_staggered.current().add_collocated(velocity_impulse);
+			}
+			else
+				mouse_velocity_to_grid(velocity.current(), velocity_track.velocity.xy(), scene.projection_inverse, p1 );
 		}
 		else
 			velocity_track.set_record(vec3(p1,0.0f), timer.t);
@@ -0,0 +1,324 @@
+#include "pressure_solver.hpp"
+#include "boundary.hpp"
+
+#include <limits>
+
+using namespace vcl;
+
+
+// Subtract the mean value of the interior cells
+static void remove_mean(grid_2D<float>& b)
+{
+    int const N = int(b.dimension.x);
+    double sum = 0.0;
+    for(int y=1; y<N-1; ++y)
+        for(int x=1; x<N-1; ++x)
+            sum += b(x,y);
+    float const mean = float(sum/((N-2.0)*(N-2.0)));
+    for(int y=1; y<N-1; ++y)
+        for(int x=1; x<N-1; ++x)
+            b(x,y) -= mean;
+}
+
+static double norm2_interior(grid_2D<float> const& b)
+{
+    int const N = int(b.dimension.x);
+    double sum = 0.0;
+    for(int y=1; y<N-1; ++y)
+        for(int x=1; x<N-1; ++x)
+            sum += double(b(x,y))*b(x,y);
+    return sum;
+}
+
+// Sweeps of the relaxation on Laplacian(x) = h2 b:  x = (x(i-1,j)+x(i+1,j)+x(i,j-1)+x(i,j+1) - h2 b)/4
+static void relax_poisson(grid_2D<float>& x, grid_2D<float> const& b, float h2, int sweeps, relaxation_parameters const& relaxation)
+{
+    relax(x, b, 0.25f, -0.25f*h2, sweeps, relaxation, [](grid_2D<float>& g) { set_boundary(g); });
+}
+
+// Smoother of the multigrid
+static void relax_red_black(grid_2D<float>& x, grid_2D<float> const& b, float h2, int sweeps)
+{
+    relax_poisson(x, b, h2, sweeps, {relaxation_red_black, sweeps, 1.0f});
+}
+
+// r = b - Laplacian(x) over the interior cells, returns |r|^2
+static double compute_residual(grid_2D<float> const& x, grid_2D<float> const& b, grid_2D<float>& r, float h2)
+{
+    int const N = int(x.dimension.x);
+    float const inv_h2 = 1.0f/h2;
+    double sum = 0.0;
+    #pragma omp parallel for reduction(+:sum)
+    for(int y=1; y<N-1; ++y) {
+        for(int i=1; i<N-1; ++i) {
+            float const value = b(i,y) - inv_h2*(x(i-1,y)+x(i+1,y)+x(i,y-1)+x(i,y+1) - 4*x(i,y));
+            r(i,y) = value;
+            sum += double(value)*value;
+        }
+    }
+    return sum;
+}
+
+// Average of the fine residual over the children of each coarse cell
+static void restrict_residual(grid_2D<float> const& r, grid_2D<float>& b_coarse)
+{
+    int const n = int(r.dimension.x)-2;
+    int const N_coarse = int(b_coarse.dimension.x);
+    #pragma omp parallel for
+    for(int Y=1; Y<N_coarse-1; ++Y) {
+        for(int X=1; X<N_coarse-1; ++X) {
+            int const x0 = 2*X-1, y0 = 2*Y-1; // First child (grid coordinates of the fine level)
+            int const nx = std::min(2, n+1-x0), ny = std::min(2, n+1-y0);
+            float sum = 0.0f;
+            for(int dy=0; dy<ny; ++dy)
+                for(int dx=0; dx<nx; ++dx)
+                    sum += r(x0+dx, y0+dy);
+            b_coarse(X,Y) = sum/(nx*ny);
+        }
+    }
+}
+
+// x += bilinear interpolation of the coarse correction at the centers of the fine cells (weights 9/16, 3/16, 3/16, 1/16)
+//  The boundary cells of the coarse grid hold the Neumann condition
+static void prolongate_add(grid_2D<float>& x_coarse, grid_2D<float>& x)
+{
+    set_boundary(x_coarse);
+    int const N = int(x.dimension.x);
+    #pragma omp parallel for
+    for(int y=1; y<N-1; ++y) {
+        int const Y = (y-1)/2+1;
+        int const Y2 = ((y-1)&1) ? Y+1 : Y-1; // Closest coarse neighbor along y
+        for(int i=1; i<N-1; ++i) {
+            int const X = (i-1)/2+1;
+            int const X2 = ((i-1)&1) ? X+1 : X-1;
+            x(i,y) += (9*x_coarse(X,Y) + 3*x_coarse(X2,Y) + 3*x_coarse(X,Y2) + x_coarse(X2,Y2))/16.0f;
+        }
+    }
+    set_boundary(x);
+}
+
+
+void poisson_multigrid::resize(int N)
+{
+    if(N==N_fine)
+        return;
+    N_fine = N;
+    levels.clear();
+
+    int n = N-2;
+    float h2 = 1.0f;
+    while(n>coarse_size) {
+        n = (n+1)/2;
+        h2 *= 4.0f;
+        level l;
+        l.x.resize(n+2, n+2);
+        l.b.resize(n+2, n+2);
+        l.r.resize(n+2, n+2);
+        l.h2 = h2;
+        levels.push_back(l);
+    }
+}
+
+void poisson_multigrid::v_cycle(grid_2D<float>& x, grid_2D<float> const& b, grid_2D<float>& r)
+{
+    resize(int(x.dimension.x));
+    v_cycle_level(0, x, b, r, 1.0f);
+}
+
+void poisson_multigrid::v_cycle_level(int k, grid_2D<float>& x, grid_2D<float> const& b, grid_2D<float>& r, float h2)
+{
+    if(k==int(levels.size())) {
+        relax_red_black(x, b, h2, coarse_sweeps);
+        return;
+    }
+
+    relax_red_black(x, b, h2, pre_smoothing);
+    compute_residual(x, b, r, h2);
+
+    level& coarse = levels[k];
+    restrict_residual(r, coarse.b);
+    if(k+1==int(levels.size()))
+        remove_mean(coarse.b); // The coarsest problem must be compatible with the Neumann condition
+    coarse.x.fill(0.0f);
+    v_cycle_level(k+1, coarse.x, coarse.b, coarse.r, coarse.h2);
+    prolongate_add(coarse.x, x);
+
+    relax_red_black(x, b, h2, post_smoothing);
+}
+
+
+static double dot_interior(grid_2D<float> const& a, grid_2D<float> const& b)
+{
+    int const N = int(a.dimension.x);
+    double sum = 0.0;
+    #pragma omp parallel for reduction(+:sum)
+    for(int y=1; y<N-1; ++y)
+        for(int x=1; x<N-1; ++x)
+            sum += double(a(x,y))*b(x,y);
+    return sum;
+}
+
+void poisson_conjugate_gradient::resize(int N)
+{
+    if(N==N_grid)
+        return;
+    N_grid = N;
+    for(grid_2D<float>* g : {&precon, &r, &z, &s, &q}) {
+        g->clear();
+        g->resize(N, N); // The boundary cells stay at 0
+    }
+
+    // Off-diagonal coefficients are -1 between two interior cells, the diagonal is the number of interior neighbors
+    //  Incomplete factorization in lexicographic order (Bridson, Fluid Simulation for Computer Graphics, 4.3)
+    auto interior = [N](int x, int y) { return x>=1 && x<N-1 && y>=1 && y<N-1; };
+    for(int y=1; y<N-1; ++y) {
+        for(int x=1; x<N-1; ++x) {
+            float const diagonal = float(interior(x-1,y)+interior(x+1,y)+interior(x,y-1)+interior(x,y+1));
+            float const a_x = interior(x-1,y) ? -1.0f : 0.0f; // Coefficient with the previous cell along x
+            float const a_y = interior(x,y-1) ? -1.0f : 0.0f; // Coefficient with the previous cell along y
+            float const p_x = precon(x-1,y), p_y = precon(x,y-1);
+            // Coefficients of the previous cells with their own neighbors along the other axis
+            float const a_xy = interior(x-1,y+1) ? -1.0f : 0.0f;
+            float const a_yx = interior(x+1,y-1) ? -1.0f : 0.0f;
+
+            float e = diagonal - (a_x*p_x)*(a_x*p_x) - (a_y*p_y)*(a_y*p_y) - tau*(a_x*a_xy*p_x*p_x + a_y*a_yx*p_y*p_y);
+            if(e<sigma*diagonal)
+                e = diagonal;
+            precon(x,y) = 1.0f/std::sqrt(e);
+        }
+    }
+}
+
+// z = (L L^T)^-1 r: forward then backward substitution (sequential)
+void poisson_conjugate_gradient::apply_preconditioner(grid_2D<float> const& r_in, grid_2D<float>& z_out) const
+{
+    int const N = N_grid;
+    // The boundary cells of precon are 0: the coefficients with the boundary cells vanish
+    for(int y=1; y<N-1; ++y) {
+        for(int x=1; x<N-1; ++x) {
+            float const t = r_in(x,y) + precon(x-1,y)*z_out(x-1,y) + precon(x,y-1)*z_out(x,y-1);
+            z_out(x,y) = t*precon(x,y);
+        }
+    }
+    for(int y=N-2; y>=1; --y) {
+        for(int x=N-2; x>=1; --x) {
+            float const t = z_out(x,y) + precon(x,y)*(z_out(x+1,y)*(x+1<N-1) + z_out(x,y+1)*(y+1<N-1));
+            z_out(x,y) = t*precon(x,y);
+        }
+    }
+}
+
+int poisson_conjugate_gradient::solve(grid_2D<float>& x, grid_2D<float> const& b, float tolerance, int iterations_max)
+{
+    resize(int(x.dimension.x));
+    int const N = N_grid;
+
+    double const b2 = norm2_interior(b);
+    if(b2==0.0)
+        return 0;
+    double const r2_target = double(tolerance)*tolerance*b2;
+
+    // The residual updated by the iterations drifts away from the true residual with the float precision:
+    //  once it reaches the tolerance, the true residual is computed again and the iterations are restarted from it if needed
+    int k = 0;
+    double r2_restart = std::numeric_limits<double>::max();
+    while(k<iterations_max)
+    {
+        // r = -b - A x = -(b - Lx)
+        set_boundary(x);
+        double r2 = compute_residual(x, b, r, 1.0f);
+        if(r2<=r2_target || r2>0.25*r2_restart) // Converged, or no more progress (float precision of the pressure)
+            break;
+        r2_restart = r2;
+        #pragma omp parallel for
+        for(int y=1; y<N-1; ++y)
+            for(int i=1; i<N-1; ++i)
+                r(i,y) = -r(i,y);
+
+        // The constant component of the preconditioned residual is removed (null space of A): the pressure keeps a zero mean
+        apply_preconditioner(r, z);
+        remove_mean(z);
+        s = z;
+        double rho = dot_interior(r, z);
+
+        while(r2>r2_target && k<iterations_max)
+        {
+            // q = A s (Neumann condition through the boundary cells)
+            set_boundary(s);
+            #pragma omp parallel for
+            for(int y=1; y<N-1; ++y)
+                for(int i=1; i<N-1; ++i)
+                    q(i,y) = 4*s(i,y) - (s(i-1,y)+s(i+1,y)+s(i,y-1)+s(i,y+1));
+
+            double const sq = dot_interior(s, q);
+            if(sq<=0.0)
+                break;
+            float const alpha = float(rho/sq);
+            r2 = 0.0;
+            #pragma omp parallel for reduction(+:r2)
+            for(int y=1; y<N-1; ++y) {
+                for(int i=1; i<N-1; ++i) {
+                    x(i,y) += alpha*s(i,y);
+                    r(i,y) -= alpha*q(i,y);
+                    r2 += double(r(i,y))*r(i,y);
+                }
+            }
+            k++;
+
+            apply_preconditioner(r, z);
+            remove_mean(z);
+            double const rho_new = dot_interior(r, z);
+            float const beta = float(rho_new/rho);
+            rho = rho_new;
+            #pragma omp parallel for
+            for(int y=1; y<N-1; ++y)
+                for(int i=1; i<N-1; ++i)
+                    s(i,y) = z(i,y) + beta*s(i,y);
+        }
+    }
+    set_boundary(x);
+    return k;
+}
+
+
+float poisson_residual(grid_2D<float> const& x, grid_2D<float> const& b, grid_2D<float>& r)
+{
+    double const b2 = norm2_interior(b);
+    if(b2==0.0)
+        return 0.0f;
+    return float(std::sqrt(compute_residual(x, b, r, 1.0f)/b2));
+}
+
+void pressure_solve(grid_2D<float>& pressure, grid_2D<float>& divergence, pressure_solver& solver)
+{
+    int const N = int(pressure.dimension.x);
+    if(solver.residual.dimension.x!=size_t(N))
+        solver.residual.resize(N, N);
+
+    remove_mean(divergence);
+
+    solver.iterations = 0;
+    if(solver.type==pressure_relaxation) {
+        relax_poisson(pressure, divergence, 1.0f, solver.relaxation.iterations, solver.relaxation);
+        solver.iterations = solver.relaxation.iterations;
+        solver.residual_relative = poisson_residual(pressure, divergence, solver.residual);
+    }
+    else if(solver.type==pressure_conjugate_gradient) {
+        solver.iterations = solver.conjugate_gradient.solve(pressure, divergence, solver.tolerance, solver.conjugate_gradient_iterations_max);
+        solver.residual_relative = poisson_residual(pressure, divergence, solver.residual);
+    }
+    else {
+        solver.residual_relative = poisson_residual(pressure, divergence, solver.residual);
+        while(solver.residual_relative>solver.tolerance && solver.iterations<solver.cycles_max) {
+            float const residual_previous = solver.residual_relative;
+            solver.multigrid.v_cycle(pressure, divergence, solver.residual);
+            solver.residual_relative = poisson_residual(pressure, divergence, solver.residual);
+            solver.iterations++;
+
+            // A cycle reduces the residual by ~10: a stagnation means that the float precision of the pressure is reached
+            //  (the pressure grows as N^2, ex. relative residual ~1e-3 on 1024^2 grids)
+            if(solver.residual_relative>0.5f*residual_previous)
+                break;
+        }
+    }
+}
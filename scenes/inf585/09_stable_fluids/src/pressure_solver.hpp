@@ -0,0 +1,91 @@
+#pragma once
+
+#include "vcl/vcl.hpp"
+#include "relaxation.hpp"
+
+
+// Solvers of the pressure Poisson equation  Laplacian(pressure) = divergence  used by divergence_free
+//  The grids have a layer of boundary cells (x=0, x=N-1, y=0, y=N-1) with a Neumann condition (copy of the neighbor cell),
+//  the unknowns are the interior cells. The spacing of the finest grid is 1 (velocity expressed in cells/s).
+enum pressure_solver_type { pressure_relaxation, pressure_multigrid, pressure_conjugate_gradient };
+
+
+// Geometric multigrid V-cycle on a hierarchy of cell-centered grids
+//  - Each coarse cell covers 2x2 cells of the finer level (the last row/column covers a single one for odd sizes)
+//  - Smoother: red-black Gauss-Seidel sweeps (see relaxation.hpp)
+//  - Restriction: average of the residual over the children - Prolongation: bilinear interpolation of the correction
+//  The coarse levels are allocated once for a given size of the fine grid, the fine level directly uses the grids given to v_cycle
+struct poisson_multigrid
+{
+    int pre_smoothing = 2;  // Red-black sweeps before the restriction
+    int post_smoothing = 2; // Red-black sweeps after the prolongation
+    int coarse_sweeps = 30; // Sweeps of the coarsest level (a few cells)
+    int coarse_size = 4;    // Largest number of interior cells in each direction of the coarsest level
+
+    // Allocate the coarse levels of a fine grid of N x N cells (nothing is done if the hierarchy already matches N)
+    void resize(int N);
+    // One V-cycle improving the solution x of Laplacian(x) = b, r is used to store the residual of the fine level
+    void v_cycle(vcl::grid_2D<float>& x, vcl::grid_2D<float> const& b, vcl::grid_2D<float>& r);
+
+    int level_count() const { return int(levels.size())+1; }
+
+private:
+    struct level
+    {
+        vcl::grid_2D<float> x; // Correction
+        vcl::grid_2D<float> b; // Restricted residual
+        vcl::grid_2D<float> r; // Residual of this level
+        float h2 = 1.0f;       // Squared spacing of the cells relative to the fine grid
+    };
+    std::vector<level> levels; // Coarse levels, from the finest to the coarsest
+    int N_fine = 0;
+
+    void v_cycle_level(int k, vcl::grid_2D<float>& x, vcl::grid_2D<float> const& b, vcl::grid_2D<float>& r, float h2);
+};
+
+
+// Matrix-free conjugate gradient preconditioned by a modified incomplete Cholesky factorization MIC(0)
+//  Solves A x = -b with A = -Laplacian (symmetric positive semi-definite: the boundary cells are removed from the stencil)
+//  The factorization only depends on the size of the grid: it is computed once, the triangular solves are sequential
+struct poisson_conjugate_gradient
+{
+    float tau = 0.97f;   // Weight of the modification of the incomplete Cholesky (0: IC(0), 1: full MIC)
+    float sigma = 0.25f; // Safety: a pivot smaller than sigma*diagonal is replaced by the diagonal (pure Neumann problem is singular)
+
+    // Allocate the working grids and compute the preconditioner of a grid of N x N cells (nothing is done if N is unchanged)
+    void resize(int N);
+    // Iterate from x until |b-Lx|/|b| < tolerance or iterations_max, returns the number of iterations
+    int solve(vcl::grid_2D<float>& x, vcl::grid_2D<float> const& b, float tolerance, int iterations_max);
+
+private:
+    vcl::grid_2D<float> precon; // 1/sqrt(pivot) of the factorization
+    vcl::grid_2D<float> r, z, s, q; // Residual, preconditioned residual, search direction, A s
+    int N_grid = 0;
+
+    void apply_preconditioner(vcl::grid_2D<float> const& r, vcl::grid_2D<float>& z) const;
+};
+
+
+struct pressure_solver
+{
+    pressure_solver_type type = pressure_multigrid;
+    relaxation_parameters relaxation = {relaxation_red_black, 20, 0.8f}; // Fixed number of sweeps of the relaxation solver
+    float tolerance = 1e-3f;          // Relative residual |b-Lx|/|b| stopping the multigrid cycles and the conjugate gradient
+    int cycles_max = 20;
+    int conjugate_gradient_iterations_max = 500;
+
+    poisson_multigrid multigrid;
+    poisson_conjugate_gradient conjugate_gradient;
+    vcl::grid_2D<float> residual; // Storage of the residual on the fine grid
+
+    // Statistics of the last solve
+    int iterations = 0;            // Relaxation sweeps, V-cycles or conjugate gradient iterations
+    float residual_relative = 0.0f; // |b-Lx|/|b| at the end of the solve
+};
+
+// Solve Laplacian(pressure) = divergence, starting from the current pressure (warm start from the previous frame)
+//  The mean of the divergence is removed: the Neumann problem only has a solution for a zero mean right-hand side
+void pressure_solve(vcl::grid_2D<float>& pressure, vcl::grid_2D<float>& divergence, pressure_solver& solver);
+
+// Relative residual |b-Lx|/|b| over the interior cells (r stores the residual)
+float poisson_residual(vcl::grid_2D<float> const& x, vcl::grid_2D<float> const& b, vcl::grid_2D<float>& r);
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "vcl/vcl.hpp"
+#include "boundary.hpp"
+
+#include <utility>
+
+
+// Iterative relaxation of the 5-point systems of the stable fluids (diffusion and pressure)
+//   x(i,j) = w_neighbors * (x(i-1,j)+x(i+1,j)+x(i,j-1)+x(i,j+1)) + w_b * b(i,j)
+//  over the interior cells of a grid_2D<T> (T = float, vec2 or vec3), the boundary cells are set by a boundary condition after each sweep.
+//  The boundary is the first and last row/column by default, or several layers (border) when the grid holds fixed values inside
+//  (ex. the wall faces of a staggered velocity): the relaxation neither writes them nor reads modified values during a sweep.
+//  - gauss_seidel: lexicographic order, each cell uses the values already updated in the sweep (sequential)
+//  - red_black: the cells (i+j) even then the cells (i+j) odd, each color only depends on the other one (parallel rows, SIMD)
+//  - jacobi: all the cells from the values of the previous sweep, weighted by jacobi_weight (parallel rows, SIMD)
+//  The parallel modes process a row as a contiguous array of floats: the components of vec2/vec3 are updated by the same SIMD loop.
+enum relaxation_type { relaxation_gauss_seidel, relaxation_red_black, relaxation_jacobi };
+
+struct relaxation_parameters
+{
+    relaxation_type type = relaxation_red_black;
+    int iterations = 15;
+    float jacobi_weight = 0.8f; // New value = (1-w) old + w Jacobi update (w<1 damps the oscillations between neighbor cells)
+};
+
+//  border: number of boundary layers along x and y, set_boundary_condition must set all of them
+template <typename T, typename BOUNDARY>
+void relax(vcl::grid_2D<T>& x, vcl::grid_2D<T> const& b, float w_neighbors, float w_b, int sweeps, relaxation_parameters const& relaxation, BOUNDARY const& set_boundary_condition, vcl::int2 const& border = {1,1});
+
+// Same relaxation starting from x_initial instead of the values of x: the first sweep reads x_initial and writes every cell of x
+//  (no copy of the initial guess, x can hold outdated values - ex. the storage released by double_buffer::swap)
+template <typename T, typename BOUNDARY>
+void relax(vcl::grid_2D<T>& x, vcl::grid_2D<T> const& x_initial, vcl::grid_2D<T> const& b, float w_neighbors, float w_b, int sweeps, relaxation_parameters const& relaxation, BOUNDARY const& set_boundary_condition, vcl::int2 const& border = {1,1});
+
+
+
+
+namespace detail
+{
+    // Copy the cells of the border layers of x_source
+    template <typename T>
+    void copy_border(vcl::grid_2D<T>& x, vcl::grid_2D<T> const& x_source, vcl::int2 const& border)
+    {
+        int const Nx = int(x.dimension.x);
+        int const Ny = int(x.dimension.y);
+        for(int j=0; j<Ny; ++j) {
+            bool const row_border = j<border.y || j>=Ny-border.y;
+            for(int i=0; i<Nx; ++i)
+                if(row_border || i<border.x || i>=Nx-border.x)
+                    x(i,j) = x_source(i,j);
+        }
+    }
+
+    // Update of the row y on the floats of the grids (D floats per cell), cells i_border to Nx-1-i_border
+    //  color = 0/1: only the cells (i+y)%2==color are updated
+    //   In place (x_in==x_out) the cells of the other color are not written: the rows y-1 and y+1, updated by other threads, read them.
+    //   Otherwise they are copied from x_in.
+    //  color = -1: Jacobi update from x_in to x_out
+    template <int D>
+    void relax_row(float const* x_in, float* x_out, float const* b, int Nx, int i_border, int y, int color, float w_neighbors, float w_b, float w_jacobi)
+    {
+        int const row = D*Nx;
+        float const* p = x_in + row*y;
+        float const* pb = b + row*y;
+        float* q = x_out + row*y;
+
+        // The reads of a cell only concern the other color (red-black) or the previous sweep (Jacobi): no dependency between the iterations
+        if(color>=0 && x_in==x_out) {
+            int const i_start = (i_border+y)%2==color ? i_border : i_border+1;
+            #pragma omp simd
+            for(int i=i_start; i<Nx-i_border; i+=2) {
+                for(int c=0; c<D; ++c) {
+                    int const k = D*i+c;
+                    q[k] = w_neighbors*(p[k-D]+p[k+D]+p[k-row]+p[k+row]) + w_b*pb[k];
+                }
+            }
+            return;
+        }
+
+        #pragma omp simd
+        for(int k=D*i_border; k<row-D*i_border; ++k) {
+            float const value = w_neighbors*(p[k-D]+p[k+D]+p[k-row]+p[k+row]) + w_b*pb[k];
+            if(color<0)
+                q[k] = (1-w_jacobi)*p[k] + w_jacobi*value;
+            else
+                q[k] = ((k/D+y)%2==color) ? value : p[k];
+        }
+    }
+}
+
+template <typename T, typename BOUNDARY>
+void relax(vcl::grid_2D<T>& x, vcl::grid_2D<T> const& b, float w_neighbors, float w_b, int sweeps, relaxation_parameters const& relaxation, BOUNDARY const& set_boundary_condition, vcl::int2 const& border)
+{
+    relax(x, x, b, w_neighbors, w_b, sweeps, relaxation, set_boundary_condition, border);
+}
+
+template <typename T, typename BOUNDARY>
+void relax(vcl::grid_2D<T>& x, vcl::grid_2D<T> const& x_initial, vcl::grid_2D<T> const& b, float w_neighbors, float w_b, int sweeps, relaxation_parameters const& relaxation, BOUNDARY const& set_boundary_condition, vcl::int2 const& border)
+{
+    static_assert(sizeof(T)%sizeof(float)==0, "The relaxation applies to grids of float, vec2 or vec3");
+    int constexpr D = int(sizeof(T)/sizeof(float));
+    int const Nx = int(x.dimension.x);
+    int const Ny = int(x.dimension.y);
+
+    // The sweeps read the boundary cells before setting them: they start from the ones of x_initial
+    bool const separate_initial = &x_initial!=&x;
+    if(separate_initial)
+        detail::copy_border(x, x_initial, border);
+    if(sweeps<=0 && separate_initial)
+        x = x_initial;
+
+    if(relaxation.type==relaxation_gauss_seidel)
+    {
+        for(int k=0; k<sweeps; ++k) {
+            // The cells after (i,j) are not updated yet in this sweep: the first one reads them in x_initial
+            vcl::grid_2D<T> const& x_next = k==0 ? x_initial : x;
+            for(int j=border.y; j<Ny-border.y; ++j)
+                for(int i=border.x; i<Nx-border.x; ++i)
+                    x(i,j) = w_neighbors*(x(i-1,j)+x_next(i+1,j)+x(i,j-1)+x_next(i,j+1)) + w_b*b(i,j);
+            set_boundary_condition(x);
+        }
+        return;
+    }
+
+    float const* pb = reinterpret_cast<float const*>(&b[0]);
+    if(relaxation.type==relaxation_red_black)
+    {
+        for(int k=0; k<sweeps; ++k) {
+            for(int color=0; color<2; ++color) {
+                // The first color of the first sweep reads x_initial and writes both colors of x
+                float const* px_in = reinterpret_cast<float const*>(k==0 && color==0 ? &x_initial[0] : &x[0]);
+                float* px = reinterpret_cast<float*>(&x[0]);
+                #pragma omp parallel for
+                for(int j=border.y; j<Ny-border.y; ++j)
+                    detail::relax_row<D>(px_in, px, pb, Nx, border.x, j, color, w_neighbors, w_b, 0.0f);
+            }
+            set_boundary_condition(x);
+        }
+        return;
+    }
+
+    // Jacobi: the new values are written in a second grid (kept between the calls), then the storages are exchanged
+    //  A separate initial guess is directly read by the first sweep, which writes in x
+    int k_start = 0;
+    if(separate_initial && sweeps>0) {
+        float const* px_initial = reinterpret_cast<float const*>(&x_initial[0]);
+        float* px = reinterpret_cast<float*>(&x[0]);
+        #pragma omp parallel for
+        for(int j=border.y; j<Ny-border.y; ++j)
+            detail::relax_row<D>(px_initial, px, pb, Nx, border.x, j, -1, w_neighbors, w_b, relaxation.jacobi_weight);
+        set_boundary_condition(x);
+        k_start = 1;
+    }
+
+    static thread_local vcl::grid_2D<T> x_next;
+    if(x_next.dimension.x!=x.dimension.x || x_next.dimension.y!=x.dimension.y)
+        x_next.resize(x.dimension);
+    for(int k=k_start; k<sweeps; ++k) {
+        float const* px = reinterpret_cast<float const*>(&x[0]);
+        float* px_next = reinterpret_cast<float*>(&x_next[0]);
+        #pragma omp parallel for
+        for(int j=border.y; j<Ny-border.y; ++j)
+            detail::relax_row<D>(px, px_next, pb, Nx, border.x, j, -1, w_neighbors, w_b, relaxation.jacobi_weight);
+        std::swap(x.data.data, x_next.data.data);
+        set_boundary_condition(x);
+    }
+}
@@ -4,7 +4,7 @@ using namespace vcl;
 
 
 
-void divergence_free(grid_2D<vec2>& new_velocity, grid_2D<vec2> const& velocity, grid_2D<float>& divergence, grid_2D<float>& gradient_field)
+void divergence_free(grid_2D<vec2>& new_velocity, grid_2D<vec2> const& velocity, grid_2D<float>& divergence, grid_2D<float>& gradient_field, pressure_solver& solver)
 {
     // v = projection of v0 on divergence free vector field
     //
@@ -12,11 +12,139 @@ void divergence_free(grid_2D<vec2>& new_velocity, grid_2D<vec2> const& velocity,
     // v0: Initial vector field (non divergence free)
     // divergence: temporary buffer used to compute the divergence of v0
     // gradient_field: temporary buffer used to compute v = v0 - nabla(gradient_field)
+    //                 (kept between the frames: initial guess of the next solve)
+    int const N = int(velocity.dimension.x);
 
-
-    // TO do:
     // 1. Compute divergence of v0
+    #pragma omp parallel for
+    for(int y=1; y<N-1; ++y)
+        for(int x=1; x<N-1; ++x)
+            divergence(x,y) = 0.5f*(velocity(x+1,y).x-velocity(x-1,y).x + velocity(x,y+1).y-velocity(x,y-1).y);
+
     // 2. Compute gradient_field such that nabla(gradient_field)^2 = div(v0)
+    pressure_solve(gradient_field, divergence, solver);
+
     // 3. Compute v = v0 - nabla(gradient_field)
+    #pragma omp parallel for
+    for(int y=1; y<N-1; ++y)
+        for(int x=1; x<N-1; ++x)
+            new_velocity(x,y) = velocity(x,y) - 0.5f*vec2(gradient_field(x+1,y)-gradient_field(x-1,y), gradient_field(x,y+1)-gradient_field(x,y-1));
+    set_boundary_reflective(new_velocity);
+}
+
+
+void divergence_free(velocity_mac& velocity, grid_2D<float>& divergence, grid_2D<float>& gradient_field, pressure_solver& solver)
+{
+    // Projection of the staggered velocity (in place)
+    //  The divergence of a cell is the flux through its 4 faces, and the gradient of the pressure is evaluated on the faces:
+    //  the divergence of the projected velocity is exactly the residual of the Poisson solve.
+    int const N = velocity.size();
+    grid_2D<float>& u = velocity.u;
+    grid_2D<float>& v = velocity.v;
+
+    // 1. Divergence of the cells
+    #pragma omp parallel for
+    for(int y=1; y<N-1; ++y)
+        for(int x=1; x<N-1; ++x)
+            divergence(x,y) = u(x+1,y)-u(x,y) + v(x,y+1)-v(x,y);
+
+    // 2. Laplacian(gradient_field) = divergence
+    pressure_solve(gradient_field, divergence, solver);
+
+    // 3. Subtract the gradient on the interior faces (the walls u(1,y), u(N-1,y), v(x,1), v(x,N-1) stay at 0)
+    #pragma omp parallel for
+    for(int y=1; y<N-1; ++y)
+        for(int x=2; x<N-1; ++x)
+            u(x,y) -= gradient_field(x,y)-gradient_field(x-1,y);
+    #pragma omp parallel for
+    for(int y=2; y<N-1; ++y)
+        for(int x=1; x<N-1; ++x)
+            v(x,y) -= gradient_field(x,y)-gradient_field(x,y-1);
+    velocity.set_boundary();
+}
+
+void diffuse(velocity_mac& new_velocity, velocity_mac const& velocity_reference, float mu, float dt, relaxation_parameters const& relaxation)
+{
+    // Each component is diffused on its own grid of faces, with the same coefficient as the cell-centered diffusion
+    //  Only the interior faces are unknowns: the walls u(1,y), u(N-1,y), v(x,1), v(x,N-1) are a second layer of boundary (0)
+    int const N = new_velocity.size();
+    float const a = mu*dt*(N-2.0f)*(N-2.0f);
+    relax(new_velocity.u, velocity_reference.u, a/(1+4*a), 1/(1+4*a), relaxation.iterations, relaxation, velocity_mac::set_boundary_u, {2,1});
+    relax(new_velocity.v, velocity_reference.v, a/(1+4*a), 1/(1+4*a), relaxation.iterations, relaxation, velocity_mac::set_boundary_v, {1,2});
+}
+
+void advect(velocity_mac& new_velocity, velocity_mac const& velocity_reference, float dt)
+{
+    // Self-advection of the staggered velocity: each face is back-traced with the velocity at its center, then its own component
+    //  is read by a single bilinear interpolation on its grid (the collocated version averages 4 interpolations per cell)
+    int const N = velocity_reference.size();
+    grid_2D<float> const& u = velocity_reference.u;
+    grid_2D<float> const& v = velocity_reference.v;
 
-}
\ No newline at end of file
+    // Faces u(x,y) at (x-0.5, y): the v component is the average of the 4 surrounding v faces
+    #pragma omp parallel for
+    for(int y=1; y<N-1; ++y) {
+        for(int x=2; x<N-1; ++x) {
+            float const vy = 0.25f*(v(x-1,y)+v(x,y)+v(x-1,y+1)+v(x,y+1));
+            float const bx = x - dt*u(x,y);
+            float const by = y - dt*vy;
+            new_velocity.u(x,y) = interpolation_bilinear_clamped(u, bx, by);
+        }
+    }
+
+    // Faces v(x,y) at (x, y-0.5): the u component is the average of the 4 surrounding u faces
+    #pragma omp parallel for
+    for(int y=2; y<N-1; ++y) {
+        for(int x=1; x<N-1; ++x) {
+            float const ux = 0.25f*(u(x,y-1)+u(x+1,y-1)+u(x,y)+u(x+1,y));
+            float const bx = x - dt*ux;
+            float const by = y - dt*v(x,y);
+            new_velocity.v(x,y) = interpolation_bilinear_clamped(v, bx, by);
+        }
+    }
+    new_velocity.set_boundary();
+}
+
+
+void divergence_free(double_buffer<grid_2D<vec2>>& velocity, grid_2D<float>& divergence, grid_2D<float>& gradient_field, pressure_solver& solver)
+{
+    velocity.swap();
+    divergence_free(velocity.current(), velocity.previous(), divergence, gradient_field, solver);
+}
+
+void advect(double_buffer<grid_2D<vec2>>& velocity, float dt)
+{
+    velocity.swap();
+    copy_boundary(velocity.current(), velocity.previous());
+    advect(velocity.current(), velocity.previous(), velocity.previous(), dt);
+}
+
+void advect(double_buffer<grid_2D<vec2>>& velocity, float dt, advection_type type, advection_workspace<vec2>& workspace)
+{
+    if(type==advection_semi_lagrangian) {
+        advect(velocity, dt);
+        return;
+    }
+
+    cell_velocity(workspace.velocity_cell, velocity.current());
+    velocity.swap();
+    advect_compensated(velocity.current(), velocity.previous(), workspace.velocity_cell, dt, type, workspace.value_backward);
+}
+
+void diffuse(double_buffer<velocity_mac>& velocity, float mu, float dt, relaxation_parameters const& relaxation)
+{
+    velocity.swap();
+    velocity_mac& v = velocity.current();
+    velocity_mac const& v_reference = velocity.previous();
+    int const N = v_reference.size();
+    float const a = mu*dt*(N-2.0f)*(N-2.0f);
+    relax(v.u, v_reference.u, v_reference.u, a/(1+4*a), 1/(1+4*a), relaxation.iterations, relaxation, velocity_mac::set_boundary_u, {2,1});
+    relax(v.v, v_reference.v, v_reference.v, a/(1+4*a), 1/(1+4*a), relaxation.iterations, relaxation, velocity_mac::set_boundary_v, {1,2});
+}
+
+void advect(double_buffer<velocity_mac>& velocity, float dt)
+{
+    // The fused advection writes all the faces (interior faces and boundary conditions)
+    velocity.swap();
+    advect(velocity.current(), velocity.previous(), dt);
+}
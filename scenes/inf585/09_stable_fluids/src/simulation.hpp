@@ -2,37 +2,61 @@
 
 #include "vcl/vcl.hpp"
 #include "boundary.hpp"
+#include "pressure_solver.hpp"
+#include "relaxation.hpp"
+#include "velocity_mac.hpp"
+#include "double_buffer.hpp"
+#include "advection.hpp"
 
-enum density_type_structure {density_color, density_texture, view_velocity_curl} ;
+enum density_type_structure {density_color, density_texture, view_velocity_curl, view_smoke_3D} ;
 
 
-void divergence_free(vcl::grid_2D<vcl::vec2>& new_velocity, vcl::grid_2D<vcl::vec2> const& velocity, vcl::grid_2D<float>& divergence, vcl::grid_2D<float>& gradient_field);
+void divergence_free(vcl::grid_2D<vcl::vec2>& new_velocity, vcl::grid_2D<vcl::vec2> const& velocity, vcl::grid_2D<float>& divergence, vcl::grid_2D<float>& gradient_field, pressure_solver& solver);
 
-template <typename T> void diffuse(vcl::grid_2D<T>& new_field, vcl::grid_2D<T> const& field_reference, float mu, float dt, boundary_condition boundary);
+template <typename T> void diffuse(vcl::grid_2D<T>& new_field, vcl::grid_2D<T> const& field_reference, float mu, float dt, boundary_condition boundary, relaxation_parameters const& relaxation = relaxation_parameters());
 template <typename T> void advect(vcl::grid_2D<T>& new_value, vcl::grid_2D<T> const& value_reference, vcl::grid_2D<vcl::vec2> const& velocity, float dt);
 
+// Same steps on the staggered (MAC) velocity
+void divergence_free(velocity_mac& velocity, vcl::grid_2D<float>& divergence, vcl::grid_2D<float>& gradient_field, pressure_solver& solver);
+void diffuse(velocity_mac& new_velocity, velocity_mac const& velocity_reference, float mu, float dt, relaxation_parameters const& relaxation = relaxation_parameters());
+void advect(velocity_mac& new_velocity, velocity_mac const& velocity_reference, float dt);
+template <typename T> void advect(vcl::grid_2D<T>& new_value, vcl::grid_2D<T> const& value_reference, velocity_mac const& velocity, float dt);
+
+// Same steps on double-buffered fields: the storages are swapped, then current() is computed from previous() (no copy of the field)
+template <typename T> void diffuse(double_buffer<vcl::grid_2D<T>>& field, float mu, float dt, boundary_condition boundary, relaxation_parameters const& relaxation = relaxation_parameters());
+void diffuse(double_buffer<velocity_mac>& velocity, float mu, float dt, relaxation_parameters const& relaxation = relaxation_parameters());
+void divergence_free(double_buffer<vcl::grid_2D<vcl::vec2>>& velocity, vcl::grid_2D<float>& divergence, vcl::grid_2D<float>& gradient_field, pressure_solver& solver);
+// Advection of a field by a collocated (grid_2D<vec2>) or a staggered (velocity_mac) velocity
+template <typename T, typename VELOCITY> void advect(double_buffer<vcl::grid_2D<T>>& field, VELOCITY const& velocity, float dt);
+// Self-advection of the velocity
+void advect(double_buffer<vcl::grid_2D<vcl::vec2>>& velocity, float dt);
+void advect(double_buffer<velocity_mac>& velocity, float dt);
+// Advection with the scheme of advection.hpp (advection_semi_lagrangian calls the functions above)
+//  workspace: working grids of the error compensation, owned by the caller
+template <typename T, typename VELOCITY> void advect(double_buffer<vcl::grid_2D<T>>& field, VELOCITY const& velocity, float dt, advection_type type, advection_workspace<T>& workspace);
+void advect(double_buffer<vcl::grid_2D<vcl::vec2>>& velocity, float dt, advection_type type, advection_workspace<vcl::vec2>& workspace);
+
 
 
 
 template <typename T>
-void diffuse(vcl::grid_2D<T>& new_field, vcl::grid_2D<T> const& field_reference, float mu, float dt, boundary_condition boundary)
+void diffuse(vcl::grid_2D<T>& new_field, vcl::grid_2D<T> const& field_reference, float mu, float dt, boundary_condition boundary, relaxation_parameters const& relaxation)
 {
     using namespace vcl;
     // Compute diffusion on f
     //  Use f as current value, f_prev as previous value
     //  The function is generic in order to handle f as being either a velocity (T=vec2), or a color density (T=vec3)
 
-    // TO do:
-    //  Update new_field in solving the diffusion equation for the time step dt
-    //  Use Gauss-Seidel iterations over 10 to 15 times
-    //   For each iteration, you may reset the boundary conditions with the following code:
-    //   		if(boundary==copy)
-	//		set_boundary(new_field);
-	//       	else
-	//		set_boundary_reflective(new_field);
-
-
-
+    // Implicit diffusion  f - a Laplacian(f) = f_prev  solved by relaxation sweeps (new_field is the initial guess)
+    //  The diffusion coefficient is expressed in the unit domain: cells of size 1/(N-2)
+    int const N = int(new_field.dimension.x);
+    float const a = mu*dt*(N-2.0f)*(N-2.0f);
+    relax(new_field, field_reference, a/(1+4*a), 1/(1+4*a), relaxation.iterations, relaxation, [boundary](grid_2D<T>& f) {
+        if(boundary==copy)
+            set_boundary(f);
+        else
+            set_boundary_reflective(f);
+    });
 }
 
 
@@ -66,4 +90,59 @@ void advect(vcl::grid_2D<T>& new_value, vcl::grid_2D<T> const& value_reference,
 
 
 
+template <typename T>
+void advect(vcl::grid_2D<T>& new_value, vcl::grid_2D<T> const& value_reference, velocity_mac const& velocity, float dt)
+{
+    using namespace vcl;
+    // Advection of a cell-centered value: the velocity at the cell center is the average of its two faces in each direction
+    int const N = int(new_value.dimension.x);
+
+    #pragma omp parallel for
+    for(int y=1; y<N-1; ++y) {
+        for(int x=1; x<N-1; ++x) {
+            vec2 const p_back = vec2(float(x),float(y)) - dt*velocity.at_cell(x,y);
+            new_value(x,y) = interpolation_bilinear_clamped(value_reference, p_back.x, p_back.y);
+        }
+    }
+}
+
 
+
+template <typename T>
+void diffuse(double_buffer<vcl::grid_2D<T>>& field, float mu, float dt, boundary_condition boundary, relaxation_parameters const& relaxation)
+{
+    using namespace vcl;
+    // The previous value is both the right-hand side and the initial guess of the relaxation (read by its first sweep)
+    field.swap();
+    grid_2D<T> const& field_reference = field.previous();
+    int const N = int(field_reference.dimension.x);
+    float const a = mu*dt*(N-2.0f)*(N-2.0f);
+    relax(field.current(), field_reference, field_reference, a/(1+4*a), 1/(1+4*a), relaxation.iterations, relaxation, [boundary](grid_2D<T>& f) {
+        if(boundary==copy)
+            set_boundary(f);
+        else
+            set_boundary_reflective(f);
+    });
+}
+
+template <typename T, typename VELOCITY>
+void advect(double_buffer<vcl::grid_2D<T>>& field, VELOCITY const& velocity, float dt)
+{
+    // advect only writes the interior cells: the boundary cells are kept from the previous value
+    field.swap();
+    copy_boundary(field.current(), field.previous());
+    advect(field.current(), field.previous(), velocity, dt);
+}
+
+template <typename T, typename VELOCITY>
+void advect(double_buffer<vcl::grid_2D<T>>& field, VELOCITY const& velocity, float dt, advection_type type, advection_workspace<T>& workspace)
+{
+    if(type==advection_semi_lagrangian) {
+        advect(field, velocity, dt);
+        return;
+    }
+
+    cell_velocity(workspace.velocity_cell, velocity);
+    field.swap();
+    advect_compensated(field.current(), field.previous(), workspace.velocity_cell, dt, type, workspace.value_backward);
+}
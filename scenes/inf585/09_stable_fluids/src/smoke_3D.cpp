@@ -0,0 +1,251 @@
+#include "smoke_3D.hpp"
+
+using namespace vcl;
+
+
+void set_boundary_reflective(sparse_grid_3D<vec3>& velocity, tile_list const& tiles)
+{
+    // Copy of the closest interior cell, the components normal to the faces the cell is on are reversed
+    int constexpr S = sparse_grid_3D<vec3>::tile_size;
+    int3 const N = velocity.dimension;
+    for_each_tile(velocity, tiles, [&](int3 const& tile, int storage) {
+        if(!boundary_tile(tile, S, N))
+            return;
+        grid_3D<vec3>& values = velocity.tile(storage);
+        for(int kz=0; kz<S; ++kz) {
+            for(int ky=0; ky<S; ++ky) {
+                for(int kx=0; kx<S; ++kx) {
+                    int const gx = tile.x*S+kx, gy = tile.y*S+ky, gz = tile.z*S+kz;
+                    if(gx>=N.x || gy>=N.y || gz>=N.z || interior_cell(gx, gy, gz, N))
+                        continue;
+                    int const cx = std::min(std::max(gx,1),N.x-2), cy = std::min(std::max(gy,1),N.y-2), cz = std::min(std::max(gz,1),N.z-2);
+                    vec3 v = velocity.value(cx, cy, cz);
+                    if(cx!=gx) v.x *= -1.0f;
+                    if(cy!=gy) v.y *= -1.0f;
+                    if(cz!=gz) v.z *= -1.0f;
+                    values[sparse_grid_3D<vec3>::offset(kx, ky, kz)] = v;
+                }
+            }
+        }
+    });
+}
+
+void advect(double_buffer<sparse_grid_3D<vec3>>& velocity, float dt, tile_list const& tiles)
+{
+    velocity.swap();
+    advect(velocity.current(), velocity.previous(), velocity.previous(), dt, tiles);
+}
+
+void divergence_free(sparse_grid_3D<vec3>& velocity, sparse_grid_3D<float>& divergence, sparse_grid_3D<float>& pressure, int iterations, tile_list const& tiles, padded_tiles<float>& padded)
+{
+    int constexpr S = sparse_grid_3D<float>::tile_size;
+    int constexpr P = S+2; // Size of the padded tiles
+    int3 const N = velocity.dimension;
+
+    // 1. Divergence of the velocity (central differences as in 2D)
+    for_each_tile(divergence, tiles, [&](int3 const& tile, int storage) {
+        static thread_local grid_3D<vec3> v_padded;
+        velocity.gather_padded(tile, v_padded);
+        vec3 const* v = &v_padded[0];
+        float* d = &divergence.tile(storage)[0];
+        for(int kz=0; kz<S; ++kz) {
+            for(int ky=0; ky<S; ++ky) {
+                for(int kx=0; kx<S; ++kx) {
+                    int const o = sparse_grid_3D<float>::offset(kx, ky, kz);
+                    int const q = (kx+1) + P*((ky+1) + P*(kz+1));
+                    if(interior_cell(tile.x*S+kx, tile.y*S+ky, tile.z*S+kz, N))
+                        d[o] = 0.5f*(v[q+1].x-v[q-1].x + v[q+P].y-v[q-P].y + v[q+P*P].z-v[q-P*P].z);
+                    else
+                        d[o] = 0.0f;
+                }
+            }
+        }
+    });
+
+    // 2. Laplacian(pressure) = divergence, from the pressure of the previous step
+    relax(pressure, pressure, divergence, 1.0f/6, -1.0f/6, iterations, tiles, padded, [&tiles](sparse_grid_3D<float>& p) {
+        set_boundary(p, tiles);
+    });
+
+    // 3. velocity = velocity - gradient(pressure)
+    for_each_tile(velocity, tiles, [&](int3 const& tile, int storage) {
+        static thread_local grid_3D<float> p_padded;
+        pressure.gather_padded(tile, p_padded);
+        float const* p = &p_padded[0];
+        vec3* v = &velocity.tile(storage)[0];
+        for(int kz=0; kz<S; ++kz) {
+            for(int ky=0; ky<S; ++ky) {
+                for(int kx=0; kx<S; ++kx) {
+                    int const q = (kx+1) + P*((ky+1) + P*(kz+1));
+                    if(interior_cell(tile.x*S+kx, tile.y*S+ky, tile.z*S+kz, N))
+                        v[sparse_grid_3D<vec3>::offset(kx, ky, kz)] -= 0.5f*vec3(p[q+1]-p[q-1], p[q+P]-p[q-P], p[q+P*P]-p[q-P*P]);
+                }
+            }
+        }
+    });
+    set_boundary_reflective(velocity, tiles);
+}
+
+
+
+void smoke_3D::initialize(int N)
+{
+    int3 const dimension = {N, N, N};
+    velocity.current().resize(dimension);
+    velocity.previous().resize(dimension);
+    density.current().resize(dimension);
+    density.previous().resize(dimension);
+    pressure.resize(dimension);
+    divergence.resize(dimension);
+    padded_scalar.clear();
+    padded_vector.clear();
+    tiles.clear();
+}
+
+void smoke_3D::update_active_tiles()
+{
+    int constexpr S = sparse_grid_3D<float>::tile_size;
+    sparse_grid_3D<float> const& d = density.current();
+    int3 const T = d.tile_dimension;
+
+    // Tiles containing smoke
+    grid_3D<int> needed(T.x, T.y, T.z);
+    needed.fill(0);
+    for(int3 const& tile : tiles) {
+        grid_3D<float> const& d_tile = d.tile(d.tile_storage(tile));
+        bool active = false;
+        for(size_t k=0; k<d_tile.size() && !active; ++k)
+            active = d_tile[k]>parameters.threshold_density;
+        if(active)
+            needed(tile.x, tile.y, tile.z) = 1;
+    }
+
+    // Tiles of the source
+    int const N = d.dimension.x;
+    vec3 const center = parameters.source_center*float(N);
+    float const radius = parameters.source_radius*N;
+    for(int tz=std::max(int(center.z-radius)/S,0); tz<=std::min(int(center.z+radius)/S,T.z-1); ++tz)
+        for(int ty=std::max(int(center.y-radius)/S,0); ty<=std::min(int(center.y+radius)/S,T.y-1); ++ty)
+            for(int tx=std::max(int(center.x-radius)/S,0); tx<=std::min(int(center.x+radius)/S,T.x-1); ++tx)
+                needed(tx, ty, tz) = 1;
+
+    // Layer of tiles around them: the smoke can be advected or diffused in these tiles during the step
+    tile_list next_tiles;
+    for(int tz=0; tz<T.z; ++tz) {
+        for(int ty=0; ty<T.y; ++ty) {
+            for(int tx=0; tx<T.x; ++tx) {
+                bool close = false;
+                for(int dz=-1; dz<=1 && !close; ++dz)
+                    for(int dy=-1; dy<=1 && !close; ++dy)
+                        for(int dx=-1; dx<=1 && !close; ++dx) {
+                            int const x = tx+dx, y = ty+dy, z = tz+dz;
+                            close = x>=0 && y>=0 && z>=0 && x<T.x && y<T.y && z<T.z && needed(x,y,z)==1;
+                        }
+                if(close)
+                    next_tiles.push_back({tx, ty, tz});
+            }
+        }
+    }
+
+    // Release the tiles that are not used anymore, allocate the new ones (all the fields share the same tiles)
+    grid_3D<int> kept(T.x, T.y, T.z);
+    kept.fill(0);
+    for(int3 const& tile : next_tiles)
+        kept(tile.x, tile.y, tile.z) = 1;
+    for(int3 const& tile : tiles) {
+        if(kept(tile.x, tile.y, tile.z)==0) {
+            velocity.current().release(tile);  velocity.previous().release(tile);
+            density.current().release(tile);   density.previous().release(tile);
+            pressure.release(tile);            divergence.release(tile);
+        }
+    }
+    for(int3 const& tile : next_tiles) {
+        velocity.current().allocate(tile);  velocity.previous().allocate(tile);
+        density.current().allocate(tile);   density.previous().allocate(tile);
+        pressure.allocate(tile);            divergence.allocate(tile);
+    }
+    tiles = next_tiles;
+}
+
+void smoke_3D::add_forces(float dt)
+{
+    // Emitter: density and upward velocity imposed in the sphere, buoyancy of the smoke everywhere
+    int constexpr S = sparse_grid_3D<float>::tile_size;
+    int const N = size();
+    vec3 const center = parameters.source_center*float(N);
+    float const radius = parameters.source_radius*N;
+    float const source_velocity = parameters.source_velocity*N;
+    float const buoyancy = parameters.buoyancy*N;
+
+    sparse_grid_3D<float>& d = density.current();
+    sparse_grid_3D<vec3>& v = velocity.current();
+    for_each_tile(d, tiles, [&](int3 const& tile, int storage) {
+        grid_3D<float>& d_tile = d.tile(storage);
+        grid_3D<vec3>& v_tile = v.tile(v.tile_storage(tile));
+        for(int kz=0; kz<S; ++kz) {
+            for(int ky=0; ky<S; ++ky) {
+                for(int kx=0; kx<S; ++kx) {
+                    vec3 const p = {float(tile.x*S+kx), float(tile.y*S+ky), float(tile.z*S+kz)};
+                    if(!interior_cell(int(p.x), int(p.y), int(p.z), d.dimension))
+                        continue;
+                    int const o = sparse_grid_3D<float>::offset(kx, ky, kz);
+                    if(norm(p-center)<radius) {
+                        d_tile[o] = std::max(d_tile[o], parameters.source_density);
+                        v_tile[o].y = std::max(v_tile[o].y, source_velocity);
+                    }
+                    v_tile[o].y += dt*buoyancy*d_tile[o];
+                }
+            }
+        }
+    });
+}
+
+void smoke_3D::simulate(float dt)
+{
+    update_active_tiles();
+    add_forces(dt);
+
+    // velocity
+    diffuse(velocity, parameters.diffusion_velocity, dt, parameters.diffusion_iterations, tiles, padded_vector);
+    divergence_free(velocity.current(), divergence, pressure, parameters.pressure_iterations, tiles, padded_scalar);
+    advect(velocity, dt, tiles);
+
+    // density
+    diffuse(density, parameters.diffusion_density, dt, parameters.diffusion_iterations, tiles, padded_scalar);
+    advect(density, velocity.current(), dt, tiles);
+}
+
+size_t smoke_3D::memory() const
+{
+    return velocity.current().memory() + velocity.previous().memory() + density.current().memory() + density.previous().memory()
+        + pressure.memory() + divergence.memory();
+}
+
+void smoke_3D::project_density(grid_2D<float>& density_xy) const
+{
+    int constexpr S = sparse_grid_3D<float>::tile_size;
+    int const N = size();
+    density_xy.resize(N, N);
+    density_xy.fill(0.0f);
+    sparse_grid_3D<float> const& d = density.current();
+    for(int3 const& tile : tiles) {
+        grid_3D<float> const& d_tile = d.tile(d.tile_storage(tile));
+        for(int kz=0; kz<S; ++kz)
+            for(int ky=0; ky<S; ++ky)
+                for(int kx=0; kx<S; ++kx)
+                    if(tile.x*S+kx<N && tile.y*S+ky<N && tile.z*S+kz<N)
+                        density_xy(tile.x*S+kx, tile.y*S+ky) += d_tile[sparse_grid_3D<float>::offset(kx, ky, kz)];
+    }
+}
+
+void smoke_3D::slice_velocity(grid_2D<vec2>& velocity_xy) const
+{
+    int const N = size();
+    velocity_xy.resize(N, N);
+    for(int y=0; y<N; ++y) {
+        for(int x=0; x<N; ++x) {
+            vec3 const v = velocity.current().value(x, y, N/2);
+            velocity_xy(x,y) = {v.x, v.y};
+        }
+    }
+}
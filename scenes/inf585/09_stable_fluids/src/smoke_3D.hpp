@@ -0,0 +1,286 @@
+#pragma once
+
+#include "vcl/vcl.hpp"
+#include "sparse_grid_3D.hpp"
+#include "double_buffer.hpp"
+
+#include <vector>
+
+
+// 3D stable fluids (smoke) on sparse tiles
+//  Same scheme as the 2D scene: collocated velocity (cells/s), implicit diffusion and pressure solved by red-black relaxation
+//  sweeps, semi-Lagrangian advection. The cells on the faces of the domain are the boundary layer (copy of the density,
+//  reflection of the normal velocity, Neumann condition of the pressure).
+//  Only the tiles containing smoke (density above a threshold), and the tiles around them, are allocated and simulated:
+//  outside of them the density, the velocity and the pressure are 0 (open air around the smoke, the motion of the air far
+//  from the smoke is not simulated).
+//  The layer of tiles around the smoke bounds the motion per step: the back-tracing is limited to tile_size-1 cells.
+
+using tile_list = std::vector<vcl::int3>;
+// Work storage of the relaxation: copy of each tile with a layer of its neighbor cells (one per tile of the list)
+template <typename T> using padded_tiles = std::vector<vcl::grid_3D<T>>;
+
+// Red-black relaxation of  x = w_neighbors * (sum of the 6 neighbors) + w_b * b  on the interior cells of the tiles
+//  The first half sweep reads x_initial (can be x), the boundary condition is applied after each sweep
+//  padded: work storage kept by the caller, resized to the number of tiles
+template <typename T, typename BOUNDARY>
+void relax(sparse_grid_3D<T>& x, sparse_grid_3D<T> const& x_initial, sparse_grid_3D<T> const& b, float w_neighbors, float w_b, int sweeps, tile_list const& tiles, padded_tiles<T>& padded, BOUNDARY const& set_boundary_condition);
+
+template <typename T> void set_boundary(sparse_grid_3D<T>& grid, tile_list const& tiles);
+void set_boundary_reflective(sparse_grid_3D<vcl::vec3>& velocity, tile_list const& tiles);
+// Boundary condition of each field: copy for the density, reflection of the normal component for the velocity
+inline void set_boundary_condition(sparse_grid_3D<float>& density, tile_list const& tiles) { set_boundary(density, tiles); }
+inline void set_boundary_condition(sparse_grid_3D<vcl::vec3>& velocity, tile_list const& tiles) { set_boundary_reflective(velocity, tiles); }
+
+// Trilinear interpolation at p (cell coordinates), the position is clamped to the domain
+template <typename T> T interpolation_trilinear(sparse_grid_3D<T> const& value, vcl::vec3 const& p);
+
+// Steps on double-buffered fields (density or velocity): current() is computed from previous() on the given tiles
+template <typename T> void diffuse(double_buffer<sparse_grid_3D<T>>& field, float mu, float dt, int iterations, tile_list const& tiles, padded_tiles<T>& padded);
+template <typename T> void advect(sparse_grid_3D<T>& new_value, sparse_grid_3D<T> const& value_reference, sparse_grid_3D<vcl::vec3> const& velocity, float dt, tile_list const& tiles);
+template <typename T> void advect(double_buffer<sparse_grid_3D<T>>& field, sparse_grid_3D<vcl::vec3> const& velocity, float dt, tile_list const& tiles);
+void advect(double_buffer<sparse_grid_3D<vcl::vec3>>& velocity, float dt, tile_list const& tiles);
+// Projection of the velocity (in place), pressure is the initial guess and keeps the solution
+void divergence_free(sparse_grid_3D<vcl::vec3>& velocity, sparse_grid_3D<float>& divergence, sparse_grid_3D<float>& pressure, int iterations, tile_list const& tiles, padded_tiles<float>& padded);
+
+
+struct smoke_3D_parameters
+{
+    float diffusion_velocity = 1e-6f;
+    float diffusion_density = 1e-6f;
+    int diffusion_iterations = 4;
+    int pressure_iterations = 20;
+    float buoyancy = 0.02f;             // Upward acceleration per unit of density, relative to the size of the domain per s^2
+
+    float threshold_density = 1e-3f;    // A tile stays active while it contains a density above this value
+
+    // Emitter of smoke: sphere at the bottom of the domain (relative coordinates)
+    vcl::vec3 source_center = {0.5f, 0.1f, 0.5f};
+    float source_radius = 0.05f;
+    float source_density = 1.0f;        // Density set in the sphere
+    float source_velocity = 0.1f;       // Upward velocity in the sphere, relative to the size of the domain per second
+};
+
+struct smoke_3D
+{
+    smoke_3D_parameters parameters;
+
+    double_buffer<sparse_grid_3D<vcl::vec3>> velocity;
+    double_buffer<sparse_grid_3D<float>> density;
+    sparse_grid_3D<float> pressure;
+    sparse_grid_3D<float> divergence;
+    padded_tiles<float> padded_scalar;     // Work storage of the relaxations of the density and the pressure
+    padded_tiles<vcl::vec3> padded_vector; // Work storage of the relaxation of the velocity
+
+    // Domain of N x N x N cells, without any smoke
+    void initialize(int N);
+    void simulate(float dt);
+
+    int size() const { return density.current().dimension.x; }
+    tile_list const& active_tiles() const { return tiles; }
+    // Memory of the allocated tiles of all the fields (bytes)
+    size_t memory() const;
+
+    // Sum of the density along z (smoke seen from the front), and velocity (x,y) of the slice z=N/2
+    void project_density(vcl::grid_2D<float>& density_xy) const;
+    void slice_velocity(vcl::grid_2D<vcl::vec2>& velocity_xy) const;
+
+private:
+    tile_list tiles;
+
+    void add_forces(float dt); // Emitter and buoyancy
+    // Set of tiles of the next step: tiles containing smoke, the source, and one layer of tiles around them
+    void update_active_tiles();
+};
+
+
+
+
+// Apply f(tile, storage) on the tiles in parallel (the tiles are allocated in the grid)
+template <typename T, typename FUNCTION>
+void for_each_tile(sparse_grid_3D<T> const& grid, tile_list const& tiles, FUNCTION const& f)
+{
+    #pragma omp parallel for schedule(dynamic)
+    for(int k=0; k<int(tiles.size()); ++k)
+        f(tiles[k], grid.tile_storage(tiles[k]));
+}
+
+// Cell of the domain that is not on its faces
+inline bool interior_cell(int x, int y, int z, vcl::int3 const& N)
+{
+    return x>0 && y>0 && z>0 && x<N.x-1 && y<N.y-1 && z<N.z-1;
+}
+
+// Tile containing cells on the faces of the domain (or outside of it)
+inline bool boundary_tile(vcl::int3 const& tile, int tile_size, vcl::int3 const& N)
+{
+    return tile.x==0 || tile.y==0 || tile.z==0 || (tile.x+1)*tile_size>N.x-1 || (tile.y+1)*tile_size>N.y-1 || (tile.z+1)*tile_size>N.z-1;
+}
+
+template <typename T, typename BOUNDARY>
+void relax(sparse_grid_3D<T>& x, sparse_grid_3D<T> const& x_initial, sparse_grid_3D<T> const& b, float w_neighbors, float w_b, int sweeps, tile_list const& tiles, padded_tiles<T>& padded, BOUNDARY const& set_boundary_condition)
+{
+    static_assert(sizeof(T)%sizeof(float)==0, "The relaxation applies to grids of float or vec3");
+    int constexpr D = int(sizeof(T)/sizeof(float)); // The cells are processed as D floats (as the 2D relaxation)
+    int constexpr S = sparse_grid_3D<T>::tile_size;
+    int constexpr P = S+2; // Size of the padded tiles
+    vcl::int3 const N = x.dimension;
+
+    if(sweeps<=0 && &x!=&x_initial) {
+        for(vcl::int3 const& tile : tiles)
+            x.tile(x.tile_storage(tile)) = x_initial.tile(x_initial.tile_storage(tile));
+        return;
+    }
+
+    // Values of the tiles and of their neighbor cells: the update of a color only reads these copies (no race between the tiles)
+    //  Shared by the threads of the loops below (one block per tile): it is sized here, before the parallel regions
+    padded.resize(tiles.size());
+
+    for(int k_sweep=0; k_sweep<sweeps; ++k_sweep) {
+        for(int color=0; color<2; ++color) {
+            sparse_grid_3D<T> const& x_read = (k_sweep==0 && color==0) ? x_initial : x;
+            #pragma omp parallel for schedule(dynamic)
+            for(int k=0; k<int(tiles.size()); ++k)
+                x_read.gather_padded(tiles[k], padded[k]);
+
+            // The first half sweep also copies the cells that are not updated (other color and boundary) from x_initial
+            bool const copy_initial = &x_read!=&x;
+            #pragma omp parallel for schedule(dynamic)
+            for(int k=0; k<int(tiles.size()); ++k) {
+                vcl::int3 const& tile = tiles[k];
+                float* px = reinterpret_cast<float*>(&x.tile(x.tile_storage(tile))[0]);
+                float const* pb = reinterpret_cast<float const*>(&b.tile(b.tile_storage(tile))[0]);
+                float const* pp = reinterpret_cast<float const*>(&padded[k][0]);
+                int const x0 = tile.x*S, y0 = tile.y*S, z0 = tile.z*S;
+                int const kx_begin = std::max(0, 1-x0), kx_end = std::min(S, N.x-1-x0);
+                for(int kz=0; kz<S; ++kz) {
+                    for(int ky=0; ky<S; ++ky) {
+                        int const o = D*sparse_grid_3D<T>::offset(0, ky, kz);
+                        int const q = D*(1 + P*((ky+1) + P*(kz+1)));
+                        if(copy_initial)
+                            for(int c=0; c<D*S; ++c)
+                                px[o+c] = pp[q+c];
+
+                        int const gy = y0+ky, gz = z0+kz;
+                        if(gy<1 || gz<1 || gy>N.y-2 || gz>N.z-2)
+                            continue;
+                        // Cells of the row with (x+y+z)%2==color
+                        int const kx_first = kx_begin + ((x0+kx_begin+gy+gz+color)%2);
+                        for(int kx=kx_first; kx<kx_end; kx+=2) {
+                            for(int c=0; c<D; ++c) {
+                                int const i = D*kx+c;
+                                float const sum = pp[q+i-D]+pp[q+i+D] + pp[q+i-D*P]+pp[q+i+D*P] + pp[q+i-D*P*P]+pp[q+i+D*P*P];
+                                px[o+i] = w_neighbors*sum + w_b*pb[o+i];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        set_boundary_condition(x);
+    }
+}
+
+template <typename T>
+void set_boundary(sparse_grid_3D<T>& grid, tile_list const& tiles)
+{
+    // A cell on a face of the domain copies the closest interior cell (diagonal neighbor for the edges and the corners)
+    int constexpr S = sparse_grid_3D<T>::tile_size;
+    vcl::int3 const N = grid.dimension;
+    for_each_tile(grid, tiles, [&](vcl::int3 const& tile, int storage) {
+        if(!boundary_tile(tile, S, N))
+            return;
+        vcl::grid_3D<T>& values = grid.tile(storage);
+        for(int kz=0; kz<S; ++kz) {
+            for(int ky=0; ky<S; ++ky) {
+                for(int kx=0; kx<S; ++kx) {
+                    int const gx = tile.x*S+kx, gy = tile.y*S+ky, gz = tile.z*S+kz;
+                    if(gx>=N.x || gy>=N.y || gz>=N.z || interior_cell(gx, gy, gz, N))
+                        continue;
+                    values[sparse_grid_3D<T>::offset(kx, ky, kz)] = grid.value(std::min(std::max(gx,1),N.x-2), std::min(std::max(gy,1),N.y-2), std::min(std::max(gz,1),N.z-2));
+                }
+            }
+        }
+    });
+}
+
+template <typename T>
+T interpolation_trilinear(sparse_grid_3D<T> const& value, vcl::vec3 const& p)
+{
+    float const x = std::min(std::max(p.x, 0.0f), value.dimension.x-1.001f);
+    float const y = std::min(std::max(p.y, 0.0f), value.dimension.y-1.001f);
+    float const z = std::min(std::max(p.z, 0.0f), value.dimension.z-1.001f);
+    int const x0 = int(x), y0 = int(y), z0 = int(z);
+    float const dx = x-x0, dy = y-y0, dz = z-z0;
+
+    // The 8 cells are in the same tile: direct read of its values
+    int constexpr S = sparse_grid_3D<T>::tile_size;
+    int const ix = x0%S, iy = y0%S, iz = z0%S;
+    if(ix<S-1 && iy<S-1 && iz<S-1) {
+        int const storage = value.tile_storage({x0/S, y0/S, z0/S});
+        if(storage<0)
+            return value.background;
+        T const* p = &value.tile(storage)[sparse_grid_3D<T>::offset(ix, iy, iz)];
+        int const sy = S, sz = S*S;
+        T const w00 = (1-dx)*p[0]     + dx*p[1];
+        T const w10 = (1-dx)*p[sy]    + dx*p[sy+1];
+        T const w01 = (1-dx)*p[sz]    + dx*p[sz+1];
+        T const w11 = (1-dx)*p[sy+sz] + dx*p[sy+sz+1];
+        return (1-dz)*((1-dy)*w00 + dy*w10) + dz*((1-dy)*w01 + dy*w11);
+    }
+
+    T const v00 = (1-dx)*value.value(x0,y0,z0)     + dx*value.value(x0+1,y0,z0);
+    T const v10 = (1-dx)*value.value(x0,y0+1,z0)   + dx*value.value(x0+1,y0+1,z0);
+    T const v01 = (1-dx)*value.value(x0,y0,z0+1)   + dx*value.value(x0+1,y0,z0+1);
+    T const v11 = (1-dx)*value.value(x0,y0+1,z0+1) + dx*value.value(x0+1,y0+1,z0+1);
+    return (1-dz)*((1-dy)*v00 + dy*v10) + dz*((1-dy)*v01 + dy*v11);
+}
+
+template <typename T>
+void diffuse(double_buffer<sparse_grid_3D<T>>& field, float mu, float dt, int iterations, tile_list const& tiles, padded_tiles<T>& padded)
+{
+    // Implicit diffusion  f - a Laplacian(f) = f_prev, with the coefficient of the 2D scene (cells of size 1/(N-2))
+    field.swap();
+    sparse_grid_3D<T> const& field_reference = field.previous();
+    int const N = field_reference.dimension.x;
+    float const a = mu*dt*(N-2.0f)*(N-2.0f);
+    relax(field.current(), field_reference, field_reference, a/(1+6*a), 1/(1+6*a), iterations, tiles, padded, [&tiles](sparse_grid_3D<T>& f) {
+        set_boundary_condition(f, tiles);
+    });
+}
+
+template <typename T>
+void advect(sparse_grid_3D<T>& new_value, sparse_grid_3D<T> const& value_reference, sparse_grid_3D<vcl::vec3> const& velocity, float dt, tile_list const& tiles)
+{
+    // Back tracing of the interior cells, the values outside of the allocated tiles are 0
+    int constexpr S = sparse_grid_3D<T>::tile_size;
+    float const d_max = S-1.0f;
+    vcl::int3 const N = new_value.dimension;
+    for_each_tile(new_value, tiles, [&](vcl::int3 const& tile, int storage) {
+        vcl::grid_3D<T>& values = new_value.tile(storage);
+        vcl::grid_3D<vcl::vec3> const& v = velocity.tile(velocity.tile_storage(tile));
+        for(int kz=0; kz<S; ++kz) {
+            for(int ky=0; ky<S; ++ky) {
+                for(int kx=0; kx<S; ++kx) {
+                    int const gx = tile.x*S+kx, gy = tile.y*S+ky, gz = tile.z*S+kz;
+                    if(!interior_cell(gx, gy, gz, N))
+                        continue;
+                    int const o = sparse_grid_3D<T>::offset(kx, ky, kz);
+                    vcl::vec3 d = dt*v[o];
+                    float const d_norm = vcl::norm(d);
+                    if(d_norm>d_max)
+                        d *= d_max/d_norm;
+                    values[o] = interpolation_trilinear(value_reference, vcl::vec3(float(gx),float(gy),float(gz))-d);
+                }
+            }
+        }
+    });
+    set_boundary_condition(new_value, tiles);
+}
+
+template <typename T>
+void advect(double_buffer<sparse_grid_3D<T>>& field, sparse_grid_3D<vcl::vec3> const& velocity, float dt, tile_list const& tiles)
+{
+    field.swap();
+    advect(field.current(), field.previous(), velocity, dt, tiles);
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include "vcl/vcl.hpp"
+
+#include <vector>
+
+
+// Sparse 3D grid of Nx x Ny x Nz cells stored as tiles of tile_size^3 cells
+//  Only the allocated tiles store values (each one is a grid_3D<T>), the cells of the other tiles have the value background.
+//  The tiles are found through a dense grid_3D<int> of the tile coordinates (index of the storage or -1): its size is the number
+//  of cells divided by tile_size^3, a 256^3 domain only needs 32^3 indices.
+//  The storage of the released tiles is kept and reused by the next allocations.
+template <typename T>
+struct sparse_grid_3D
+{
+    static int constexpr tile_size = 8;
+    static int constexpr tile_cells = tile_size*tile_size*tile_size;
+
+    vcl::int3 dimension;          // Number of cells in each direction
+    vcl::int3 tile_dimension;     // Number of tiles in each direction
+    T background = {};            // Value of the cells of the unallocated tiles
+
+    // Remove all the tiles and set the number of cells (multiple of tile_size or not)
+    void resize(vcl::int3 const& dimension);
+    void clear_tiles();
+
+    // Tiles given by their tile coordinates
+    int tile_storage(vcl::int3 const& tile) const; // Index of the storage, -1 if not allocated or outside of the domain
+    bool allocated(vcl::int3 const& tile) const { return tile_storage(tile)>=0; }
+    int allocate(vcl::int3 const& tile);           // Allocate the tile filled with background (nothing is done if it exists)
+    void release(vcl::int3 const& tile);
+
+    // Values of an allocated tile (local coordinates in [0,tile_size[)
+    vcl::grid_3D<T>& tile(int storage) { return tiles[storage]; }
+    vcl::grid_3D<T> const& tile(int storage) const { return tiles[storage]; }
+    // Offset of the local coordinates (i,j,k) in the values of a tile (same layout as grid_3D, inlined for the loops over the cells)
+    static int offset(int i, int j, int k) { return i + tile_size*(j + tile_size*k); }
+
+    // Value of the cell (x,y,z): background if the tile is not allocated or if the cell is outside of the domain
+    T value(int x, int y, int z) const;
+    // Write access to the cell (x,y,z), the tile must be allocated
+    T& operator()(int x, int y, int z);
+
+    // Copy the values of the tile and of a layer of one cell around it in padded ((tile_size+2)^3 cells)
+    void gather_padded(vcl::int3 const& tile, vcl::grid_3D<T>& padded) const;
+
+    // Coordinates of the allocated tiles
+    std::vector<vcl::int3> allocated_tiles() const;
+    int tile_count() const { return int(tiles.size()-free_storage.size()); }
+    // Memory used by the values of the allocated tiles and by the index (bytes)
+    size_t memory() const;
+
+private:
+    vcl::grid_3D<int> tile_index;
+    std::vector<vcl::grid_3D<T>> tiles;
+    std::vector<vcl::int3> tile_coordinates; // Tile coordinates of each storage ({-1,-1,-1} when released)
+    std::vector<int> free_storage;
+};
+
+
+
+
+template <typename T>
+void sparse_grid_3D<T>::resize(vcl::int3 const& dimension_arg)
+{
+    dimension = dimension_arg;
+    tile_dimension = { (dimension.x+tile_size-1)/tile_size, (dimension.y+tile_size-1)/tile_size, (dimension.z+tile_size-1)/tile_size };
+    tile_index.resize(tile_dimension.x, tile_dimension.y, tile_dimension.z);
+    clear_tiles();
+}
+
+template <typename T>
+void sparse_grid_3D<T>::clear_tiles()
+{
+    tile_index.fill(-1);
+    tiles.clear();
+    tile_coordinates.clear();
+    free_storage.clear();
+}
+
+template <typename T>
+int sparse_grid_3D<T>::tile_storage(vcl::int3 const& tile) const
+{
+    if(tile.x<0 || tile.y<0 || tile.z<0 || tile.x>=tile_dimension.x || tile.y>=tile_dimension.y || tile.z>=tile_dimension.z)
+        return -1;
+    return tile_index[tile.x + tile_dimension.x*(tile.y + tile_dimension.y*tile.z)];
+}
+
+template <typename T>
+int sparse_grid_3D<T>::allocate(vcl::int3 const& tile)
+{
+    int storage = tile_index(tile.x, tile.y, tile.z);
+    if(storage>=0)
+        return storage;
+
+    if(free_storage.empty()) {
+        storage = int(tiles.size());
+        tiles.push_back(vcl::grid_3D<T>(tile_size, tile_size, tile_size));
+        tile_coordinates.push_back(tile);
+    }
+    else {
+        storage = free_storage.back();
+        free_storage.pop_back();
+        tile_coordinates[storage] = tile;
+    }
+    tiles[storage].fill(background);
+    tile_index(tile.x, tile.y, tile.z) = storage;
+    return storage;
+}
+
+template <typename T>
+void sparse_grid_3D<T>::release(vcl::int3 const& tile)
+{
+    int const storage = tile_storage(tile);
+    if(storage<0)
+        return;
+    tile_index(tile.x, tile.y, tile.z) = -1;
+    tile_coordinates[storage] = {-1,-1,-1};
+    free_storage.push_back(storage);
+}
+
+template <typename T>
+T sparse_grid_3D<T>::value(int x, int y, int z) const
+{
+    if(x<0 || y<0 || z<0 || x>=dimension.x || y>=dimension.y || z>=dimension.z)
+        return background;
+    int const storage = tile_index[x/tile_size + tile_dimension.x*(y/tile_size + tile_dimension.y*(z/tile_size))];
+    if(storage<0)
+        return background;
+    return tiles[storage][offset(x%tile_size, y%tile_size, z%tile_size)];
+}
+
+template <typename T>
+T& sparse_grid_3D<T>::operator()(int x, int y, int z)
+{
+    int const storage = tile_index(x/tile_size, y/tile_size, z/tile_size);
+    assert_vcl(storage>=0, "Write access to a cell of an unallocated tile");
+    return tiles[storage][offset(x%tile_size, y%tile_size, z%tile_size)];
+}
+
+template <typename T>
+void sparse_grid_3D<T>::gather_padded(vcl::int3 const& tile, vcl::grid_3D<T>& padded) const
+{
+    int const P = tile_size+2;
+    if(int(padded.dimension.x)!=P)
+        padded.resize(P, P, P);
+    T* q = &padded[0];
+    auto padded_offset = [P](int i, int j, int k) { return i + P*(j + P*k); };
+
+    // Interior: direct copy of the rows of the tile
+    int const storage = tile_storage(tile);
+    for(int k=0; k<tile_size; ++k) {
+        for(int j=0; j<tile_size; ++j) {
+            T* row = q + padded_offset(1, j+1, k+1);
+            if(storage>=0) {
+                T const* source = &tiles[storage][offset(0, j, k)];
+                for(int i=0; i<tile_size; ++i)
+                    row[i] = source[i];
+            }
+            else
+                for(int i=0; i<tile_size; ++i)
+                    row[i] = background;
+        }
+    }
+
+    // Layer around the tile: faces of the 6 neighbor tiles (background outside of the domain or for unallocated tiles)
+    //  The edges and corners of the padded block are not used by the 7-point stencils
+    int const L = tile_size-1;
+    int const s_x0 = tile_storage({tile.x-1,tile.y,tile.z}), s_x1 = tile_storage({tile.x+1,tile.y,tile.z});
+    int const s_y0 = tile_storage({tile.x,tile.y-1,tile.z}), s_y1 = tile_storage({tile.x,tile.y+1,tile.z});
+    int const s_z0 = tile_storage({tile.x,tile.y,tile.z-1}), s_z1 = tile_storage({tile.x,tile.y,tile.z+1});
+    for(int a=0; a<tile_size; ++a) {
+        for(int b=0; b<tile_size; ++b) {
+            q[padded_offset(0,a+1,b+1)]   = s_x0>=0 ? tiles[s_x0][offset(L,a,b)] : background;
+            q[padded_offset(P-1,a+1,b+1)] = s_x1>=0 ? tiles[s_x1][offset(0,a,b)] : background;
+            q[padded_offset(a+1,0,b+1)]   = s_y0>=0 ? tiles[s_y0][offset(a,L,b)] : background;
+            q[padded_offset(a+1,P-1,b+1)] = s_y1>=0 ? tiles[s_y1][offset(a,0,b)] : background;
+            q[padded_offset(a+1,b+1,0)]   = s_z0>=0 ? tiles[s_z0][offset(a,b,L)] : background;
+            q[padded_offset(a+1,b+1,P-1)] = s_z1>=0 ? tiles[s_z1][offset(a,b,0)] : background;
+        }
+    }
+}
+
+template <typename T>
+std::vector<vcl::int3> sparse_grid_3D<T>::allocated_tiles() const
+{
+    std::vector<vcl::int3> allocated;
+    for(vcl::int3 const& tile : tile_coordinates)
+        if(tile.x>=0)
+            allocated.push_back(tile);
+    return allocated;
+}
+
+template <typename T>
+size_t sparse_grid_3D<T>::memory() const
+{
+    return tiles.size()*tile_cells*sizeof(T) + tile_index.size()*sizeof(int);
+}
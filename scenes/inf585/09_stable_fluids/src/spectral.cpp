@@ -0,0 +1,82 @@
+#include "spectral.hpp"
+
+using namespace vcl;
+
+using complex = std::complex<float>;
+
+
+void spectral_solver::resize(int N)
+{
+    fft.resize(N);
+    if(int(component.dimension.x)!=N || int(component.dimension.y)!=N)
+        component.resize(N, N);
+}
+
+void diffuse_spectrum(grid_2D<complex>& spectrum, float a)
+{
+    // Eigenvalues of the periodic 5-point -Laplacian: 4 sin^2(pi kx/N) + 4 sin^2(pi ky/N)
+    int const Kx = int(spectrum.dimension.x);
+    int const N = int(spectrum.dimension.y);
+    float const pi = 3.14159265358979f;
+    for(int ky=0; ky<N; ++ky) {
+        float const sy = std::sin(pi*ky/N);
+        for(int kx=0; kx<Kx; ++kx) {
+            float const sx = std::sin(pi*kx/N);
+            spectrum(kx,ky) /= 1.0f + 4*a*(sx*sx + sy*sy);
+        }
+    }
+}
+
+void divergence_free(grid_2D<vec2>& velocity, spectral_solver& spectral, float mu, float dt)
+{
+    int const N = int(velocity.dimension.x);
+    spectral.resize(N);
+    float* c = &spectral.component.data.data[0];
+
+    // Transforms of the two components
+    for(int k=0; k<N*N; ++k)
+        c[k] = velocity.data.data[k].x;
+    spectral.fft.forward(spectral.component, spectral.spectrum_u);
+    for(int k=0; k<N*N; ++k)
+        c[k] = velocity.data.data[k].y;
+    spectral.fft.forward(spectral.component, spectral.spectrum_v);
+
+    if(mu>0) {
+        float const a = mu*dt*N*N;
+        diffuse_spectrum(spectral.spectrum_u, a);
+        diffuse_spectrum(spectral.spectrum_v, a);
+    }
+
+    // The central differences have the symbol i*s with s = (sin(2 pi kx/N), sin(2 pi ky/N)):
+    //  the divergence i s.u is removed by u = u - s (s.u)/|s|^2, which is the exact solution of the pressure equation.
+    //  The modes with s=0 (mean flow, Nyquist frequencies) are not seen by the central divergence and are kept.
+    int const Kx = int(spectral.spectrum_u.dimension.x);
+    float const pi = 3.14159265358979f;
+    for(int ky=0; ky<N; ++ky) {
+        float const sy = std::sin(2*pi*ky/N);
+        for(int kx=0; kx<Kx; ++kx) {
+            float const sx = std::sin(2*pi*kx/N);
+            float const s2 = sx*sx + sy*sy;
+            if(s2<1e-12f)
+                continue;
+            complex& u = spectral.spectrum_u(kx,ky);
+            complex& v = spectral.spectrum_v(kx,ky);
+            complex const projection = (sx*u + sy*v)/s2;
+            u -= sx*projection;
+            v -= sy*projection;
+        }
+    }
+
+    spectral.fft.inverse(spectral.spectrum_u, spectral.component);
+    for(int k=0; k<N*N; ++k)
+        velocity.data.data[k].x = c[k];
+    spectral.fft.inverse(spectral.spectrum_v, spectral.component);
+    for(int k=0; k<N*N; ++k)
+        velocity.data.data[k].y = c[k];
+}
+
+void advect_periodic(double_buffer<grid_2D<vec2>>& velocity, float dt)
+{
+    velocity.swap();
+    advect_periodic(velocity.current(), velocity.previous(), velocity.previous(), dt);
+}
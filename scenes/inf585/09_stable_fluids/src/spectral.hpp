@@ -0,0 +1,103 @@
+#pragma once
+
+#include "vcl/vcl.hpp"
+#include "fft.hpp"
+#include "double_buffer.hpp"
+
+
+// Spectral steps of the stable fluids on a periodic domain of N x N cells (N power of two)
+//  All the cells are fluid cells and the domain wraps around (no boundary layer). The implicit diffusion and the projection
+//  are diagonal in Fourier space: they are solved exactly with one forward and one inverse FFT per component, at a fixed cost
+//  that does not depend on a tolerance or a number of iterations.
+//  The symbols are the ones of the finite differences of the iterative solvers (5-point Laplacian, central divergence and
+//  gradient), the result is the converged solution of the same discrete equations with periodic conditions.
+struct spectral_solver
+{
+    fft_2D fft;
+    vcl::grid_2D<float> component;
+    vcl::grid_2D<std::complex<float>> spectrum_u, spectrum_v;
+
+    void resize(int N);
+};
+
+// Implicit diffusion  f - a Laplacian(f) = f_prev  solved exactly (in place, T=float, vec2 or vec3)
+template <typename T> void diffuse(vcl::grid_2D<T>& field, float mu, float dt, spectral_solver& spectral);
+// Projection of the velocity on the fields with a zero central divergence. If mu>0, the diffusion of the velocity is applied
+//  in the same transforms.
+void divergence_free(vcl::grid_2D<vcl::vec2>& velocity, spectral_solver& spectral, float mu = 0.0f, float dt = 0.0f);
+
+// Semi-Lagrangian advection with periodic wrap of the back-traced positions
+template <typename T> void advect_periodic(vcl::grid_2D<T>& new_value, vcl::grid_2D<T> const& value_reference, vcl::grid_2D<vcl::vec2> const& velocity, float dt);
+template <typename T> void advect_periodic(double_buffer<vcl::grid_2D<T>>& field, vcl::grid_2D<vcl::vec2> const& velocity, float dt);
+void advect_periodic(double_buffer<vcl::grid_2D<vcl::vec2>>& velocity, float dt);
+
+// Bilinear interpolation with periodic wrap of the coordinates
+template <typename T> T interpolation_bilinear_periodic(vcl::grid_2D<T> const& f, float x, float y);
+
+// Scaling of the spectrum of the implicit diffusion 1/(1+a*lambda(kx,ky)) with lambda the eigenvalues of -Laplacian
+void diffuse_spectrum(vcl::grid_2D<std::complex<float>>& spectrum, float a);
+
+
+
+
+template <typename T>
+void diffuse(vcl::grid_2D<T>& field, float mu, float dt, spectral_solver& spectral)
+{
+    using namespace vcl;
+    int constexpr D = int(sizeof(T)/sizeof(float)); // The cells are processed as D floats
+    int const N = int(field.dimension.x);
+    spectral.resize(N);
+
+    // The diffusion coefficient is expressed in the unit domain: cells of size 1/N
+    float const a = mu*dt*N*N;
+    float* values = reinterpret_cast<float*>(&field.data.data[0]);
+    float* c = &spectral.component.data.data[0];
+    for(int d=0; d<D; ++d) {
+        for(int k=0; k<N*N; ++k)
+            c[k] = values[D*k+d];
+        spectral.fft.forward(spectral.component, spectral.spectrum_u);
+        diffuse_spectrum(spectral.spectrum_u, a);
+        spectral.fft.inverse(spectral.spectrum_u, spectral.component);
+        for(int k=0; k<N*N; ++k)
+            values[D*k+d] = c[k];
+    }
+}
+
+template <typename T>
+T interpolation_bilinear_periodic(vcl::grid_2D<T> const& f, float x, float y)
+{
+    int const Nx = int(f.dimension.x);
+    int const Ny = int(f.dimension.y);
+    float const fx = std::floor(x), fy = std::floor(y);
+    float const dx = x-fx, dy = y-fy;
+    int x0 = int(fx)%Nx, y0 = int(fy)%Ny;
+    if(x0<0) x0 += Nx;
+    if(y0<0) y0 += Ny;
+    int const x1 = x0+1==Nx ? 0 : x0+1;
+    int const y1 = y0+1==Ny ? 0 : y0+1;
+
+    return (1-dx)*(1-dy)*f(x0,y0) + dx*(1-dy)*f(x1,y0) + (1-dx)*dy*f(x0,y1) + dx*dy*f(x1,y1);
+}
+
+template <typename T>
+void advect_periodic(vcl::grid_2D<T>& new_value, vcl::grid_2D<T> const& value_reference, vcl::grid_2D<vcl::vec2> const& velocity, float dt)
+{
+    using namespace vcl;
+    // All the cells are advected, the cell velocity is used directly (no staggered average is needed on a periodic grid)
+    int const N = int(new_value.dimension.x);
+
+    #pragma omp parallel for
+    for(int y=0; y<N; ++y) {
+        for(int x=0; x<N; ++x) {
+            vec2 const p_back = vec2(float(x),float(y)) - dt*velocity(x,y);
+            new_value(x,y) = interpolation_bilinear_periodic(value_reference, p_back.x, p_back.y);
+        }
+    }
+}
+
+template <typename T>
+void advect_periodic(double_buffer<vcl::grid_2D<T>>& field, vcl::grid_2D<vcl::vec2> const& velocity, float dt)
+{
+    field.swap();
+    advect_periodic(field.current(), field.previous(), velocity, dt);
+}
@@ -0,0 +1,88 @@
+#include "velocity_mac.hpp"
+
+using namespace vcl;
+
+
+void velocity_mac::resize(int N)
+{
+    u.clear();
+    u.resize(N+1, N);
+    v.clear();
+    v.resize(N, N+1);
+}
+
+void velocity_mac::fill(float value)
+{
+    u.fill(value);
+    v.fill(value);
+    set_boundary();
+}
+
+vec2 velocity_mac::at_cell(int i, int j) const
+{
+    return {0.5f*(u(i,j)+u(i+1,j)), 0.5f*(v(i,j)+v(i,j+1))};
+}
+
+vec2 velocity_mac::sample(vec2 const& p) const
+{
+    // Grid coordinates of the faces: u(i,j) is at x=i-0.5, v(i,j) at y=j-0.5
+    return {interpolation_bilinear_clamped(u, p.x+0.5f, p.y), interpolation_bilinear_clamped(v, p.x, p.y+0.5f)};
+}
+
+void velocity_mac::to_collocated(grid_2D<vec2>& velocity) const
+{
+    int const N = size();
+    velocity.resize(N, N);
+    #pragma omp parallel for
+    for(int j=0; j<N; ++j)
+        for(int i=0; i<N; ++i)
+            velocity(i,j) = at_cell(i,j);
+}
+
+void velocity_mac::add_collocated(grid_2D<vec2> const& velocity)
+{
+    int const N = size();
+    #pragma omp parallel for
+    for(int j=0; j<N; ++j)
+        for(int i=1; i<N; ++i)
+            u(i,j) += 0.5f*(velocity(i-1,j).x+velocity(i,j).x);
+    #pragma omp parallel for
+    for(int j=1; j<N; ++j)
+        for(int i=0; i<N; ++i)
+            v(i,j) += 0.5f*(velocity(i,j-1).y+velocity(i,j).y);
+    set_boundary();
+}
+
+void velocity_mac::set_boundary()
+{
+    set_boundary_u(u);
+    set_boundary_v(v);
+}
+
+void velocity_mac::set_boundary_u(grid_2D<float>& u)
+{
+    int const Nx = int(u.dimension.x); // N+1 faces along x
+    int const Ny = int(u.dimension.y); // N cells along y
+    for(int i=0; i<Nx; ++i) {
+        u(i,0)    = u(i,1);
+        u(i,Ny-1) = u(i,Ny-2);
+    }
+    for(int j=0; j<Ny; ++j) {
+        u(0,j) = 0.0f;    u(1,j) = 0.0f;
+        u(Nx-2,j) = 0.0f; u(Nx-1,j) = 0.0f;
+    }
+}
+
+void velocity_mac::set_boundary_v(grid_2D<float>& v)
+{
+    int const Nx = int(v.dimension.x); // N cells along x
+    int const Ny = int(v.dimension.y); // N+1 faces along y
+    for(int j=0; j<Ny; ++j) {
+        v(0,j)    = v(1,j);
+        v(Nx-1,j) = v(Nx-2,j);
+    }
+    for(int i=0; i<Nx; ++i) {
+        v(i,0) = 0.0f;    v(i,1) = 0.0f;
+        v(i,Ny-2) = 0.0f; v(i,Ny-1) = 0.0f;
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "vcl/vcl.hpp"
+
+
+// Staggered (MAC) velocity on the N x N cells of the stable fluids grids
+//  u(i,j): x-component at the center of the face between the cells (i-1,j) and (i,j), i.e. at (i-0.5, j) - grid of (N+1) x N
+//  v(i,j): y-component at (i, j-0.5) - grid of N x (N+1)
+//  The walls of the domain are the faces between the boundary cells and the interior cells: u(1,j), u(N-1,j), v(i,1), v(i,N-1) are 0.
+//  The divergence of a cell only involves its 4 faces: the pressure projection is exact for the 5-point Laplacian (no checkerboard),
+//  and the advection samples each component directly on its grid (no averaging of collocated velocities).
+struct velocity_mac
+{
+    vcl::grid_2D<float> u;
+    vcl::grid_2D<float> v;
+
+    // Allocate the faces of N x N cells (velocity set to 0)
+    void resize(int N);
+    // Number of cells in each direction
+    int size() const { return int(u.dimension.y); }
+    void fill(float value);
+
+    // Velocity at the cell center (i,j)
+    vcl::vec2 at_cell(int i, int j) const;
+    // Bilinear interpolation of each component at the position p (cell coordinates), clamped to the grids
+    vcl::vec2 sample(vcl::vec2 const& p) const;
+
+    // Collocated velocity at the cell centers (display, curl)
+    void to_collocated(vcl::grid_2D<vcl::vec2>& velocity) const;
+    // Add a collocated velocity interpolated on the faces (ex. mouse impulse), the walls stay at 0
+    void add_collocated(vcl::grid_2D<vcl::vec2> const& velocity);
+
+    // No flow through the walls, free slip along them (the faces in the boundary cells copy their neighbor)
+    void set_boundary();
+    static void set_boundary_u(vcl::grid_2D<float>& u);
+    static void set_boundary_v(vcl::grid_2D<float>& v);
+};
+
+
+// Bilinear interpolation of value at (x,y) (grid indices), the position is clamped to the grid
+template <typename T>
+T interpolation_bilinear_clamped(vcl::grid_2D<T> const& value, float x, float y)
+{
+    float const x_max = value.dimension.x-1.001f;
+    float const y_max = value.dimension.y-1.001f;
+    x = std::min(std::max(x, 0.0f), x_max);
+    y = std::min(std::max(y, 0.0f), y_max);
+
+    int const x0 = int(x);
+    int const y0 = int(y);
+    float const dx = x-x0;
+    float const dy = y-y0;
+
+    return (1-dx)*(1-dy)*value(x0,y0) + (1-dx)*dy*value(x0,y0+1) + dx*(1-dy)*value(x0+1,y0) + dx*dy*value(x0+1,y0+1);
+}
@@ -0,0 +1,367 @@
+#include "benchmark.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <cstring>
+
+using namespace vcl;
+
+
+// Fill the right half of the domain with N particles (approximately)
+//  The kernel size h is adapted to the number of particles (h=0.12 for the default scene with ~250 particles)
+template <typename particle_container>
+static void initialize_block(particle_container& particles, sph_parameters_structure& sph_parameters, size_t N)
+{
+    float const c = sph_parameters.c;
+    float const h = std::sqrt(2.0f/N)/c;
+    sph_parameters.h = h;
+    sph_parameters.m = sph_parameters.rho0*h*h;
+
+    particles.clear();
+    for(float x=h; x<1.0f-h; x=x+c*h) {
+        for(float y=-1.0f+h; y<1.0f-h; y=y+c*h) {
+            particle_element particle;
+            particle.p = {x+h/8.0*rand_interval(),y+h/8.0*rand_interval(),0};
+            particles.push_back(particle);
+        }
+    }
+}
+
+// Time in ms of the brute force evaluation of the density (all pairs) - reference for the O(N^2) cost
+static float time_density_all_pairs(particle_soa& particles, float h, float m)
+{
+    auto const t0 = std::chrono::steady_clock::now();
+    size_t const N = particles.size();
+    for(size_t i=0; i<N; ++i) {
+        float rho = 0.0f;
+        for(size_t j=0; j<N; ++j) {
+            float const r = norm(particles[i].p-particles[j].p);
+            if(r<h)
+                rho += m*315.0f/(64.0f*3.14159f*std::pow(h,9.0f))*std::pow(h*h-r*r,3.0f);
+        }
+        particles[i].rho = rho;
+    }
+    auto const t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<float, std::milli>(t1-t0).count();
+}
+
+// Field color evaluating all the particles at every pixel - reference for the splatting
+static void field_color_all_pairs(grid_2D<vec3>& field, particle_soa const& particles, float d)
+{
+    int const Nf = int(field.dimension.x);
+    for (int kx = 0; kx < Nf; ++kx) {
+        for (int ky = 0; ky < Nf; ++ky) {
+            float f = 0.0f;
+            vec3 const p0 = { 2.0f*(kx/(Nf-1.0f)-0.5f), 2.0f*(ky/(Nf-1.0f)-0.5f), 0.0f};
+            for (size_t k = 0; k < particles.size(); ++k) {
+                float const r = norm(particles[k].p-p0)/d;
+                f += 0.25f*std::exp(-r*r);
+            }
+            field(kx,Nf-1-ky) = vec3(clamp(1-f,0,1),clamp(1-f,0,1),1);
+        }
+    }
+}
+
+// Average time in ms of one call to simulate()
+template <typename particle_container>
+static float time_step(particle_container& particles, neighbor_list& neighbors, sph_parameters_structure const& sph_parameters, float dt, size_t N_steps)
+{
+    sph_solver_data solver;
+    simulate(dt, particles, neighbors, solver, sph_parameters); // warm-up (memory allocation)
+    auto const t0 = std::chrono::steady_clock::now();
+    for(size_t k=0; k<N_steps; ++k)
+        simulate(dt, particles, neighbors, solver, sph_parameters);
+    auto const t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<float, std::milli>(t1-t0).count()/N_steps;
+}
+
+void benchmark_sph()
+{
+    size_t const N_steps = 20;
+
+    std::cout<<std::setw(12)<<"particles"<<std::setw(16)<<"AoS step (ms)"<<std::setw(16)<<"SoA step (ms)"<<std::setw(20)<<"step/particle (us)"<<std::setw(26)<<"all-pairs density (ms)"<<std::endl;
+    for(size_t N_target : {1000, 4000, 16000, 64000, 256000})
+    {
+        sph_parameters_structure sph_parameters;
+        buffer<particle_element> particles_aos;
+        particle_soa particles;
+        neighbor_list neighbors_aos, neighbors;
+
+        // Same initial state for both storages
+        initialize_block(particles_aos, sph_parameters, N_target);
+        for(particle_element const& particle : particles_aos)
+            particles.push_back(particle);
+        float const dt = 0.005f * sph_parameters.h/0.12f; // time step scaled with the particle size to remain stable
+        neighbors_aos.skin = neighbors.skin = neighbors.skin * sph_parameters.h/0.12f;
+
+        float const t_aos = time_step(particles_aos, neighbors_aos, sph_parameters, dt, N_steps);
+        float const t_soa = time_step(particles, neighbors, sph_parameters, dt, N_steps);
+
+        std::cout<<std::setw(12)<<particles.size()<<std::setw(16)<<t_aos<<std::setw(16)<<t_soa<<std::setw(20)<<1000*t_soa/particles.size();
+        if(particles.size()<=16000)
+            std::cout<<std::setw(26)<<time_density_all_pairs(particles, sph_parameters.h, sph_parameters.m);
+        else
+            std::cout<<std::setw(26)<<"-";
+        std::cout<<std::endl;
+    }
+}
+
+void benchmark_sph_threads()
+{
+    size_t const N_target = 64000;
+    size_t const N_steps = 20;
+    int const thread_count_initial = parallel_thread_count();
+
+    sph_parameters_structure sph_parameters;
+    particle_soa particles_initial;
+    initialize_block(particles_initial, sph_parameters, N_target);
+    float const dt = 0.005f * sph_parameters.h/0.12f;
+
+    std::cout<<std::endl<<particles_initial.size()<<" particles - "<<parallel_processor_count()<<" processor(s) available"<<std::endl;
+    std::cout<<std::setw(12)<<"threads"<<std::setw(16)<<"step (ms)"<<std::setw(12)<<"speedup"<<std::setw(28)<<"identical to 1 thread"<<std::endl;
+
+    float t_reference = 0.0f;
+    particle_soa particles_reference;
+    for(int thread_count : {1, 2, 4, 8, 16})
+    {
+        parallel_set_thread_count(thread_count);
+        particle_soa particles = particles_initial;
+        neighbor_list neighbors;
+        neighbors.skin *= sph_parameters.h/0.12f;
+        float const t = time_step(particles, neighbors, sph_parameters, dt, N_steps);
+
+        if(thread_count==1) {
+            t_reference = t;
+            particles_reference = particles;
+        }
+        // Bitwise comparison of the final state with the sequential run
+        bool const identical = std::memcmp(particles.p.data.data(), particles_reference.p.data.data(), particles.size()*sizeof(vec3))==0
+            && std::memcmp(particles.v.data.data(), particles_reference.v.data.data(), particles.size()*sizeof(vec3))==0;
+
+        std::cout<<std::setw(12)<<thread_count<<std::setw(16)<<t<<std::setw(12)<<t_reference/t<<std::setw(28)<<(identical?"yes":"no")<<std::endl;
+    }
+    parallel_set_thread_count(thread_count_initial);
+}
+
+void benchmark_sph_skin()
+{
+    size_t const N_target = 16000;
+    size_t const N_steps = 100;
+
+    sph_parameters_structure sph_parameters;
+    particle_soa particles_initial;
+    initialize_block(particles_initial, sph_parameters, N_target);
+    float const h = sph_parameters.h;
+    float const dt = 0.005f * h/0.12f;
+
+    std::cout<<std::endl<<particles_initial.size()<<" particles - "<<N_steps<<" steps"<<std::endl;
+    std::cout<<std::setw(12)<<"skin/h"<<std::setw(16)<<"step (ms)"<<std::setw(20)<<"rebuild period"<<std::setw(20)<<"list memory (kB)"<<std::endl;
+    for(float skin_ratio : {0.0f, 0.05f, 0.1f, 0.2f, 0.4f})
+    {
+        particle_soa particles = particles_initial;
+        neighbor_list neighbors;
+        neighbors.skin = skin_ratio*h;
+        float const t = time_step(particles, neighbors, sph_parameters, dt, N_steps);
+        std::cout<<std::setw(12)<<skin_ratio<<std::setw(16)<<t<<std::setw(20)<<neighbors.rebuild_period()<<std::setw(20)<<neighbors.memory()/1024.0f<<std::endl;
+    }
+}
+
+
+void benchmark_sph_solver()
+{
+    size_t const N_target = 4000;
+    int const N_frames = 50;
+    int const base_steps_per_frame = 8; // A frame lasts 8 time steps of the reference dt
+
+    sph_parameters_structure sph_parameters;
+    particle_soa particles_initial;
+    initialize_block(particles_initial, sph_parameters, N_target);
+    float const dt_reference = 0.005f * sph_parameters.h/0.12f;
+
+    std::cout<<std::endl<<particles_initial.size()<<" particles - "<<N_frames<<" frames of "<<base_steps_per_frame*dt_reference<<"s"<<std::endl;
+    std::cout<<std::setw(16)<<"solver"<<std::setw(10)<<"dt/dt0"<<std::setw(14)<<"steps/frame"<<std::setw(22)<<"iterations/frame"<<std::setw(20)<<"density error (%)"<<std::setw(16)<<"max error (%)"<<std::setw(14)<<"max speed"<<std::setw(14)<<"frame (ms)"<<std::endl;
+    for(sph_solver_type solver_type : {sph_solver_state_equation, sph_solver_dfsph})
+    {
+        for(int dt_ratio : {1, 2, 4, 8})
+        {
+            sph_parameters.solver = solver_type;
+            particle_soa particles = particles_initial;
+            neighbor_list neighbors;
+            neighbors.skin *= sph_parameters.h/0.12f;
+            sph_solver_data solver;
+
+            int const steps_per_frame = base_steps_per_frame/dt_ratio;
+            float const dt = dt_ratio*dt_reference;
+            int const N_steps = N_frames*steps_per_frame;
+            int iterations = 0;
+            float error = 0.0f, error_max = 0.0f;
+
+            auto const t0 = std::chrono::steady_clock::now();
+            for(int k=0; k<N_steps; ++k) {
+                simulate(dt, particles, neighbors, solver, sph_parameters);
+                iterations += solver.iterations + solver.iterations_divergence;
+                error += solver.density_error;
+                error_max = std::max(error_max, solver.density_error);
+            }
+            auto const t1 = std::chrono::steady_clock::now();
+
+            // A large speed indicates that the simulation became unstable
+            float speed_max = 0.0f;
+            for(size_t k=0; k<particles.size(); ++k)
+                speed_max = std::max(speed_max, norm(particles[k].v));
+
+            std::cout<<std::setw(16)<<(solver_type==sph_solver_dfsph?"DFSPH":"state equation")<<std::setw(10)<<dt_ratio<<std::setw(14)<<steps_per_frame;
+            std::cout<<std::setw(22)<<float(iterations)/N_frames<<std::setw(20)<<100*error/N_steps<<std::setw(16)<<100*error_max<<std::setw(14)<<speed_max;
+            std::cout<<std::setw(14)<<std::chrono::duration<float, std::milli>(t1-t0).count()/N_frames<<std::endl;
+        }
+    }
+}
+
+void benchmark_sph_timestep()
+{
+    size_t const N_target = 1000;
+    int const N_frames = 300;
+    int const N_frames_phase = 30; // Frames at the start (dam break) and at the end (fluid at rest) used for the statistics
+    int const base_steps_per_frame = 8;
+
+    sph_parameters_structure sph_parameters;
+    particle_soa particles_initial;
+    initialize_block(particles_initial, sph_parameters, N_target);
+    float const dt_reference = 0.005f * sph_parameters.h/0.12f;
+    float const dt_frame = base_steps_per_frame*dt_reference;
+
+    std::cout<<std::endl<<particles_initial.size()<<" particles - "<<N_frames<<" frames of "<<dt_frame<<"s"<<std::endl;
+    std::cout<<std::setw(16)<<"solver"<<std::setw(12)<<"time step"<<std::setw(18)<<"steps/frame start"<<std::setw(16)<<"steps/frame end"<<std::setw(16)<<"max steps"<<std::setw(20)<<"density error (%)"<<std::setw(14)<<"max speed"<<std::setw(14)<<"frame (ms)"<<std::endl;
+    for(sph_solver_type solver_type : {sph_solver_state_equation, sph_solver_dfsph})
+    {
+        for(int steps_fixed : {base_steps_per_frame, 2, 0}) // 0: adaptive
+        {
+            sph_parameters.solver = solver_type;
+            particle_soa particles = particles_initial;
+            neighbor_list neighbors;
+            neighbors.skin *= sph_parameters.h/0.12f;
+            sph_solver_data solver;
+            timestep_adaptive timestep;
+
+            float steps_start = 0, steps_end = 0, error = 0, speed_max = 0;
+            int steps_max = 0;
+            auto const t0 = std::chrono::steady_clock::now();
+            for(int k_frame=0; k_frame<N_frames; ++k_frame)
+            {
+                int steps = steps_fixed;
+                float error_frame = 0.0f;
+                if(steps_fixed>0) {
+                    for(int k=0; k<steps_fixed; ++k) {
+                        simulate(dt_frame/steps_fixed, particles, neighbors, solver, sph_parameters);
+                        error_frame = std::max(error_frame, solver.density_error);
+                    }
+                }
+                else {
+                    simulate_frame(dt_frame, particles, neighbors, solver, timestep, sph_parameters);
+                    steps = timestep.substeps;
+                    error_frame = solver.density_error;
+                }
+
+                if(k_frame<N_frames_phase) steps_start += steps;
+                if(k_frame>=N_frames-N_frames_phase) steps_end += steps;
+                steps_max = std::max(steps_max, steps);
+                error += error_frame;
+                for(size_t k=0; k<particles.size(); ++k)
+                    speed_max = std::max(speed_max, norm(particles[k].v));
+            }
+            auto const t1 = std::chrono::steady_clock::now();
+
+            std::cout<<std::setw(16)<<(solver_type==sph_solver_dfsph?"DFSPH":"state equation")<<std::setw(12)<<(steps_fixed>0?"fixed":"adaptive");
+            std::cout<<std::setw(18)<<steps_start/N_frames_phase<<std::setw(16)<<steps_end/N_frames_phase<<std::setw(16)<<steps_max<<std::setw(20)<<100*error/N_frames<<std::setw(14)<<speed_max;
+            std::cout<<std::setw(14)<<std::chrono::duration<float, std::milli>(t1-t0).count()/N_frames<<std::endl;
+        }
+    }
+}
+
+void benchmark_field_color()
+{
+    std::cout<<std::endl<<std::setw(12)<<"particles"<<std::setw(12)<<"pixels"<<std::setw(18)<<"all pairs (ms)"<<std::setw(16)<<"splat (ms)"<<std::setw(12)<<"speedup"<<std::setw(16)<<"max difference"<<std::endl;
+    for(size_t N_target : {250, 4000})
+    {
+        sph_parameters_structure sph_parameters;
+        particle_soa particles;
+        initialize_block(particles, sph_parameters, N_target);
+
+        for(int Nf : {30, 100, 300})
+        {
+            grid_2D<vec3> field_reference(Nf,Nf), field(Nf,Nf);
+            field_splat splat;
+            splat.update(field, particles); // warm-up (memory allocation)
+
+            int const N_repeat = 5;
+            auto const t0 = std::chrono::steady_clock::now();
+            for(int k=0; k<N_repeat; ++k)
+                field_color_all_pairs(field_reference, particles, splat.d);
+            auto const t1 = std::chrono::steady_clock::now();
+            for(int k=0; k<N_repeat; ++k)
+                splat.update(field, particles);
+            auto const t2 = std::chrono::steady_clock::now();
+
+            float difference = 0.0f;
+            for(size_t k=0; k<field.size(); ++k)
+                difference = std::max(difference, norm(field[k]-field_reference[k]));
+
+            float const time_reference = std::chrono::duration<float, std::milli>(t1-t0).count()/N_repeat;
+            float const time_splat = std::chrono::duration<float, std::milli>(t2-t1).count()/N_repeat;
+            std::cout<<std::setw(12)<<particles.size()<<std::setw(12)<<Nf*Nf<<std::setw(18)<<time_reference<<std::setw(16)<<time_splat<<std::setw(12)<<time_reference/time_splat<<std::setw(16)<<difference<<std::endl;
+        }
+    }
+}
+
+void benchmark_sph_kernel()
+{
+    // Accuracy of the tables against the exact kernels, sampled on ranges of r/h
+    float const h = 0.12f;
+    sph_kernel<3,false> const exact(h);
+    sph_kernel<3,true> const tabulated(h);
+    std::cout<<std::endl<<std::setw(20)<<"r/h"<<std::setw(16)<<"pressure"<<std::setw(16)<<"gradient"<<std::setw(16)<<"laplacian"<<"   (largest relative error)"<<std::endl;
+    float const ranges[][2] = { {1e-4f, 1.0f/32}, {1.0f/32, 1.0f/8}, {1.0f/8, 0.5f}, {0.5f, 0.99f} };
+    for(auto const& range : ranges)
+    {
+        float error_pressure = 0.0f, error_gradient = 0.0f, error_laplacian = 0.0f;
+        int const N_sample = 10000;
+        for(int k=0; k<N_sample; ++k) {
+            float const r = h*(range[0] + (range[1]-range[0])*k/(N_sample-1.0f));
+            vec3 const p_ij = {r, 0, 0};
+            float const r2 = r*r;
+            error_pressure = std::max(error_pressure, std::abs(tabulated.pressure(r2)/exact.pressure(r2)-1));
+            error_gradient = std::max(error_gradient, norm(tabulated.gradient_pressure(p_ij,r2)-exact.gradient_pressure(p_ij,r2))/norm(exact.gradient_pressure(p_ij,r2)));
+            error_laplacian = std::max(error_laplacian, std::abs(tabulated.laplacian_viscosity(r2)/exact.laplacian_viscosity(r2)-1));
+        }
+        std::cout<<std::setw(9)<<range[0]<<" - "<<std::setw(8)<<range[1]<<std::setw(16)<<error_pressure<<std::setw(16)<<error_gradient<<std::setw(16)<<error_laplacian<<std::endl;
+    }
+
+    std::cout<<std::endl<<std::setw(12)<<"particles"<<std::setw(16)<<"solver"<<std::setw(14)<<"exact (ms)"<<std::setw(18)<<"tabulated (ms)"<<std::setw(24)<<"density difference (%)"<<std::endl;
+    for(size_t N_target : {4000, 16000})
+    {
+        for(sph_solver_type solver_type : {sph_solver_state_equation, sph_solver_dfsph})
+        {
+            sph_parameters_structure sph_parameters;
+            sph_parameters.solver = solver_type;
+            particle_soa particles_initial;
+            initialize_block(particles_initial, sph_parameters, N_target);
+            float const dt = 0.005f * sph_parameters.h/0.12f;
+
+            float time[2];
+            particle_soa particles[2];
+            for(int tabulated=0; tabulated<2; ++tabulated) {
+                sph_parameters.kernel_tabulated = tabulated==1;
+                particles[tabulated] = particles_initial;
+                particles[tabulated].reorder_period = 0;
+                neighbor_list neighbors;
+                time[tabulated] = time_step(particles[tabulated], neighbors, sph_parameters, dt, 10);
+            }
+
+            float difference = 0.0f;
+            for(size_t k=0; k<particles[0].size(); ++k)
+                difference = std::max(difference, std::abs(particles[1][k].rho-particles[0][k].rho)/particles[0][k].rho);
+
+            std::cout<<std::setw(12)<<particles_initial.size()<<std::setw(16)<<(solver_type==sph_solver_dfsph?"DFSPH":"state equation")<<std::setw(14)<<time[0]<<std::setw(18)<<time[1]<<std::setw(24)<<100*difference<<std::endl;
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "simulation.hpp"
+#include "field_splat.hpp"
+
+
+// Measure the computation time of the SPH step for an increasing number of particles
+//  Called when the program is run as: ./10_sph benchmark
+void benchmark_sph();
+
+// Measure the scaling of the SPH step with the number of threads
+//  Also checks that the result is bitwise identical to the sequential computation
+void benchmark_sph_threads();
+
+// Measure the step time, the rebuild frequency and the memory of the neighbor lists for different skin sizes
+void benchmark_sph_skin();
+
+// Compare the pressure solvers (state equation and DFSPH) for increasing time steps
+//  Reports the number of pressure iterations, the density error and the computation time per frame
+void benchmark_sph_solver();
+
+// Compare fixed time steps with the adaptive time step (CFL condition) on a dam break
+//  Reports the number of substeps during the violent start and once the fluid is at rest
+void benchmark_sph_timestep();
+
+// Compare the splatting of the field color with the evaluation of all the particles at every pixel
+//  Reports the computation time and the maximal difference of color for several resolutions and numbers of particles
+void benchmark_field_color();
+
+// Compare the exact kernels (precomputed constants) with the tabulated kernels
+//  Reports the largest relative error of the tabulated kernels over ranges of distances (including r close to 0),
+//  the step time and the difference of density after one step
+void benchmark_sph_kernel();
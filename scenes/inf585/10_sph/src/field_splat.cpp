@@ -0,0 +1,83 @@
+#include "field_splat.hpp"
+
+using namespace vcl;
+
+
+// Range of pixels [k0,k1] covered by the interval [x-R,x+R], for pixels at positions 2(k/(Nf-1)-0.5)
+static void pixel_range(float x, float R, int Nf, int& k0, int& k1)
+{
+    float const s = (Nf-1)/2.0f;
+    k0 = std::max(int(std::ceil((x-R+1.0f)*s)), 0);
+    k1 = std::min(int(std::floor((x+R+1.0f)*s)), Nf-1);
+}
+
+void field_splat::update(grid_2D<vec3>& field, particle_soa const& particles)
+{
+    int const Nf = int(field.dimension.x);
+    int const N = int(particles.size());
+    int const T = tile_size;
+    int const N_tile_dim = (Nf+T-1)/T;
+    int const N_tile = N_tile_dim*N_tile_dim;
+    float const R = 3*d;
+
+    // Sort the particles per tile overlapped by their support
+    //  Same counting sort than the neighbor grid, except that a particle is inserted in several tiles
+    auto const for_each_tile = [&](int k, auto const& f) {
+        vec3 const& p = particles[k].p;
+        int x0, x1, y0, y1;
+        pixel_range(p.x, R, Nf, x0, x1);
+        pixel_range(p.y, R, Nf, y0, y1);
+        if(x0>x1 || y0>y1)
+            return;
+        for(int ty=y0/T; ty<=y1/T; ++ty)
+            for(int tx=x0/T; tx<=x1/T; ++tx)
+                f(tx+N_tile_dim*ty);
+    };
+    tile_start.resize(N_tile+1);
+    tile_start.fill(0);
+    for(int k=0; k<N; ++k)
+        for_each_tile(k, [&](int t){ tile_start[t+1]++; });
+    for(int t=0; t<N_tile; ++t)
+        tile_start[t+1] += tile_start[t];
+    tile_particle.resize(tile_start[N_tile]);
+    tile_fill = tile_start;
+    for(int k=0; k<N; ++k)
+        for_each_tile(k, [&](int t){ tile_particle[tile_fill[t]++] = k; });
+
+    // Splat the particles of each tile on its pixels
+    density.resize(Nf, Nf);
+    float const s = (Nf-1)/2.0f;
+    #pragma omp parallel for schedule(dynamic)
+    for(int t=0; t<N_tile; ++t)
+    {
+        int const tx0 = T*(t%N_tile_dim), tx1 = std::min(tx0+T, Nf)-1;
+        int const ty0 = T*(t/N_tile_dim), ty1 = std::min(ty0+T, Nf)-1;
+        for(int ky=ty0; ky<=ty1; ++ky)
+            for(int kx=tx0; kx<=tx1; ++kx)
+                density(kx,ky) = 0.0f;
+
+        for(int k_tile=tile_start[t]; k_tile<tile_start[t+1]; ++k_tile)
+        {
+            vec3 const& p = particles[tile_particle[k_tile]].p;
+            int x0, x1, y0, y1;
+            pixel_range(p.x, R, Nf, x0, x1);
+            pixel_range(p.y, R, Nf, y0, y1);
+            for(int ky=std::max(y0,ty0); ky<=std::min(y1,ty1); ++ky) {
+                float const dy = (ky/s-1.0f-p.y)/d;
+                for(int kx=std::max(x0,tx0); kx<=std::min(x1,tx1); ++kx) {
+                    float const dx = (kx/s-1.0f-p.x)/d;
+                    density(kx,ky) += 0.25f*std::exp(-dx*dx-dy*dy);
+                }
+            }
+        }
+    }
+
+    // Conversion to color (the field is displayed with the y axis flipped)
+    #pragma omp parallel for
+    for(int ky=0; ky<Nf; ++ky) {
+        for(int kx=0; kx<Nf; ++kx) {
+            float const f = density(kx,ky);
+            field(kx,Nf-1-ky) = vec3(clamp(1-f,0,1),clamp(1-f,0,1),1);
+        }
+    }
+}
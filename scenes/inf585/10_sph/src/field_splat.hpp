@@ -0,0 +1,26 @@
+#pragma once
+
+#include "vcl/vcl.hpp"
+#include "particle_soa.hpp"
+
+
+// Color field of the fluid displayed under the particles
+//  - Each particle contributes a gaussian 0.25 exp(-(r/d)^2), truncated at its support radius 3d (contribution < 3e-5 beyond)
+//  - Each particle is splatted only on the pixels of its support, instead of evaluating all the particles at every pixel
+//  - The pixels are split into square tiles processed in parallel
+//     Particle indices are sorted per tile overlapping their support (counting sort), such that each tile is written by a single thread
+//     and receives the contributions in the same order than the sequential loop (the result is independent of the number of threads)
+struct field_splat
+{
+    float d = 0.1f;      // Width of the gaussian of a particle
+    int tile_size = 8;   // Number of pixels along the side of a tile
+
+    // Fill the field (covering the domain [-1,1]^2) from the current particle positions
+    void update(vcl::grid_2D<vcl::vec3>& field, particle_soa const& particles);
+
+private:
+    vcl::grid_2D<float> density;     // Accumulated contribution of the particles per pixel
+    vcl::buffer<int> tile_start;     // Offset of the first particle of each tile in tile_particle (size = number of tiles + 1)
+    vcl::buffer<int> tile_fill;      // Temporary insertion offset per tile
+    vcl::buffer<int> tile_particle;  // Particle indices sorted by tile (a particle appears in every tile overlapped by its support)
+};
@@ -1,7 +1,10 @@
 #include "vcl/vcl.hpp"
 #include <iostream>
+#include <chrono>
 
 #include "simulation.hpp"
+#include "benchmark.hpp"
+#include "field_splat.hpp"
 
 
 using namespace vcl;
@@ -11,6 +14,8 @@ struct gui_parameters {
 	bool display_color     = true;
 	bool display_particles = true;
 	bool display_radius    = false;
+	int dt_ratio           = 1; // Time step (or frame duration with adaptive substeps) relative to the default one
+	bool adaptive_timestep = true; // Subdivide the frame into stable substeps (CFL condition)
 };
 
 struct user_interaction_parameters {
@@ -38,26 +43,43 @@ void window_size_callback(GLFWwindow* window, int width, int height);
 void initialize_data();
 void display_scene();
 void display_interface();
-void update_field_color(grid_2D<vec3>& field, vcl::buffer<particle_element> const& particles);
 
 
 timer_basic timer;
 
 
 sph_parameters_structure sph_parameters; // Physical parameter related to SPH
-buffer<particle_element> particles;      // Storage of the particles
+particle_soa particles;                  // Storage of the particles (structure of arrays)
+neighbor_list neighbors;                 // Cached neighbor lists of the particles
+sph_solver_data solver;                  // Buffers and statistics of the pressure solver
+timestep_adaptive timestep;              // Substeps of the frame when the adaptive time step is used
+float simulation_time_ms = 0.0f;         // Computation time of the simulation in the last frame
 mesh_drawable sphere_particle; // Sphere used to display a particle
 curve_drawable curve_visual;   // Circle used to display the radius h of influence
 
 grid_2D<vec3> field;      // grid used to represent the volume of the fluid under the particles
 mesh_drawable field_quad; // quad used to display this field color
+field_splat field_color;  // splatting of the particles on the field
+float field_time_ms = 0.0f; // computation time of the field in the last frame
 
 
 
-int main(int, char* argv[])
+int main(int argc, char* argv[])
 {
 	std::cout << "Run " << argv[0] << std::endl;
 
+	// Run the timing of the simulation without display: ./10_sph benchmark
+	if(argc>1 && std::string(argv[1])=="benchmark") {
+		benchmark_sph();
+		benchmark_sph_threads();
+		benchmark_sph_skin();
+		benchmark_sph_solver();
+		benchmark_sph_timestep();
+		benchmark_field_color();
+		benchmark_sph_kernel();
+		return 0;
+	}
+
 	GLFWwindow* window = create_window(1280,1024);
 	window_size_callback(window, 1280, 1024);
 	std::cout << opengl_info_display() << std::endl;;
@@ -93,8 +115,13 @@ int main(int, char* argv[])
 
 		ImGui::Begin("GUI",NULL,ImGuiWindowFlags_AlwaysAutoResize);
 
-		float const dt = 0.005f * timer.scale;
-		simulate(dt, particles, sph_parameters);
+		float const dt = 0.005f * timer.scale * user.gui.dt_ratio;
+		auto const t0 = std::chrono::steady_clock::now();
+		if(user.gui.adaptive_timestep)
+			simulate_frame(dt, particles, neighbors, solver, timestep, sph_parameters);
+		else
+			simulate(dt, particles, neighbors, solver, sph_parameters);
+		simulation_time_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now()-t0).count();
 
 		display_interface();
 		display_scene();
@@ -120,12 +147,14 @@ int main(int, char* argv[])
 void initialize_sph()
 {
     // Initial particle spacing (relative to h)
-    float const c = 0.7f;
+    float const c = sph_parameters.c;
 	float const h = sph_parameters.h;
 
 
 	// Fill a square with particles
 	particles.clear();
+	neighbors.invalidate();
+	neighbors.reset_statistics();
     float const epsilon = 1e-3f;
     for(float x=h; x<1.0f-h; x=x+c*h)
     {
@@ -183,7 +212,9 @@ void display_scene()
 	}
 
 	if(user.gui.display_color){
-		update_field_color(field, particles);
+		auto const t0 = std::chrono::steady_clock::now();
+		field_color.update(field, particles);
+		field_time_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now()-t0).count();
 		opengl_update_texture_gpu(field_quad.texture, field);
 		draw(field_quad, scene);
 	}
@@ -201,6 +232,28 @@ void display_interface()
 	ImGui::Checkbox("Particles", &user.gui.display_particles);
 	ImGui::Checkbox("Radius", &user.gui.display_radius);
 
+	int solver_type = sph_parameters.solver;
+	ImGui::RadioButton("State equation", &solver_type, sph_solver_state_equation); ImGui::SameLine();
+	ImGui::RadioButton("DFSPH", &solver_type, sph_solver_dfsph);
+	sph_parameters.solver = sph_solver_type(solver_type);
+	ImGui::SliderInt("Time step ratio", &user.gui.dt_ratio, 1, 10);
+	ImGui::Checkbox("Adaptive time step", &user.gui.adaptive_timestep);
+	if(user.gui.adaptive_timestep)
+		ImGui::Text("Substeps: %d (stable dt: %.4f s)", timestep.substeps, timestep.dt_stable);
+	ImGui::SliderFloat("Density error max", &sph_parameters.density_error_max, 0.001f, 0.05f, "%0.3f");
+	ImGui::Text("Pressure iterations: %d (density) + %d (divergence)", solver.iterations, solver.iterations_divergence);
+	ImGui::Text("Density error: %.2f%%", 100*solver.density_error);
+	ImGui::Text("Simulation: %.2f ms per frame", simulation_time_ms);
+	if(user.gui.display_color)
+		ImGui::Text("Field color: %.2f ms per frame", field_time_ms);
+
+	ImGui::SliderFloat("Neighbor skin", &neighbors.skin, 0.0f, 0.1f, "%0.3f");
+	ImGui::Text("Neighbor lists: rebuild every %.1f steps, %.1f kB", neighbors.rebuild_period(), neighbors.memory()/1024.0f);
+
+	int threads = parallel_thread_count();
+	if(ImGui::SliderInt("Threads", &threads, 1, parallel_processor_count()))
+		parallel_set_thread_count(threads);
+
 }
 
 
@@ -243,25 +296,4 @@ void opengl_uniform(GLuint shader, scene_environment const& current_scene)
 	opengl_uniform(shader, "light", scene.light, false);
 }
 
-void update_field_color(grid_2D<vec3>& field, vcl::buffer<particle_element> const& particles)
-{
-	field.fill({1,1,1});
-	float const d = 0.1f;
-	int const Nf = int(field.dimension.x);
-	for (int kx = 0; kx < Nf; ++kx) {
-		for (int ky = 0; ky < Nf; ++ky) {
-
-			float f = 0.0f;
-			vec3 const p0 = { 2.0f*(kx/(Nf-1.0f)-0.5f), 2.0f*(ky/(Nf-1.0f)-0.5f), 0.0f};
-			for (size_t k = 0; k < particles.size(); ++k) {
-				vec3 const& pi = particles[k].p;
-				float const r = norm(pi-p0)/d;
-				f += 0.25f*std::exp(-r*r);
-			}
-			field(kx,Nf-1-ky) = vec3(clamp(1-f,0,1),clamp(1-f,0,1),1);
-		}
-	}
-
-
-}
 
@@ -0,0 +1,33 @@
+#include "neighbor_grid.hpp"
+
+using namespace vcl;
+
+
+int3 neighbor_grid::cell_coordinates(vec3 const& p) const
+{
+    int3 idx;
+    for(int c=0; c<3; ++c)
+        idx[c] = std::min(std::max(int((p[c]-p_min[c])/cell_size), 0), dimension[c]-1);
+    return idx;
+}
+
+void neighbor_grid::counting_sort(size_t N)
+{
+    size_t const N_cell = size_t(dimension.x)*dimension.y*dimension.z;
+
+    // Number of particles per cell
+    cell_start.resize(N_cell+1);
+    cell_start.fill(0);
+    for(size_t k=0; k<N; ++k)
+        cell_start[particle_cell[k]+1]++;
+
+    // Exclusive prefix sum: offset of the first particle of each cell
+    for(size_t c=0; c<N_cell; ++c)
+        cell_start[c+1] += cell_start[c];
+
+    // Scatter the particle indices at their sorted position
+    sorted_index.resize(N);
+    cell_fill = cell_start;
+    for(size_t k=0; k<N; ++k)
+        sorted_index[cell_fill[particle_cell[k]]++] = int(k);
+}
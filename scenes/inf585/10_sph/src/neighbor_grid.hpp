@@ -0,0 +1,101 @@
+#pragma once
+
+#include "vcl/vcl.hpp"
+
+
+// Uniform grid accelerating the search of the neighbors of a particle
+//  - The bounding box of the particles is split into cubic cells of size h (the search radius)
+//  - Particle indices are sorted per cell using a counting sort, rebuilt at every time step
+//  - All the particles at distance smaller than h from a position are found in the 3x3 surrounding cells (3x3x3 in 3D)
+struct neighbor_grid
+{
+    float cell_size = 0.0f;     // Size of a cell (= search radius)
+    vcl::vec3 p_min;            // Lower corner of the grid
+    vcl::int3 dimension;        // Number of cells along x, y and z
+
+    vcl::buffer<int> cell_start;    // Offset of the first particle of each cell in sorted_index (size = number of cells + 1)
+    vcl::buffer<int> sorted_index;  // Particle indices sorted by cell
+    vcl::buffer<int> particle_cell; // Cell index of each particle
+
+    // Rebuild the grid from the current particle positions
+    //  position(k) must return the position of the k-th particle
+    template <typename F> void build(size_t N, F const& position, float h);
+
+    // Integer coordinates of the cell containing the position p (clamped to the grid)
+    vcl::int3 cell_coordinates(vcl::vec3 const& p) const;
+
+    // Call f(j) for every particle j lying in the cells around p
+    //  All particles at distance < h from p are visited - the caller still has to check the exact distance
+    template <typename F> void for_each_candidate(vcl::vec3 const& p, F const& f) const;
+
+private:
+    vcl::buffer<int> cell_fill; // Temporary insertion offset per cell used by the counting sort
+    void counting_sort(size_t N);
+};
+
+
+
+template <typename F>
+void neighbor_grid::build(size_t N, F const& position, float h)
+{
+    using namespace vcl;
+    cell_size = h;
+
+    // Bounding box of the particles (a single cell at the origin when there is no particle)
+    p_min = {0,0,0};
+    vec3 p_max = {0,0,0};
+    if(N>0) {
+        p_min = position(0);
+        p_max = position(0);
+    }
+    for(size_t k=1; k<N; ++k) {
+        vec3 const& p = position(k);
+        for(int c=0; c<3; ++c) {
+            p_min[c] = std::min(p_min[c], p[c]);
+            p_max[c] = std::max(p_max[c], p[c]);
+        }
+    }
+    for(int c=0; c<3; ++c)
+        dimension[c] = int(std::min((p_max[c]-p_min[c])/h, 1e6f))+1;
+
+    // Limit the number of cells in case of scattered particles (ex. diverging simulation)
+    //  Positions are clamped to the border cells: neighbors remain in adjacent cells, only the number of candidates increases
+    size_t const N_cell_max = 4*N+64;
+    while(size_t(dimension.x)*dimension.y*dimension.z > N_cell_max) {
+        int& d = dimension[dimension.x>=dimension.y ? (dimension.x>=dimension.z?0:2) : (dimension.y>=dimension.z?1:2)];
+        d = (d+1)/2;
+    }
+
+    // Cell of each particle
+    particle_cell.resize(N);
+    #pragma omp parallel for
+    for(int k=0; k<int(N); ++k) {
+        int3 const idx = cell_coordinates(position(k));
+        particle_cell[k] = idx.x + dimension.x*(idx.y + dimension.y*idx.z);
+    }
+
+    counting_sort(N);
+}
+
+template <typename F>
+void neighbor_grid::for_each_candidate(vcl::vec3 const& p, F const& f) const
+{
+    using namespace vcl;
+    int3 const idx = cell_coordinates(p);
+
+    int const x0 = std::max(idx.x-1, 0), x1 = std::min(idx.x+1, dimension.x-1);
+    int const y0 = std::max(idx.y-1, 0), y1 = std::min(idx.y+1, dimension.y-1);
+    int const z0 = std::max(idx.z-1, 0), z1 = std::min(idx.z+1, dimension.z-1);
+
+    int const* start = cell_start.data.data();
+    int const* index = sorted_index.data.data();
+    for(int z=z0; z<=z1; ++z) {
+        for(int y=y0; y<=y1; ++y) {
+            // Cells along x are consecutive: their particles form a single contiguous range
+            int const row = dimension.x*(y + dimension.y*z);
+            int const k_end = start[row+x1+1];
+            for(int k=start[row+x0]; k<k_end; ++k)
+                f(index[k]);
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#include "neighbor_list.hpp"
+
+using namespace vcl;
+
+
+void neighbor_list::invalidate()
+{
+    valid = false;
+}
+
+float neighbor_list::rebuild_period() const
+{
+    return rebuild_counter>0 ? step_counter/float(rebuild_counter) : 0.0f;
+}
+
+size_t neighbor_list::memory() const
+{
+    return (offset.size()+index.size())*sizeof(int) + p_build.size()*sizeof(vec3);
+}
+
+void neighbor_list::reset_statistics()
+{
+    step_counter = 0;
+    rebuild_counter = 0;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "neighbor_grid.hpp"
+
+
+// Cached lists of neighbors (Verlet lists) of the SPH particles
+//  - The list of particle i contains all particles j (including i) with |p_i-p_j| < h + skin at the time of the build
+//  - The lists are stored contiguously (CSR format): neighbors of i are index[offset[i]] ... index[offset[i+1]-1]
+//  - They remain valid as long as no particle moved more than skin/2 since the build: all pairs at distance < h are then still in the lists
+//  - A larger skin means less rebuilds, but longer lists to iterate over at each step
+struct neighbor_list
+{
+    // Extra radius added to h when building the lists (0: rebuild at every step)
+    float skin = 0.02f;
+
+    vcl::buffer<int> offset; // Offset of the first neighbor of each particle in index (size = N+1)
+    vcl::buffer<int> index;  // Neighbor indices of all particles
+
+    neighbor_grid grid;               // Grid used to build the lists
+    vcl::buffer<vcl::vec3> p_build;   // Particle positions at the last build
+
+    // Statistics
+    int step_counter = 0;    // Number of calls to update
+    int rebuild_counter = 0; // Number of rebuilds among them
+
+    // Rebuild the lists if a particle moved more than skin/2 since the last build (or if the lists have been invalidated, or h or skin changed)
+    //  position(k) must return the position of the k-th particle
+    //  Return true if the lists have been rebuilt
+    template <typename F> bool update(size_t N, F const& position, float h);
+
+    // Force a rebuild at the next update (ex. particles have been reordered)
+    void invalidate();
+
+    // Call f(j) for every neighbor j of the particle i (including i)
+    //  The caller still has to check the exact distance with h
+    template <typename F> void for_each_candidate(int i, F const& f) const;
+
+    // Average number of steps between two rebuilds
+    float rebuild_period() const;
+    // Memory used by the lists (in Bytes)
+    size_t memory() const;
+    // Reset the statistics
+    void reset_statistics();
+
+private:
+    bool valid = false;
+    float h_build = 0.0f;
+    float skin_build = 0.0f; // Skin of the lists: the displacements are compared to the radius they were built with
+    template <typename F> void build(size_t N, F const& position, float h);
+};
+
+
+
+template <typename F>
+bool neighbor_list::update(size_t N, F const& position, float h)
+{
+    using namespace vcl;
+    step_counter++;
+
+    bool rebuild = !valid || p_build.size()!=N || h!=h_build || skin!=skin_build;
+    if(!rebuild) {
+        float const d2_max = (skin_build/2)*(skin_build/2);
+        #pragma omp parallel for reduction(||:rebuild)
+        for(int k=0; k<int(N); ++k) {
+            vec3 const d = position(k)-p_build[k];
+            rebuild = rebuild || dot(d,d)>d2_max;
+        }
+    }
+
+    if(rebuild)
+        build(N, position, h);
+    return rebuild;
+}
+
+template <typename F>
+void neighbor_list::build(size_t N, F const& position, float h)
+{
+    using namespace vcl;
+    rebuild_counter++;
+    valid = true;
+    h_build = h;
+    skin_build = skin;
+
+    float const radius = h + skin;
+    float const radius2 = radius*radius;
+    grid.build(N, position, radius);
+
+    p_build.resize(N);
+    offset.resize(N+1);
+    offset[0] = 0;
+
+    // Count the neighbors of each particle
+    #pragma omp parallel for
+    for(int i=0; i<int(N); ++i) {
+        vec3 const& p_i = position(i);
+        p_build[i] = p_i;
+        int count = 0;
+        grid.for_each_candidate(p_i, [&](int j) {
+            vec3 const d = p_i-position(j);
+            if(dot(d,d)<radius2)
+                count++;
+        });
+        offset[i+1] = count;
+    }
+
+    // Prefix sum and storage of the neighbor indices
+    for(size_t i=0; i<N; ++i)
+        offset[i+1] += offset[i];
+    index.resize(offset[N]);
+
+    #pragma omp parallel for
+    for(int i=0; i<int(N); ++i) {
+        vec3 const& p_i = position(i);
+        int* it = index.data.data() + offset[i];
+        grid.for_each_candidate(p_i, [&](int j) {
+            vec3 const d = p_i-position(j);
+            if(dot(d,d)<radius2)
+                *(it++) = j;
+        });
+    }
+}
+
+template <typename F>
+void neighbor_list::for_each_candidate(int i, F const& f) const
+{
+    int const* it = index.data.data();
+    int const k_end = offset.data[i+1];
+    for(int k=offset.data[i]; k<k_end; ++k)
+        f(it[k]);
+}
@@ -0,0 +1,89 @@
+#include "particle_soa.hpp"
+#include "simulation.hpp"
+
+#include <algorithm>
+
+using namespace vcl;
+
+
+size_t particle_soa::size() const
+{
+    return p.size();
+}
+
+void particle_soa::clear()
+{
+    resize(0);
+}
+
+void particle_soa::resize(size_t N)
+{
+    p.resize(N); v.resize(N); f.resize(N);
+    rho.resize(N); pressure.resize(N);
+}
+
+void particle_soa::push_back(particle_element const& particle)
+{
+    p.push_back(particle.p);
+    v.push_back(particle.v);
+    f.push_back(particle.f);
+    rho.push_back(particle.rho);
+    pressure.push_back(particle.pressure);
+}
+
+
+// Spread the 21 lower bits of x such that there is 2 zero bits between each of them
+static uint64_t morton_spread(uint64_t x)
+{
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffff;
+    x = (x | x << 16) & 0x1f0000ff0000ff;
+    x = (x | x << 8)  & 0x100f00f00f00f00f;
+    x = (x | x << 4)  & 0x10c30c30c30c30c3;
+    x = (x | x << 2)  & 0x1249249249249249;
+    return x;
+}
+
+uint64_t morton_code(int3 const& idx)
+{
+    return morton_spread(idx.x) | (morton_spread(idx.y) << 1) | (morton_spread(idx.z) << 2);
+}
+
+
+template <typename T>
+void particle_soa::permute(buffer<T>& field)
+{
+    size_t const N = permutation.size();
+    buffer<T> sorted(N);
+    for(size_t k=0; k<N; ++k)
+        sorted.data[k] = field.data[permutation.data[k]];
+    std::swap(field.data, sorted.data);
+}
+
+void particle_soa::sort_morton(float h)
+{
+    size_t const N = size();
+    if(N==0)
+        return;
+
+    // Morton code of the cell of each particle (relative to the lower corner of the bounding box)
+    vec3 p_min = p[0];
+    for(size_t k=1; k<N; ++k)
+        for(int c=0; c<3; ++c)
+            p_min[c] = std::min(p_min[c], p.data[k][c]);
+
+    morton_key.resize(N);
+    for(size_t k=0; k<N; ++k) {
+        vec3 const u = (p.data[k]-p_min)/h;
+        morton_key.data[k] = morton_code({int(u.x), int(u.y), int(u.z)});
+    }
+
+    // Particles ordered along the curve (stable sort keeps the order inside a cell)
+    permutation.resize(N);
+    for(size_t k=0; k<N; ++k)
+        permutation.data[k] = int(k);
+    std::stable_sort(permutation.begin(), permutation.end(), [this](int a, int b){return morton_key.data[a]<morton_key.data[b];});
+
+    permute(p); permute(v); permute(f);
+    permute(rho); permute(pressure);
+}
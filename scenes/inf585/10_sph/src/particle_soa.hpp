@@ -0,0 +1,66 @@
+#pragma once
+
+#include "vcl/vcl.hpp"
+#include <cstdint>
+
+struct particle_element;
+
+
+// SPH particles stored as a structure of arrays (one contiguous buffer per field)
+//  - A pass touching only some fields (ex. density to pressure) only loads these fields in cache
+//  - Element access particles[k].p / .v / .f / .rho / .pressure follows the same syntax than buffer<particle_element>
+//  - Particles can be reordered along a Morton (Z-order) curve of their cell such that spatial neighbors are close in memory
+struct particle_soa
+{
+    vcl::buffer<vcl::vec3> p; // Positions
+    vcl::buffer<vcl::vec3> v; // Speeds
+    vcl::buffer<vcl::vec3> f; // Forces
+
+    vcl::buffer<float> rho;      // Densities
+    vcl::buffer<float> pressure; // Pressures
+
+    // Number of calls to simulate() between two Morton reordering (0 to disable)
+    int reorder_period = 32;
+    int reorder_counter = 0;
+
+    // References on the fields of the k-th particle
+    struct reference {
+        vcl::vec3& p; vcl::vec3& v; vcl::vec3& f;
+        float& rho; float& pressure;
+    };
+    struct const_reference {
+        vcl::vec3 const& p; vcl::vec3 const& v; vcl::vec3 const& f;
+        float const& rho; float const& pressure;
+    };
+
+    size_t size() const;
+    void clear();
+    void resize(size_t N);
+    void push_back(particle_element const& particle);
+
+    reference operator[](size_t k);
+    const_reference operator[](size_t k) const;
+
+    // Reorder all the particles following the Morton code of their cell of size h
+    void sort_morton(float h);
+
+private:
+    vcl::buffer<int> permutation;        // Temporary storage for the reordering
+    vcl::buffer<uint64_t> morton_key;
+    template <typename T> void permute(vcl::buffer<T>& field);
+};
+
+
+// Interleave the bits of the 3 integer coordinates (21 bits each) to get their Morton code
+uint64_t morton_code(vcl::int3 const& idx);
+
+
+
+inline particle_soa::reference particle_soa::operator[](size_t k)
+{
+    return {p.data[k], v.data[k], f.data[k], rho.data[k], pressure.data[k]};
+}
+inline particle_soa::const_reference particle_soa::operator[](size_t k) const
+{
+    return {p.data[k], v.data[k], f.data[k], rho.data[k], pressure.data[k]};
+}
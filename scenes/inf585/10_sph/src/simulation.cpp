@@ -1,84 +1,319 @@
 #include "simulation.hpp"
 
+#include <cstring>
+
 using namespace vcl;
 
+// Pseudo-random value in [0,1] depending only on the particle index and one of its coordinates
+static float perturbation(int k, float x)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(float));
+    uint32_t h = uint32_t(k)*0x9E3779B1u ^ bits;
+    h ^= h >> 16; h *= 0x85EBCA6Bu;
+    h ^= h >> 13; h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return (h & 0xFFFFFF) / float(0xFFFFFF);
+}
+
 // Convert a density value to a pressure
 float density_to_pressure(float rho, float rho0, float stiffness)
 {
 	return stiffness*(rho-rho0);
 }
 
-float W_laplacian_viscosity(vec3 const& p_i, vec3 const& p_j, float h)
+// The passes are generic on the particle storage: buffer<particle_element> (AoS) or particle_soa (SoA)
+//  and on the kernel evaluation: sph_kernel_exact or sph_kernel_tabulated
+
+template <typename particle_container, typename KERNEL>
+void update_density(particle_container& particles, neighbor_list const& neighbors, KERNEL const& W, float m)
 {
-    // To do ...
-    //  Fill it with laplacian of W_viscosity
-    return 0.0f;
+    // rho_i = \sum_j m W_density(pi,pj)
+    //  Only the particles in the neighbor list of i can be at distance < h
+    //  Each particle gathers its own sum: no write conflict between threads
+    int const N = int(particles.size());
+    #pragma omp parallel for
+    for(int i=0; i<N; ++i)
+    {
+        vec3 const& p_i = particles[i].p;
+        float rho = 0.0f;
+        neighbors.for_each_candidate(i, [&](int j) {
+            vec3 const p_ij = p_i-particles[j].p;
+            float const r2 = dot(p_ij, p_ij);
+            if(r2<W.h2)
+                rho += m*W.density(r2);
+        });
+        particles[i].rho = rho;
+    }
 }
 
-vec3 W_gradient_pressure(vec3 const& p_i, vec3 const& p_j, float h)
+// Convert the particle density to pressure
+template <typename particle_container>
+void update_pressure(particle_container& particles, float rho0, float stiffness)
 {
-    // To do ...
-    //  Fill it with gradient of W_spiky
-    return (p_i-p_j)/norm(p_i-p_j);
+	int const N = int(particles.size());
+    #pragma omp parallel for
+    for(int i=0; i<N; ++i)
+        particles[i].pressure = density_to_pressure(particles[i].rho, rho0, stiffness);
 }
 
-float W_density(vec3 const& p_i, const vec3& p_j, float h)
+// Compute the forces and update the acceleration of the particles
+template <typename particle_container, typename KERNEL>
+void update_force(particle_container& particles, neighbor_list const& neighbors, KERNEL const& W, float m, float nu)
 {
-	float const r = norm(p_i-p_j);
-    assert_vcl_no_msg(r<=h);
-	return 315.0/(64.0*3.14159f*std::pow(h,9)) * std::pow(h*h-r*r, 3.0f);
-}
+    // Forces are gathered per particle (no symmetric scatter of the pair contribution)
+    //  the result is independent of the number of threads
+    int const N = int(particles.size());
+    #pragma omp parallel for
+    for(int i=0; i<N; ++i)
+    {
+        auto const& particle_i = particles[i];
+        vec3 const& p_i = particle_i.p;
 
+        vec3 F_pressure, F_viscosity;
+        neighbors.for_each_candidate(i, [&](int j) {
+            if(j==i)
+                return;
+            auto const& particle_j = particles[j];
+            vec3 const p_ij = p_i-particle_j.p;
+            float const r2 = dot(p_ij, p_ij);
+            if(r2>=W.h2)
+                return;
 
-void update_density(buffer<particle_element>& particles, float h, float m)
+            F_pressure  += m * (particle_i.pressure+particle_j.pressure)/(2*particle_j.rho) * W.gradient_pressure(p_ij, r2);
+            F_viscosity += m * (particle_j.v-particle_i.v)/particle_j.rho * W.laplacian_viscosity(r2);
+        });
+
+        // gravity + pressure + viscosity
+        particles[i].f = m * vec3{0,-9.81f,0} - m/particle_i.rho * F_pressure + m*nu * F_viscosity;
+    }
+}
+
+// Average compression (rho_i-rho_rest)/rho_rest over the particles, expanded particles (free surface) are not counted
+//  rho(i) must return the density of the i-th particle
+template <typename F>
+float average_density_error(int N, F const& rho, float rho_rest)
 {
-    // To do: Compute the density value (particles[i].rho) at each particle position
-    //  rho_i = \sum_j m W_density(pi,pj)
-    size_t const N = particles.size();
-    for(size_t i=0; i<N; ++i)
-        particles[i].rho = 1.0f; // to be modified
+    // Sequential sum: the result does not depend on the number of threads
+    float sum = 0.0f;
+    for(int i=0; i<N; ++i)
+        sum += std::max(rho(i)-rho_rest, 0.0f)/rho_rest;
+    return N>0 ? sum/N : 0.0f;
+}
 
+// Call f(p-p_b, |p-p_b|^2) for the samples p_b of the walls (floor y<=-1, sides x<=-1 and x>=1) closer than h to p
+//  The walls are sampled on a square lattice of spacing dx, starting at a distance dx behind the floor and the closest side wall
+//   (a particle in contact with a wall is at the rest distance of the samples)
+//  They act in the DFSPH solver as static fluid particles with the same pressure as their neighbor [Akinci et al. 2012]
+template <typename F>
+void for_each_wall_sample(vec3 const& p, float h, float dx, F const& f)
+{
+    // The right half of the domain is mirrored onto the left wall (h<1: a particle only sees one side wall)
+    float const sx = p.x<0 ? 1.0f : -1.0f;
+    float const x = sx*p.x;
 
+    int const a_min = int(std::floor((x+1-h)/dx)), a_max = int(std::ceil((x+1+h)/dx));
+    int const b_min = int(std::floor((p.y+1-h)/dx)), b_max = int(std::ceil((p.y+1+h)/dx));
+    for(int a=a_min; a<=a_max; ++a) {
+        for(int b=b_min; b<=(a<0 ? b_max : std::min(b_max,-1)); ++b) {
+            vec3 const p_b = {sx*(-1+a*dx), -1+b*dx, p.z};
+            vec3 const p_ib = p-p_b;
+            float const r2 = dot(p_ib, p_ib);
+            if(r2<h*h)
+                f(p_ib, r2);
+        }
+    }
 }
 
-// Convert the particle density to pressure
-void update_pressure(buffer<particle_element>& particles, float rho0, float stiffness)
+// Density of a particle surrounded by the initial square sampling of spacing c*h, computed with the kernel W(r2)
+template <typename F>
+float rest_density(F const& W, sph_parameters_structure const& sph_parameters)
 {
-	const size_t N = particles.size();
-    for(size_t i=0; i<N; ++i)
-        particles[i].pressure = density_to_pressure(particles[i].rho, rho0, stiffness);
+    float const h = sph_parameters.h;
+    float const dx = sph_parameters.c*h;
+    int const K = int(h/dx);
+
+    float rho = 0.0f;
+    for(int kx=-K; kx<=K; ++kx) {
+        for(int ky=-K; ky<=K; ++ky) {
+            float const r2 = (kx*kx+ky*ky)*dx*dx;
+            if(r2<h*h)
+                rho += sph_parameters.m*W(r2);
+        }
+    }
+    return rho;
 }
 
-// Compute the forces and update the acceleration of the particles
-void update_force(buffer<particle_element>& particles, float h, float m, float nu)
+// Density (fluid and walls) of the particles, and DFSPH factor alpha relating a density change to the pressure correcting it
+template <typename particle_container, typename KERNEL>
+void dfsph_update_factors(particle_container const& particles, neighbor_list const& neighbors, sph_solver_data& solver, KERNEL const& W, float dx, float m)
 {
-	// gravity
-    const size_t N = particles.size();
-    for(size_t i=0; i<N; ++i)
-        particles[i].f = m * vec3{0,-9.81f,0};
+    int const N = int(particles.size());
+    #pragma omp parallel for
+    for(int i=0; i<N; ++i)
+    {
+        vec3 const& p_i = particles[i].p;
+        float rho = 0.0f;
+        vec3 sum_grad;
+        float sum_grad2 = 0.0f;
+        neighbors.for_each_candidate(i, [&](int j) {
+            vec3 const p_ij = p_i-particles[j].p;
+            float const r2 = dot(p_ij, p_ij);
+            if(r2>=W.h2)
+                return;
+            rho += m*W.pressure(r2);
+            vec3 const grad = m*W.gradient_pressure(p_ij, r2);
+            sum_grad += grad;
+            sum_grad2 += dot(grad, grad);
+        });
+        for_each_wall_sample(p_i, W.h, dx, [&](vec3 const& p_ib, float r2) {
+            rho += m*W.pressure(r2);
+            sum_grad += m*W.gradient_pressure(p_ib, r2);
+        });
+
+        float const denominator = dot(sum_grad, sum_grad) + sum_grad2;
+        solver.rho[i] = rho;
+        solver.alpha[i] = denominator>1e-6f ? rho/denominator : 0.0f;
+    }
+}
 
-    //TO Do
-    // For all particles i
-    //   Compute F_pressure
-    //   Compute F_viscosity
-    //   particles[i].f += (F_pressure + F_viscosity) / rho_i
-    // ...
+// Rate of change of the density Drho/Dt induced by the velocities solver.v (the walls are static)
+template <typename particle_container, typename KERNEL>
+void dfsph_update_density_change(particle_container const& particles, neighbor_list const& neighbors, sph_solver_data& solver, KERNEL const& W, float dx, float m)
+{
+    int const N = int(particles.size());
+    #pragma omp parallel for
+    for(int i=0; i<N; ++i)
+    {
+        vec3 const& p_i = particles[i].p;
+        vec3 const& v_i = solver.v[i];
+        float drho = 0.0f;
+        neighbors.for_each_candidate(i, [&](int j) {
+            vec3 const p_ij = p_i-particles[j].p;
+            float const r2 = dot(p_ij, p_ij);
+            if(j==i || r2>=W.h2)
+                return;
+            drho += m*dot(v_i-solver.v[j], W.gradient_pressure(p_ij, r2));
+        });
+        for_each_wall_sample(p_i, W.h, dx, [&](vec3 const& p_ib, float r2) {
+            drho += m*dot(v_i, W.gradient_pressure(p_ib, r2));
+        });
+        solver.drho[i] = drho;
+    }
+}
 
+// Correction of the velocities solver.v by the pressure forces associated to solver.kappa (kappa_i = dt p_i/rho_i)
+template <typename particle_container, typename KERNEL>
+void dfsph_correct_velocity(particle_container const& particles, neighbor_list const& neighbors, sph_solver_data& solver, KERNEL const& W, float dx, float m)
+{
+    int const N = int(particles.size());
+    #pragma omp parallel for
+    for(int i=0; i<N; ++i)
+    {
+        vec3 const& p_i = particles[i].p;
+        float const k_i = solver.kappa[i]/solver.rho[i];
+        vec3 dv;
+        neighbors.for_each_candidate(i, [&](int j) {
+            vec3 const p_ij = p_i-particles[j].p;
+            float const r2 = dot(p_ij, p_ij);
+            if(j==i || r2>=W.h2)
+                return;
+            dv += m*(k_i + solver.kappa[j]/solver.rho[j]) * W.gradient_pressure(p_ij, r2);
+        });
+        for_each_wall_sample(p_i, W.h, dx, [&](vec3 const& p_ib, float r2) {
+            dv += m*k_i * W.gradient_pressure(p_ib, r2);
+        });
+        solver.v[i] -= dv;
+    }
 }
 
-void simulate(float dt, buffer<particle_element>& particles, sph_parameters_structure const& sph_parameters)
+// Divergence-free SPH [Bender and Koschier 2015]
+//  - Divergence solver: the current velocities are corrected such that they do not compress the fluid (Drho/Dt = 0)
+//  - Constant density solver: the velocities after the time step are corrected such that the predicted density is the rest density
+//  Both are iterated until the average compression is below the target error
+//  At the end, particles[i].f contains the total force (gravity + viscosity + pressure) leading to the corrected velocities
+//  The compression is measured with the spiky kernel W.pressure, such that the density always responds to the pressure forces
+//  (the gradient of the density kernel vanishes for close particles, the pressure would then grow without separating them)
+template <typename particle_container, typename KERNEL>
+void solve_pressure_dfsph(float dt, particle_container& particles, neighbor_list const& neighbors, sph_solver_data& solver, KERNEL const& W, sph_parameters_structure const& sph_parameters)
 {
+    float const m = sph_parameters.m;
+    float const dx = sph_parameters.c*W.h;
+    int const N = int(particles.size());
+    float const rho_rest = rest_density([&](float r2){return W.pressure(r2);}, sph_parameters);
+
+    solver.v.resize(N);
+    solver.rho.resize(N);
+    solver.drho.resize(N);
+    solver.alpha.resize(N);
+    solver.kappa.resize(N);
+    dfsph_update_factors(particles, neighbors, solver, W, dx, m);
+
+    // Compression of the fluid when its density increases at the rate drho during dt
+    auto const compression = [&](int i) { return solver.rho[i] + dt*solver.drho[i]; };
+
+    // Divergence solver
+    #pragma omp parallel for
+    for(int i=0; i<N; ++i)
+        solver.v[i] = particles[i].v;
+    solver.iterations_divergence = 0;
+    while(solver.iterations_divergence<sph_parameters.iteration_max)
+    {
+        dfsph_update_density_change(particles, neighbors, solver, W, dx, m);
+        float const error = average_density_error(N, [&](int i){return rho_rest+dt*solver.drho[i];}, rho_rest);
+        if(error<sph_parameters.density_error_max)
+            break;
+
+        #pragma omp parallel for
+        for(int i=0; i<N; ++i)
+            solver.kappa[i] = std::max(solver.drho[i], 0.0f) * solver.alpha[i];
+        dfsph_correct_velocity(particles, neighbors, solver, W, dx, m);
+        solver.iterations_divergence++;
+    }
+
+    // Non-pressure forces (gravity and viscosity) with the divergence-free velocities
+    #pragma omp parallel for
+    for(int i=0; i<N; ++i) {
+        particles[i].v = solver.v[i];
+        particles[i].pressure = 0.0f;
+    }
+    update_density(particles, neighbors, W, m);
+    update_force(particles, neighbors, W, m, sph_parameters.nu);
+
+    // Constant density solver
+    #pragma omp parallel for
+    for(int i=0; i<N; ++i)
+        solver.v[i] = particles[i].v + dt*particles[i].f/m;
+    solver.iterations = 0;
+    while(solver.iterations<sph_parameters.iteration_max)
+    {
+        dfsph_update_density_change(particles, neighbors, solver, W, dx, m);
+        solver.density_error = average_density_error(N, compression, rho_rest);
+        if(solver.iterations>0 && solver.density_error<sph_parameters.density_error_max)
+            break;
+
+        #pragma omp parallel for
+        for(int i=0; i<N; ++i) {
+            solver.kappa[i] = std::max(compression(i)-rho_rest, 0.0f)/dt * solver.alpha[i];
+            particles[i].pressure += solver.kappa[i]*solver.rho[i]/dt;
+        }
+        dfsph_correct_velocity(particles, neighbors, solver, W, dx, m);
+        solver.iterations++;
+    }
 
-	// Update values
-    update_density(particles, sph_parameters.h, sph_parameters.m);                   // First compute updated density
-    update_pressure(particles, sph_parameters.rho0, sph_parameters.stiffness);       // Compute associated pressure
-    update_force(particles, sph_parameters.h, sph_parameters.m, sph_parameters.nu);  // Update forces
+    #pragma omp parallel for
+    for(int i=0; i<N; ++i)
+        particles[i].f = m*(solver.v[i]-particles[i].v)/dt;
+}
 
+template <typename particle_container>
+void integrate(float dt, particle_container& particles, float m)
+{
 	// Numerical integration
 	float const damping = 0.005f;
-	size_t const N = particles.size();
-	float const m = sph_parameters.m;
-	for(size_t k=0; k<N; ++k)
+	int const N = int(particles.size());
+	#pragma omp parallel for
+	for(int k=0; k<N; ++k)
 	{
 		vec3& p = particles[k].p;
 		vec3& v = particles[k].v;
@@ -92,15 +327,152 @@ void simulate(float dt, buffer<particle_element>& particles, sph_parameters_stru
 
 	// Collision
     float const epsilon = 1e-3f;
-    for(size_t k=0; k<N; ++k)
+    #pragma omp parallel for
+    for(int k=0; k<N; ++k)
     {
         vec3& p = particles[k].p;
         vec3& v = particles[k].v;
 
         // small perturbation to avoid alignment
-        if( p.y<-1 ) {p.y = -1+epsilon*rand_interval();  v.y *= -0.5f;}
-        if( p.x<-1 ) {p.x = -1+epsilon*rand_interval();  v.x *= -0.5f;}
-        if( p.x>1 )  {p.x =  1-epsilon*rand_interval();  v.x *= -0.5f;}
+        //  (deterministic pseudo-random value: the global generator rand_interval() cannot be shared between threads)
+        if( p.y<-1 ) {p.y = -1+epsilon*perturbation(k, p.x);  v.y *= -0.5f;}
+        if( p.x<-1 ) {p.x = -1+epsilon*perturbation(k, p.y);  v.x *= -0.5f;}
+        if( p.x>1 )  {p.x =  1-epsilon*perturbation(k, p.y);  v.x *= -0.5f;}
+    }
+}
+
+template <typename particle_container, typename KERNEL>
+void simulate_step(float dt, particle_container& particles, neighbor_list& neighbors, sph_solver_data& solver, KERNEL const& W, sph_parameters_structure const& sph_parameters)
+{
+    // Update the neighbor lists if particles moved too much since their last build
+    neighbors.update(particles.size(), [&](size_t k) -> vec3 const& {return particles[k].p;}, sph_parameters.h);
+
+    if(sph_parameters.solver==sph_solver_dfsph)
+        solve_pressure_dfsph(dt, particles, neighbors, solver, W, sph_parameters);
+    else
+    {
+        // Update values
+        update_density(particles, neighbors, W, sph_parameters.m);                   // First compute updated density
+        update_pressure(particles, sph_parameters.rho0, sph_parameters.stiffness);       // Compute associated pressure
+        update_force(particles, neighbors, W, sph_parameters.m, sph_parameters.nu);  // Update forces
+
+        // Compression relative to the density of the initial sampling (the parameter rho0 is only a pressure offset)
+        float const rho_rest = rest_density([&](float r2){return W.density(r2);}, sph_parameters);
+        solver.iterations = 1;
+        solver.iterations_divergence = 0;
+        solver.density_error = average_density_error(int(particles.size()), [&](int i){return particles[i].rho;}, rho_rest);
+    }
+
+    integrate(dt, particles, sph_parameters.m);
+}
+
+// Kernel constants are computed once per step (exact evaluation), or kept with their tables in the solver data
+template <typename particle_container>
+void simulate_step(float dt, particle_container& particles, neighbor_list& neighbors, sph_solver_data& solver, sph_parameters_structure const& sph_parameters)
+{
+    if(sph_parameters.kernel_tabulated) {
+        solver.kernel_tabulated.set(sph_parameters.h);
+        simulate_step(dt, particles, neighbors, solver, solver.kernel_tabulated, sph_parameters);
+    }
+    else
+        simulate_step(dt, particles, neighbors, solver, sph_kernel_exact(sph_parameters.h), sph_parameters);
+}
+
+// Current velocities and accelerations of the particles compared to the kernel size
+//  The pressure of the DFSPH solver is implicit: only the velocity limit applies (its forces are impulses scaled by 1/dt)
+//  The state equation is explicit: the accelerations and the speed of sound sqrt(stiffness) also limit the time step
+template <typename particle_container>
+timestep_measure measure_timestep_step(particle_container const& particles, sph_parameters_structure const& sph_parameters)
+{
+    int const N = int(particles.size());
+    bool const explicit_pressure = sph_parameters.solver==sph_solver_state_equation;
+
+    // Maxima of each thread combined at the end (the max reduction of OpenMP 3.1 is not available with MSVC)
+    float v_max = 0.0f;
+    float f_max = 0.0f;
+    #pragma omp parallel
+    {
+        float v_max_thread = 0.0f;
+        float f_max_thread = 0.0f;
+        #pragma omp for
+        for(int i=0; i<N; ++i) {
+            v_max_thread = std::max(v_max_thread, norm(particles[i].v));
+            if(explicit_pressure)
+                f_max_thread = std::max(f_max_thread, norm(particles[i].f));
+        }
+        #pragma omp critical
+        {
+            v_max = std::max(v_max, v_max_thread);
+            f_max = std::max(f_max, f_max_thread);
+        }
     }
 
-}
\ No newline at end of file
+    timestep_measure measure;
+    measure.length = sph_parameters.h;
+    measure.velocity_max = v_max;
+    measure.acceleration_max = f_max/sph_parameters.m;
+    measure.viscosity = sph_parameters.nu;
+    if(explicit_pressure)
+        measure.frequency = std::sqrt(sph_parameters.stiffness)/sph_parameters.h;
+    return measure;
+}
+
+timestep_measure measure_timestep(buffer<particle_element> const& particles, sph_parameters_structure const& sph_parameters)
+{
+    return measure_timestep_step(particles, sph_parameters);
+}
+timestep_measure measure_timestep(particle_soa const& particles, sph_parameters_structure const& sph_parameters)
+{
+    return measure_timestep_step(particles, sph_parameters);
+}
+
+template <typename particle_container>
+void simulate_frame_steps(float dt_frame, particle_container& particles, neighbor_list& neighbors, sph_solver_data& solver, timestep_adaptive& timestep, sph_parameters_structure const& sph_parameters)
+{
+    int iterations = 0, iterations_divergence = 0;
+    float density_error = 0.0f;
+
+    // The DFSPH corrections scale with 1/dt: its step decreases progressively, the explicit state equation needs the stable step immediately
+    timestep.decrease_max = (sph_parameters.solver==sph_solver_dfsph) ? 1.25f : 0.0f;
+    timestep.frame_start(dt_frame);
+    while(timestep.frame_running())
+    {
+        float const dt = timestep.next(measure_timestep(particles, sph_parameters));
+        simulate(dt, particles, neighbors, solver, sph_parameters);
+
+        iterations += solver.iterations;
+        iterations_divergence += solver.iterations_divergence;
+        density_error = std::max(density_error, solver.density_error);
+    }
+
+    // Statistics of the whole frame
+    solver.iterations = iterations;
+    solver.iterations_divergence = iterations_divergence;
+    solver.density_error = density_error;
+}
+
+void simulate_frame(float dt_frame, buffer<particle_element>& particles, neighbor_list& neighbors, sph_solver_data& solver, timestep_adaptive& timestep, sph_parameters_structure const& sph_parameters)
+{
+    simulate_frame_steps(dt_frame, particles, neighbors, solver, timestep, sph_parameters);
+}
+void simulate_frame(float dt_frame, particle_soa& particles, neighbor_list& neighbors, sph_solver_data& solver, timestep_adaptive& timestep, sph_parameters_structure const& sph_parameters)
+{
+    simulate_frame_steps(dt_frame, particles, neighbors, solver, timestep, sph_parameters);
+}
+
+void simulate(float dt, buffer<particle_element>& particles, neighbor_list& neighbors, sph_solver_data& solver, sph_parameters_structure const& sph_parameters)
+{
+    simulate_step(dt, particles, neighbors, solver, sph_parameters);
+}
+
+void simulate(float dt, particle_soa& particles, neighbor_list& neighbors, sph_solver_data& solver, sph_parameters_structure const& sph_parameters)
+{
+    // Periodically restore the memory locality of spatial neighbors
+    if(particles.reorder_period>0 && particles.reorder_counter%particles.reorder_period==0) {
+        particles.sort_morton(sph_parameters.h);
+        neighbors.invalidate(); // particle indices changed
+    }
+    particles.reorder_counter++;
+
+    simulate_step(dt, particles, neighbors, solver, sph_parameters);
+}
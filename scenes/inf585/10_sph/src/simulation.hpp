@@ -1,9 +1,17 @@
 #pragma once
 
 #include "vcl/vcl.hpp"
+#include "neighbor_list.hpp"
+#include "particle_soa.hpp"
+#include "sph_kernel.hpp"
 
 
 
+// Kernels of the simulation
+//  The particles move in the plane z=0, but the kernels keep the 3D normalization the parameters (rho0, stiffness, nu) were tuned with
+using sph_kernel_exact = sph_kernel<3>;
+using sph_kernel_tabulated = sph_kernel<3,true>;
+
 // SPH Particle
 struct particle_element
 {
@@ -17,6 +25,11 @@ struct particle_element
     particle_element() : p{0,0,0},v{0,0,0},f{0,0,0},rho(0),pressure(0) {}
 };
 
+// Computation of the pressure
+//  - sph_solver_state_equation: weakly compressible, pressure directly computed from the density (stiffness*(rho-rho0))
+//  - sph_solver_dfsph: iterative solver bounding the density error (divergence-free SPH), allows larger time steps
+enum sph_solver_type { sph_solver_state_equation, sph_solver_dfsph };
+
 // SPH simulation parameters
 struct sph_parameters_structure
 {
@@ -34,8 +47,51 @@ struct sph_parameters_structure
      
     // Stiffness converting density to pressure
     float stiffness = 0.1f;
-    
+
+    // Initial spacing between particles (relative to h)
+    //  The density of this sampling is the rest density targeted by the DFSPH solver
+    float c = 0.7f;
+
+    // Pressure solver and its stopping criteria (DFSPH only)
+    sph_solver_type solver = sph_solver_state_equation;
+    float density_error_max = 0.01f; // Target average compression (1%)
+    int iteration_max = 50;
+
+    // Evaluate the kernels by interpolation in precomputed tables (approximation, no square root per pair)
+    bool kernel_tabulated = false;
+};
+
+// Temporary buffers and statistics of the pressure solver
+struct sph_solver_data
+{
+    vcl::buffer<vcl::vec3> v; // Velocities corrected by the solver
+    vcl::buffer<float> rho;   // Densities (fluid and walls)
+    vcl::buffer<float> drho;  // Rate of change of the densities induced by the velocities v
+    vcl::buffer<float> alpha; // Factors relating a density change to the pressure correcting it
+    vcl::buffer<float> kappa; // Pressure corrections (dt*pressure/density)
+    sph_kernel_tabulated kernel_tabulated; // Kernel tables, rebuilt when h changes
+
+    // Statistics of the last time step
+    int iterations = 0;            // Number of iterations of the density solver (1 for the state equation)
+    int iterations_divergence = 0; // Number of iterations of the divergence solver
+    float density_error = 0.0f;    // Average compression relative to the rest density
 };
 
 
-void simulate(float dt, vcl::buffer<particle_element>& particles, sph_parameters_structure const& sph_parameters);
\ No newline at end of file
+// Compute one time step of the SPH simulation
+//  neighbors: cached neighbor lists, rebuilt only when the particles moved more than skin/2
+//  The particles can be stored either as an array of particle_element, or as a structure of arrays
+//  solver: temporary data of the pressure solver, and statistics of the step
+void simulate(float dt, vcl::buffer<particle_element>& particles, neighbor_list& neighbors, sph_solver_data& solver, sph_parameters_structure const& sph_parameters);
+void simulate(float dt, particle_soa& particles, neighbor_list& neighbors, sph_solver_data& solver, sph_parameters_structure const& sph_parameters);
+
+
+// Advance the simulation by the duration of a frame, subdivided into the minimal number of stable time steps
+//  The time step is chosen before each step from the current velocities and forces (CFL condition), see vcl::timestep_adaptive
+//  solver: statistics summed over the steps of the frame (maximal density error)
+void simulate_frame(float dt_frame, vcl::buffer<particle_element>& particles, neighbor_list& neighbors, sph_solver_data& solver, vcl::timestep_adaptive& timestep, sph_parameters_structure const& sph_parameters);
+void simulate_frame(float dt_frame, particle_soa& particles, neighbor_list& neighbors, sph_solver_data& solver, vcl::timestep_adaptive& timestep, sph_parameters_structure const& sph_parameters);
+
+// Stability measure of the current state of the particles (velocities, forces, viscosity, kernel size)
+vcl::timestep_measure measure_timestep(vcl::buffer<particle_element> const& particles, sph_parameters_structure const& sph_parameters);
+vcl::timestep_measure measure_timestep(particle_soa const& particles, sph_parameters_structure const& sph_parameters);
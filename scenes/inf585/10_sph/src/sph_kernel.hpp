@@ -0,0 +1,136 @@
+#pragma once
+
+#include "vcl/vcl.hpp"
+
+
+// SPH kernels of support h, evaluated from the squared distance r2 between two particles
+//  - density:             W(r) = c (h^2-r^2)^3      (poly6)
+//  - pressure:            W(r) = c (h-r)^3          (spiky, its gradient does not vanish for close particles)
+//  - gradient_pressure:   grad W(r) = -c (h-r)^2 (p_i-p_j)/r
+//  - laplacian_viscosity: lap W(r) = c (h-r)
+//  The normalization constants (powers of h) are computed once by set(h) instead of for every pair
+//  DIM (2 or 3): dimension of the normalization, selected at compile time
+//  TABULATED: kernels of r (spiky, gradient, laplacian) are linearly interpolated in tables sampled on r2 - no square root per pair
+//   The tables are only rebuilt when h changes. Their relative error is about 1e-3.
+//   The kernels are not smooth functions of r2 close to r=0 (the gradient varies as 1/r): they are evaluated exactly
+//   in the first table_exact intervals (r < h/8), where the linear interpolation error would reach several percents
+//  The caller checks that r2 < h2 before evaluating a kernel
+template <int DIM, bool TABULATED=false>
+struct sph_kernel
+{
+    static_assert(DIM==2 || DIM==3, "SPH kernels are defined in 2D or 3D");
+
+    float h  = 0.0f;
+    float h2 = 0.0f;
+
+    sph_kernel() = default;
+    explicit sph_kernel(float h);
+    void set(float h);
+
+    float density(float r2) const;
+    float pressure(float r2) const;
+    vcl::vec3 gradient_pressure(vcl::vec3 const& p_ij, float r2) const; // p_ij = p_i-p_j
+    float laplacian_viscosity(float r2) const;
+
+    static int const table_size = 1024; // Number of intervals of the tables on [0,h2]
+    static int const table_exact = 16;  // First intervals of the tables replaced by the exact kernels
+
+private:
+    float c_density = 0.0f;
+    float c_pressure = 0.0f;
+    float c_gradient = 0.0f;
+    float c_laplacian = 0.0f;
+
+    float r2_to_table = 0.0f; // table_size/h2
+    vcl::buffer<float> table_pressure;  // c (h-r)^3
+    vcl::buffer<float> table_gradient;  // c (h-r)^2/r (0 at r=0, not used)
+    vcl::buffer<float> table_laplacian; // c (h-r)
+
+    float lookup(vcl::buffer<float> const& table, float r2) const;
+};
+
+
+
+template <int DIM, bool TABULATED>
+sph_kernel<DIM,TABULATED>::sph_kernel(float h_arg)
+{
+    set(h_arg);
+}
+
+template <int DIM, bool TABULATED>
+void sph_kernel<DIM,TABULATED>::set(float h_arg)
+{
+    if(h_arg==h)
+        return;
+    h = h_arg;
+    h2 = h*h;
+
+    // Normalizations of [Muller et al. 2003] in 3D, and their 2D counterparts
+    float const pi = 3.14159f;
+    float h_dim = 1.0f; // h^DIM
+    for(int k=0; k<DIM; ++k)
+        h_dim *= h;
+    float const h3 = h2*h;
+    c_density   = (DIM==3 ? 315.0f/64.0f : 4.0f) / (pi*h3*h3*h_dim);
+    c_pressure  = (DIM==3 ? 15.0f : 10.0f) / (pi*h3*h_dim);
+    c_gradient  = (DIM==3 ? 45.0f : 30.0f) / (pi*h3*h_dim);
+    c_laplacian = (DIM==3 ? 45.0f : 40.0f) / (pi*h3*h_dim);
+
+    if(TABULATED)
+    {
+        r2_to_table = table_size/h2;
+        table_pressure.resize(table_size+2);
+        table_gradient.resize(table_size+2);
+        table_laplacian.resize(table_size+2);
+        for(int k=0; k<table_size+2; ++k) {
+            float const r = std::sqrt(std::min(k/r2_to_table, h2));
+            table_pressure[k]  = c_pressure*(h-r)*(h-r)*(h-r);
+            table_gradient[k]  = r>0 ? c_gradient*(h-r)*(h-r)/r : 0.0f;
+            table_laplacian[k] = c_laplacian*(h-r);
+        }
+    }
+}
+
+template <int DIM, bool TABULATED>
+float sph_kernel<DIM,TABULATED>::lookup(vcl::buffer<float> const& table, float r2) const
+{
+    float const x = r2*r2_to_table;
+    int const k = int(x);
+    float const a = x-k;
+    return (1-a)*table.data[k] + a*table.data[k+1];
+}
+
+template <int DIM, bool TABULATED>
+float sph_kernel<DIM,TABULATED>::density(float r2) const
+{
+    float const d = h2-r2;
+    return c_density*d*d*d;
+}
+
+template <int DIM, bool TABULATED>
+float sph_kernel<DIM,TABULATED>::pressure(float r2) const
+{
+    if(TABULATED && r2*r2_to_table>=table_exact)
+        return lookup(table_pressure, r2);
+    float const d = h-std::sqrt(r2);
+    return c_pressure*d*d*d;
+}
+
+template <int DIM, bool TABULATED>
+vcl::vec3 sph_kernel<DIM,TABULATED>::gradient_pressure(vcl::vec3 const& p_ij, float r2) const
+{
+    if(TABULATED && r2*r2_to_table>=table_exact)
+        return -lookup(table_gradient, r2) * p_ij;
+    if(r2<1e-12f) // coincident particles: no defined direction
+        return {0,0,0};
+    float const r = std::sqrt(r2);
+    return -c_gradient*(h-r)*(h-r)/r * p_ij;
+}
+
+template <int DIM, bool TABULATED>
+float sph_kernel<DIM,TABULATED>::laplacian_viscosity(float r2) const
+{
+    if(TABULATED && r2*r2_to_table>=table_exact)
+        return lookup(table_laplacian, r2);
+    return c_laplacian*(h-std::sqrt(r2));
+}